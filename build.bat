@@ -1 +1,8 @@
-clang  -std=c++20 src/main.cc -I include/ -I C:\VulkanSDK\1.3.250.1\Include -L C:\VulkanSDK\1.3.250.1\Lib -L lib/ -l glfw3_mt.lib -l vulkan-1.lib -l gdi32.lib -l user32.lib -l shell32.lib -g 
\ No newline at end of file
+clang  -std=c++20 src/main.cc src/frame_clock.cc src/shader_reflect.cc src/shader_reload.cc src/vk_allocator.cc src/vk_descriptors.cc src/vk_device_select.cc src/vk_frames.cc src/vk_offscreen.cc src/vk_particles.cc src/vk_pipeline_cache.cc src/vk_profiler.cc src/vk_recorder.cc src/vk_render_graph.cc src/vk_scheduler.cc src/vk_shader.cc src/vk_swapchain.cc src/vk_transfer.cc src/job_system.cc src/particle_engine.cc src/particle_init.cc src/barnes_hut.cc -I include/ -I C:\VulkanSDK\1.3.250.1\Include -L C:\VulkanSDK\1.3.250.1\Lib -L lib/ -l glfw3_mt.lib -l vulkan-1.lib -l gdi32.lib -l user32.lib -l shell32.lib -g 
+clang  -std=c++20 -O2 -mavx2 -mfma -mf16c src/particle_bench.cc src/particle_engine.cc src/job_system.cc src/particle_init.cc src/particle_compact.cc src/spatial_grid.cc src/barnes_hut.cc -I include/ -o particle_bench.exe
+clang  -std=c++20 -O2 src/shader_build.cc src/shader_reflect.cc -I include/ -I C:\VulkanSDK\1.3.250.1\Include -o shader_build.exe
+C:\VulkanSDK\1.3.250.1\Bin\glslc -O shaders/particle_sim.comp -o shaders/particle_sim.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc -O shaders/particle_bh.comp -o shaders/particle_bh.comp.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc -O shaders/particle_draw.vert -o shaders/particle_draw.vert.spv
+C:\VulkanSDK\1.3.250.1\Bin\glslc -O shaders/particle_draw.frag -o shaders/particle_draw.frag.spv
+shader_build.exe shaders/particle_sim.comp.spv shaders/particle_bh.comp.spv shaders/particle_draw.vert.spv shaders/particle_draw.frag.spv
\ No newline at end of file
@@ -3,8 +3,18 @@
 layout (location = 0) in vec3 vertex_position;
 layout (location = 1) in float life;
 
-uniform mat4 view_matrix;
-uniform mat4 projection_matrix; 
+// per frame constants, frame_constants_t in src/old_main.cc. Written to a uniform_ring_t slice
+// (src/uniform_ring.h) once per frame.
+layout (std140, binding = 0) uniform FrameConstants {
+	mat4 projection_matrix;
+	mat4 view_matrix;
+	vec4 attractors[8];
+	// Delta time
+	float dt;
+	// Random numbers are a function of (seed, frame_index, particle index), see src/random.h.
+	uint frame_index;
+	uvec2 seed;
+};
 
 out float particle_lifetime;
 
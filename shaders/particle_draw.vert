@@ -0,0 +1,20 @@
+#version 450
+// vulkan version of particle.vert. The vertex buffer is a render buffer written by
+// particle_sim.comp: xyz is the position, w the life.
+
+layout (location = 0) in vec4 particle;
+
+// vk_particle_draw_constants_t in src/vk_particles.h.
+layout (push_constant) uniform DrawConstants {
+	mat4 view_projection_matrix;
+};
+
+layout (location = 0) out float particle_lifetime;
+
+void main()
+{
+	particle_lifetime = particle.w;
+	gl_Position = view_projection_matrix * vec4(particle.xyz, 1.0);
+	// points have no size unless the shader gives them one.
+	gl_PointSize = 1.0;
+}
@@ -0,0 +1,49 @@
+// spatial hash grid lookups, the glsl side of src/spatial_grid.h.
+// not a shader on its own: #include it (GL_GOOGLE_include_directive, glslc has it) from a compute
+// shader that gets the grid spatial_grid_build made, uploaded as-is.
+//
+// the buffers have the layout of spatial_grid_t:
+//   cellStart[b] .. cellStart[b + 1] indexes sortedIndices for bucket b.
+
+layout (std430, set = 0, binding = 4) readonly buffer GridCellStartBuffer {
+    uint cellStart[];
+};
+
+layout (std430, set = 0, binding = 5) readonly buffer GridSortedIndexBuffer {
+    uint sortedIndices[];
+};
+
+// spatial_grid_t's cell_size and bucket_count.
+layout (std140, set = 0, binding = 6) uniform GridParams {
+    float grid_cell_size;
+    // power of two.
+    uint grid_bucket_count;
+};
+
+ivec3 gridCell (vec3 pos)
+{
+    return ivec3(floor(pos / grid_cell_size));
+}
+
+// spatial_grid_bucket in src/spatial_grid.h. uint multiplication wraps the same way on both sides.
+uint gridBucket (ivec3 cell)
+{
+    uvec3 c = uvec3(cell);
+    uint hash = (c.x * 73856093u) ^ (c.y * 19349663u) ^ (c.z * 83492791u);
+    return hash & (grid_bucket_count - 1u);
+}
+
+// usage, for a query radius <= grid_cell_size:
+//
+//     ivec3 center = gridCell(pos);
+//     for (int z = -1; z <= 1; ++z)
+//     for (int y = -1; y <= 1; ++y)
+//     for (int x = -1; x <= 1; ++x) {
+//         uint bucket = gridBucket(center + ivec3(x, y, z));
+//         for (uint slot = cellStart[bucket]; slot < cellStart[bucket + 1u]; ++slot) {
+//             uint other = sortedIndices[slot];
+//             // buckets are shared by hash collisions: always check the distance. Two of the
+//             // 27 cells can also land in the same bucket; spatial_grid_for_each_neighbor skips
+//             // repeated buckets, do the same if counting a neighbour twice matters.
+//         }
+//     }
@@ -0,0 +1,301 @@
+#include "barnes_hut.h"
+#include "random.h"
+
+#include <algorithm> // std::sort, std::partition_point
+#include <array>
+
+struct morton_attractor_t
+{
+	uint32_t code;
+	uint32_t index;
+};
+
+// spreads the low 10 bits of v so there are two zero bits between each of them.
+static uint32_t spread_bits(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8))  & 0x0300f00f;
+	v = (v | (v << 4))  & 0x030c30c3;
+	v = (v | (v << 2))  & 0x09249249;
+	return v;
+}
+
+static uint32_t morton_code(glm::vec3 normalized)
+{
+	glm::uvec3 q = glm::uvec3(glm::clamp(normalized * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f)));
+	return (spread_bits(q.x) << 2) | (spread_bits(q.y) << 1) | spread_bits(q.z);
+}
+
+// octant of a code at a given depth (0 is the split of the root).
+static uint32_t octant_at(uint32_t code, uint32_t depth)
+{
+	return (code >> (3 * (barnes_hut_max_depth - 1 - depth))) & 7;
+}
+
+struct build_context_t
+{
+	const std::vector<morton_attractor_t>& sorted;
+	const std::vector<glm::vec4>& attractors; // already in sorted order.
+};
+
+// appends the subtree for sorted[begin, end) to nodes in depth first order. `next` values are
+// relative to the start of `nodes`, the caller offsets them when splicing subtrees together.
+static void build_subtree(
+	const build_context_t& context,
+	std::vector<barnes_hut_node_t>& nodes,
+	uint32_t begin,
+	uint32_t end,
+	uint32_t depth,
+	glm::vec3 cell_center,
+	float cell_size)
+{
+	const uint32_t node_index = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({});
+
+	glm::vec3 weighted_position{0.0f};
+	glm::vec3 position_sum{0.0f};
+	float mass = 0.0f;
+	for (uint32_t idx = begin; idx != end; ++idx)
+	{
+		const glm::vec4& attractor = context.attractors[idx];
+		weighted_position += glm::vec3(attractor) * attractor.w;
+		position_sum += glm::vec3(attractor);
+		mass += attractor.w;
+	}
+	// massless cells still need a position, use the plain average.
+	glm::vec3 center_of_mass = mass > 0.0f ? weighted_position / mass : position_sum / static_cast<float>(end - begin);
+
+	bool is_leaf = (end - begin) <= barnes_hut_leaf_size || depth == barnes_hut_max_depth;
+	if (!is_leaf)
+	{
+		// the codes are sorted, so the 8 children are consecutive runs.
+		uint32_t child_begin = begin;
+		for (uint32_t octant = 0; octant != 8; ++octant)
+		{
+			auto child_end_it = std::partition_point(
+				context.sorted.begin() + child_begin,
+				context.sorted.begin() + end,
+				[&](const morton_attractor_t& entry) { return octant_at(entry.code, depth) <= octant; });
+			uint32_t child_end = static_cast<uint32_t>(child_end_it - context.sorted.begin());
+			if (child_end != child_begin)
+			{
+				glm::vec3 offset{(octant & 4) ? 0.25f : -0.25f, (octant & 2) ? 0.25f : -0.25f, (octant & 1) ? 0.25f : -0.25f};
+				build_subtree(context, nodes, child_begin, child_end, depth + 1, cell_center + offset * cell_size, cell_size * 0.5f);
+			}
+			child_begin = child_end;
+		}
+	}
+
+	barnes_hut_node_t& node = nodes[node_index];
+	node.center_of_mass = glm::vec4(center_of_mass, mass);
+	node.cell = glm::vec4(cell_center, cell_size);
+	node.next = static_cast<uint32_t>(nodes.size());
+	node.first_attractor = begin;
+	node.attractor_count = end - begin;
+	node.is_leaf = is_leaf ? 1 : 0;
+}
+
+void barnes_hut_build(barnes_hut_tree_t& tree, job_system_t& job_system, const glm::vec4* attractors, size_t attractor_count)
+{
+	tree.nodes.clear();
+	tree.attractors.clear();
+	if (attractor_count == 0) return;
+
+	// root cell: the bounding cube of all attractors.
+	glm::vec3 min = glm::vec3(attractors[0]);
+	glm::vec3 max = min;
+	for (size_t idx = 0; idx != attractor_count; ++idx)
+	{
+		min = glm::min(min, glm::vec3(attractors[idx]));
+		max = glm::max(max, glm::vec3(attractors[idx]));
+	}
+	const glm::vec3 extent = max - min;
+	const float root_size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+	const glm::vec3 root_center = (min + max) * 0.5f;
+	const glm::vec3 root_min = root_center - root_size * 0.5f;
+
+	std::vector<morton_attractor_t> sorted(attractor_count);
+	const size_t chunk_size = 4096;
+	parallel_for(job_system, attractor_count, chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx != end; ++idx)
+		{
+			glm::vec3 normalized = (glm::vec3(attractors[idx]) - root_min) / root_size;
+			sorted[idx] = {morton_code(normalized), static_cast<uint32_t>(idx)};
+		}
+	});
+	// ties are broken by index so the order (and the tree) is unique.
+	std::sort(sorted.begin(), sorted.end(), [](const morton_attractor_t& lhs, const morton_attractor_t& rhs)
+	{
+		return lhs.code != rhs.code ? lhs.code < rhs.code : lhs.index < rhs.index;
+	});
+
+	tree.attractors.resize(attractor_count);
+	for (size_t idx = 0; idx != attractor_count; ++idx)
+	{
+		tree.attractors[idx] = attractors[sorted[idx].index];
+	}
+
+	const build_context_t context{sorted, tree.attractors};
+	const uint32_t count = static_cast<uint32_t>(attractor_count);
+
+	// small trees are not worth splitting up.
+	if (count <= barnes_hut_leaf_size)
+	{
+		build_subtree(context, tree.nodes, 0, count, 0, root_center, root_size);
+		return;
+	}
+
+	// the root's 8 children are independent, build them in parallel and splice them together.
+	std::array<uint32_t, 9> octant_begin{};
+	for (uint32_t octant = 0; octant != 8; ++octant)
+	{
+		auto it = std::partition_point(sorted.begin(), sorted.end(),
+			[&](const morton_attractor_t& entry) { return octant_at(entry.code, 0) <= octant; });
+		octant_begin[octant + 1] = static_cast<uint32_t>(it - sorted.begin());
+	}
+
+	std::array<std::vector<barnes_hut_node_t>, 8> subtrees;
+	parallel_for(job_system, 8, 1, [&](size_t octant, size_t, size_t)
+	{
+		uint32_t begin = octant_begin[octant];
+		uint32_t end = octant_begin[octant + 1];
+		if (begin == end) return;
+		glm::vec3 offset{(octant & 4) ? 0.25f : -0.25f, (octant & 2) ? 0.25f : -0.25f, (octant & 1) ? 0.25f : -0.25f};
+		build_subtree(context, subtrees[octant], begin, end, 1, root_center + offset * root_size, root_size * 0.5f);
+	});
+
+	// root: everything.
+	tree.nodes.push_back({});
+	for (auto& subtree: subtrees)
+	{
+		uint32_t offset = static_cast<uint32_t>(tree.nodes.size());
+		for (auto& node: subtree)
+		{
+			node.next += offset;
+			tree.nodes.push_back(node);
+		}
+	}
+
+	glm::vec3 weighted_position{0.0f};
+	glm::vec3 position_sum{0.0f};
+	float mass = 0.0f;
+	for (const auto& attractor: tree.attractors)
+	{
+		weighted_position += glm::vec3(attractor) * attractor.w;
+		position_sum += glm::vec3(attractor);
+		mass += attractor.w;
+	}
+	barnes_hut_node_t& root = tree.nodes[0];
+	root.center_of_mass = glm::vec4(mass > 0.0f ? weighted_position / mass : position_sum / static_cast<float>(count), mass);
+	root.cell = glm::vec4(root_center, root_size);
+	root.next = static_cast<uint32_t>(tree.nodes.size());
+	root.first_attractor = 0;
+	root.attractor_count = count;
+	root.is_leaf = 0;
+}
+
+static glm::vec3 point_force(glm::vec3 point, float mass, glm::vec3 position, float softening_2)
+{
+	glm::vec3 dir = point - position;
+	float distance_2 = glm::dot(dir, dir) + softening_2;
+	return dir * (mass / (distance_2 * glm::sqrt(distance_2)));
+}
+
+glm::vec3 barnes_hut_force(const barnes_hut_tree_t& tree, glm::vec3 position, float theta, float softening)
+{
+	const float theta_2 = theta * theta;
+	const float softening_2 = softening * softening;
+	const uint32_t node_count = static_cast<uint32_t>(tree.nodes.size());
+
+	glm::vec3 force{0.0f};
+	uint32_t node_index = 0;
+	while (node_index < node_count)
+	{
+		const barnes_hut_node_t& node = tree.nodes[node_index];
+
+		// size / distance < theta, without the sqrt. Leaves too: a far away leaf is one point
+		// mass like any other cell, only the ones that are too close are summed one by one.
+		glm::vec3 dir = glm::vec3(node.center_of_mass) - position;
+		float distance_2 = glm::dot(dir, dir);
+		if (node.cell.w * node.cell.w < theta_2 * distance_2)
+		{
+			force += point_force(glm::vec3(node.center_of_mass), node.center_of_mass.w, position, softening_2);
+			node_index = node.next;
+		}
+		else if (node.is_leaf)
+		{
+			for (uint32_t idx = node.first_attractor; idx != node.first_attractor + node.attractor_count; ++idx)
+			{
+				force += point_force(glm::vec3(tree.attractors[idx]), tree.attractors[idx].w, position, softening_2);
+			}
+			node_index = node.next;
+		}
+		else
+		{
+			node_index += 1; // first child.
+		}
+	}
+	return force;
+}
+
+glm::vec3 direct_attractor_force(const glm::vec4* attractors, size_t attractor_count, glm::vec3 position, float softening)
+{
+	glm::vec3 force{0.0f};
+	for (size_t idx = 0; idx != attractor_count; ++idx)
+	{
+		force += point_force(glm::vec3(attractors[idx]), attractors[idx].w, position, softening * softening);
+	}
+	return force;
+}
+
+void update_particles_barnes_hut(
+	job_system_t& job_system,
+	particle_soa_t& particles,
+	const barnes_hut_tree_t& tree,
+	const particle_update_params_t& params,
+	float theta,
+	float softening)
+{
+	if (tree.nodes.empty()) return;
+
+	const glm::vec3 center_of_mass = glm::vec3(tree.nodes[0].center_of_mass);
+	const float new_dt = params.dt * 50.0f;
+	const float k_weak = 1.0f;
+	const float k_v = 1.5f;
+
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx != end; ++idx)
+		{
+			glm::vec3 pos{particles.x[idx], particles.y[idx], particles.z[idx]};
+			glm::vec3 vel{particles.vx[idx], particles.vy[idx], particles.vz[idx]};
+			float life = particles.life[idx];
+
+			auto bits = random_bits(params.seed, random_stream_particle_update, static_cast<uint32_t>(idx), params.frame_index);
+
+			glm::vec3 f = barnes_hut_force(tree, pos, theta, softening) * k_weak * (1.0f + random_unit(bits.x) - random_unit(bits.y)) / 10.0f;
+			f += random_unit(bits.z) / 100.0f;
+
+			glm::vec3 v = glm::normalize(vel + f * new_dt) * k_v;
+			v += (center_of_mass - pos) * 0.00005f;
+			glm::vec3 s = pos + v * new_dt;
+
+			life -= 0.001f * new_dt;
+			if (life <= 0.0f)
+			{
+				s = -s + (random_unit_lo16(bits.w) - random_unit_hi16(bits.w)) * 20.0f;
+				life = 0.99f;
+			}
+
+			particles.x[idx] = s.x;
+			particles.y[idx] = s.y;
+			particles.z[idx] = s.z;
+			particles.vx[idx] = v.x;
+			particles.vy[idx] = v.y;
+			particles.vz[idx] = v.z;
+			particles.life[idx] = life;
+		}
+	});
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// barnes-hut octree over the attractors, for when there are far more than the 8 that
+// particle.comp loops over. Every particle walks the tree instead of every attractor, and a
+// whole cell is treated as one point mass once it is small enough compared to its distance
+// (cell size / distance < theta, the "opening angle"). That is O(N log M) instead of O(N * M);
+// theta == 0 opens every cell and gives the exact sum.
+//
+// in this mode the attractors pull like softened gravity, with their mass in w:
+//     f = sum m * (a - p) / (|a - p|^2 + softening^2)^(3/2)
+//
+// the tree is a flat array in depth first order, so a node's first child is always the node right
+// after it and `next` skips its whole subtree. That can be walked without a stack, which is what
+// shaders/particle_bh.comp does with the same two buffers (nodes and attractors).
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "particle_engine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// std430 compatible, 48 bytes.
+struct barnes_hut_node_t
+{
+	glm::vec4 center_of_mass; // w = total mass.
+	glm::vec4 cell;           // xyz = cell center, w = cell edge length.
+	uint32_t next;            // the node after this subtree, node_count for the last one.
+	uint32_t first_attractor; // the attractors of this subtree are contiguous in barnes_hut_tree_t::attractors.
+	uint32_t attractor_count;
+	uint32_t is_leaf;
+};
+static_assert(sizeof(barnes_hut_node_t) == 48, "barnes_hut_node_t has to match the glsl struct.");
+
+// morton codes have 10 bits per axis, so this is also the maximum depth.
+const uint32_t barnes_hut_max_depth = 10;
+const uint32_t barnes_hut_leaf_size = 8;
+const float barnes_hut_default_theta = 0.5f;
+const float barnes_hut_default_softening = 0.1f;
+
+struct barnes_hut_tree_t
+{
+	std::vector<barnes_hut_node_t> nodes;
+	// the input attractors, reordered along the tree.
+	std::vector<glm::vec4> attractors;
+};
+
+// builds the tree from scratch. The 8 subtrees below the root are built in parallel and the
+// result is the same for any thread count.
+void barnes_hut_build(barnes_hut_tree_t& tree, job_system_t& job_system, const glm::vec4* attractors, size_t attractor_count);
+
+glm::vec3 barnes_hut_force(const barnes_hut_tree_t& tree, glm::vec3 position, float theta, float softening);
+
+// the O(M) sum, for checking the approximation.
+glm::vec3 direct_attractor_force(const glm::vec4* attractors, size_t attractor_count, glm::vec3 position, float softening);
+
+// particle.comp's update with the attractor field replaced by barnes_hut_force, i.e.
+// particle_bh.comp on the cpu. params.force_point is not used: the particles drift towards the
+// center of mass of all attractors instead.
+void update_particles_barnes_hut(
+	job_system_t& job_system,
+	particle_soa_t& particles,
+	const barnes_hut_tree_t& tree,
+	const particle_update_params_t& params,
+	float theta,
+	float softening);
@@ -0,0 +1,133 @@
+#include "frame_clock.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm> // std::min, std::max
+#include <chrono>
+#include <cmath>
+
+static uint64_t now_ns()
+{
+	using clock = std::chrono::steady_clock;
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count());
+}
+
+static uint32_t bucket_of(double seconds)
+{
+	double bucket = seconds / frame_clock_bucket_width;
+	return bucket >= frame_clock_bucket_count - 1 ? frame_clock_bucket_count - 1 : static_cast<uint32_t>(bucket);
+}
+
+void frame_clock_init(frame_clock_t& clock, double fixed_dt, uint32_t max_steps)
+{
+	clock = {};
+	clock.start_ns = now_ns();
+	clock.last_tick_ns = clock.start_ns;
+	clock.fixed_dt = fixed_dt;
+	clock.max_steps = max_steps;
+}
+
+double frame_clock_tick(frame_clock_t& clock)
+{
+	const uint64_t now = now_ns();
+	clock.raw_dt = static_cast<double>(now - clock.last_tick_ns) * 1e-9;
+	clock.dt = std::min(clock.raw_dt, frame_clock_max_dt);
+	clock.last_tick_ns = now;
+
+	// replace the oldest sample once the window is full.
+	const uint32_t slot = static_cast<uint32_t>(clock.frame_count % frame_clock_window);
+	if (clock.frame_count >= frame_clock_window)
+	{
+		const float oldest = clock.samples[slot];
+		clock.buckets[bucket_of(oldest)] -= 1;
+		clock.window_sum -= oldest;
+	}
+	const float sample = static_cast<float>(clock.raw_dt);
+	clock.samples[slot] = sample;
+	clock.buckets[bucket_of(sample)] += 1;
+	clock.window_sum += sample;
+	clock.frame_count += 1;
+
+	if (clock.fixed_dt > 0.0) clock.accumulator += clock.dt;
+	return clock.dt;
+}
+
+double frame_clock_elapsed(const frame_clock_t& clock)
+{
+	return static_cast<double>(now_ns() - clock.start_ns) * 1e-9;
+}
+
+uint32_t frame_clock_fixed_steps(frame_clock_t& clock)
+{
+	if (clock.fixed_dt <= 0.0) return 0;
+
+	uint32_t step_count = static_cast<uint32_t>(std::floor(clock.accumulator / clock.fixed_dt));
+	if (step_count > clock.max_steps)
+	{
+		// we cannot keep up: drop the time instead of trying to catch up forever.
+		clock.dropped_steps += step_count - clock.max_steps;
+		step_count = clock.max_steps;
+		clock.accumulator = std::fmod(clock.accumulator, clock.fixed_dt);
+		return step_count;
+	}
+	clock.accumulator -= step_count * clock.fixed_dt;
+	return step_count;
+}
+
+double frame_clock_fixed_alpha(const frame_clock_t& clock)
+{
+	if (clock.fixed_dt <= 0.0) return 0.0;
+	return std::min(std::max(clock.accumulator / clock.fixed_dt, 0.0), 1.0);
+}
+
+void frame_clock_get_stats(const frame_clock_t& clock, frame_clock_stats_t& stats)
+{
+	stats = {};
+	stats.frame_count = clock.frame_count;
+	stats.dropped_steps = clock.dropped_steps;
+	stats.sample_count = static_cast<uint32_t>(std::min<uint64_t>(clock.frame_count, frame_clock_window));
+	if (stats.sample_count == 0) return;
+
+	for (uint32_t idx = 0; idx != stats.sample_count; ++idx)
+	{
+		stats.max = std::max(stats.max, static_cast<double>(clock.samples[idx]));
+	}
+	stats.mean = clock.window_sum / stats.sample_count;
+
+	// the upper edge of the bucket that holds the nth sample (never more than the max).
+	const uint32_t ranks[3] = {
+		(stats.sample_count * 50 + 99) / 100,
+		(stats.sample_count * 95 + 99) / 100,
+		(stats.sample_count * 99 + 99) / 100,
+	};
+	double* percentiles[3] = {&stats.p50, &stats.p95, &stats.p99};
+
+	uint32_t seen = 0;
+	uint32_t next = 0;
+	for (uint32_t bucket = 0; bucket != frame_clock_bucket_count && next != 3; ++bucket)
+	{
+		seen += clock.buckets[bucket];
+		while (next != 3 && seen >= ranks[next])
+		{
+			*percentiles[next] = std::min((bucket + 1) * frame_clock_bucket_width, stats.max);
+			next += 1;
+		}
+	}
+}
+
+void frame_clock_report(const frame_clock_t& clock)
+{
+	frame_clock_stats_t stats;
+	frame_clock_get_stats(clock, stats);
+	fmt::print("[frame] last {} frames: mean {:.3f} ms ({:.0f} fps), p50 {:.1f} ms, p95 {:.1f} ms, p99 {:.1f} ms, max {:.3f} ms",
+		stats.sample_count,
+		stats.mean * 1000.0,
+		stats.mean > 0.0 ? 1.0 / stats.mean : 0.0,
+		stats.p50 * 1000.0,
+		stats.p95 * 1000.0,
+		stats.p99 * 1000.0,
+		stats.max * 1000.0);
+	if (clock.fixed_dt > 0.0) fmt::print(", dropped steps {}", stats.dropped_steps);
+	fmt::print("\n");
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// monotonic frame clock. frame_clock_tick measures the frame that just ended, so the dt that is
+// simulated is the one that was actually measured this frame (old_main.cc used to reset the glfw
+// timer every frame and simulate with the dt of the frame before).
+//
+// the last frame_clock_window frame times are kept in a rolling histogram with
+// frame_clock_bucket_width buckets, which is enough for p50/p95/p99 without sorting anything.
+// frame_clock_get_stats fills in a plain struct: no allocation, so it is fine to call every frame.
+//
+// fixed timestep mode: frame_clock_fixed_steps turns the measured time into a whole number of
+// fixed_dt steps and carries the remainder over to the next frame.
+
+#include <array>
+#include <cstdint>
+
+const uint32_t frame_clock_window = 1024;
+// 0.1 ms buckets up to 100 ms, everything slower goes into the last bucket.
+const double frame_clock_bucket_width = 0.0001;
+const uint32_t frame_clock_bucket_count = 1001;
+// anything longer (a breakpoint, a window drag) is simulated as this much time.
+const double frame_clock_max_dt = 0.25;
+
+struct frame_clock_t
+{
+	uint64_t start_ns;
+	uint64_t last_tick_ns;
+	uint64_t frame_count;
+
+	// the last measured frame time, unclamped, and what to simulate with.
+	double raw_dt;
+	double dt;
+
+	// rolling window: samples[frame_count % window] is the oldest sample once the window is full.
+	std::array<float, frame_clock_window> samples;
+	std::array<uint32_t, frame_clock_bucket_count> buckets;
+	double window_sum;
+
+	// fixed timestep mode.
+	double fixed_dt;
+	uint32_t max_steps;
+	double accumulator;
+	// steps that were dropped because a frame needed more than max_steps.
+	uint64_t dropped_steps;
+};
+
+struct frame_clock_stats_t
+{
+	uint64_t frame_count;
+	uint32_t sample_count;
+	// seconds, over the window.
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+	uint64_t dropped_steps;
+};
+
+// fixed_dt == 0 disables the fixed timestep mode.
+void frame_clock_init(frame_clock_t& clock, double fixed_dt = 0.0, uint32_t max_steps = 4);
+// call once per frame. Returns dt (clamped to frame_clock_max_dt).
+double frame_clock_tick(frame_clock_t& clock);
+// seconds since frame_clock_init.
+double frame_clock_elapsed(const frame_clock_t& clock);
+
+// the number of fixed_dt steps to simulate this frame (at most max_steps).
+uint32_t frame_clock_fixed_steps(frame_clock_t& clock);
+// how far we are between the last step and the next one [0, 1), for interpolation.
+double frame_clock_fixed_alpha(const frame_clock_t& clock);
+
+void frame_clock_get_stats(const frame_clock_t& clock, frame_clock_stats_t& stats);
+void frame_clock_report(const frame_clock_t& clock);
@@ -0,0 +1,75 @@
+#include "frame_stats.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <cassert>
+#include <chrono>
+#include <limits>
+
+static void reset_section(frame_stats_section_t& section)
+{
+	section.total = 0.0;
+	section.min = std::numeric_limits<double>::max();
+	section.max = 0.0;
+	section.sample_count = 0;
+}
+
+void frame_stats_init(frame_stats_t& stats, uint32_t report_interval)
+{
+	stats = {};
+	stats.report_interval = report_interval;
+}
+
+uint32_t frame_stats_add_section(frame_stats_t& stats, const char* name)
+{
+	assert(stats.section_count < frame_stats_max_sections);
+	frame_stats_section_t& section = stats.sections[stats.section_count];
+	section.name = name;
+	reset_section(section);
+	return stats.section_count++;
+}
+
+double frame_stats_now()
+{
+	using clock = std::chrono::steady_clock;
+	return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+void frame_stats_record(frame_stats_t& stats, uint32_t section_id, double seconds)
+{
+	frame_stats_section_t& section = stats.sections[section_id];
+	section.total += seconds;
+	if (seconds < section.min) section.min = seconds;
+	if (seconds > section.max) section.max = seconds;
+	section.sample_count += 1;
+}
+
+bool frame_stats_end_frame(frame_stats_t& stats)
+{
+	stats.frame_count += 1;
+	if (stats.report_interval == 0 || stats.frame_count < stats.report_interval) return false;
+
+	frame_stats_report(stats);
+	for (uint32_t idx = 0; idx != stats.section_count; ++idx)
+	{
+		reset_section(stats.sections[idx]);
+	}
+	stats.frame_count = 0;
+	return true;
+}
+
+void frame_stats_report(const frame_stats_t& stats)
+{
+	fmt::print("[frame] {} frames\n", stats.frame_count);
+	for (uint32_t idx = 0; idx != stats.section_count; ++idx)
+	{
+		const frame_stats_section_t& section = stats.sections[idx];
+		if (section.sample_count == 0) continue;
+		fmt::print("[frame]   {:<16} avg {:8.3f} ms  min {:8.3f} ms  max {:8.3f} ms\n",
+			section.name,
+			section.total / section.sample_count * 1000.0,
+			section.min * 1000.0,
+			section.max * 1000.0);
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// per frame timings, aggregated in memory and printed once every report_interval frames.
+// Recording a sample is a few adds into a fixed array: no allocation, no strings, no console i/o
+// inside the frame loop.
+
+#include <array>
+#include <cstdint>
+
+const uint32_t frame_stats_max_sections = 16;
+const uint32_t frame_stats_default_report_interval = 1000;
+
+struct frame_stats_section_t
+{
+	// has to outlive the frame_stats_t (string literals are fine).
+	const char* name;
+	double total;
+	double min;
+	double max;
+	uint32_t sample_count;
+};
+
+struct frame_stats_t
+{
+	std::array<frame_stats_section_t, frame_stats_max_sections> sections;
+	uint32_t section_count;
+	uint32_t frame_count;
+	uint32_t report_interval;
+};
+
+void frame_stats_init(frame_stats_t& stats, uint32_t report_interval = frame_stats_default_report_interval);
+// returns the id to record samples with.
+uint32_t frame_stats_add_section(frame_stats_t& stats, const char* name);
+
+// seconds, monotonic. Only useful for differences.
+double frame_stats_now();
+void frame_stats_record(frame_stats_t& stats, uint32_t section, double seconds);
+
+// prints and resets the sections every report_interval frames. Returns true when it did.
+bool frame_stats_end_frame(frame_stats_t& stats);
+void frame_stats_report(const frame_stats_t& stats);
@@ -0,0 +1,99 @@
+#include "gl_program.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+static std::string resource_name(uint32_t program_id, GLenum interface, GLuint index, GLint name_length)
+{
+	std::string name(static_cast<size_t>(name_length), '\0');
+	GLsizei length = 0;
+	glGetProgramResourceName(program_id, interface, index, name_length, &length, name.data());
+	name.resize(static_cast<size_t>(length));
+
+	// arrays are reported as "name[0]", but we look them up by their plain name.
+	if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+	{
+		name.resize(name.size() - 3);
+	}
+	return name;
+}
+
+// value_property is GL_LOCATION for uniforms and GL_BUFFER_BINDING for blocks.
+static std::vector<gl_program_resource_t> query_resources(uint32_t program_id, GLenum interface, GLenum value_property)
+{
+	std::vector<gl_program_resource_t> resources;
+
+	GLint resource_count = 0;
+	glGetProgramInterfaceiv(program_id, interface, GL_ACTIVE_RESOURCES, &resource_count);
+	resources.reserve(static_cast<size_t>(resource_count));
+
+	for (GLint idx = 0; idx != resource_count; ++idx)
+	{
+		const GLenum properties[] = {GL_NAME_LENGTH, value_property, GL_BLOCK_INDEX};
+		// GL_BLOCK_INDEX only exists for uniforms.
+		const GLsizei property_count = interface == GL_UNIFORM ? 3 : 2;
+		GLint values[3] = {0, -1, -1};
+		glGetProgramResourceiv(program_id, interface, idx, property_count, properties, property_count, nullptr, values);
+
+		// uniforms inside a block have no location of their own.
+		if (interface == GL_UNIFORM && values[2] != -1) continue;
+
+		std::string name = resource_name(program_id, interface, idx, values[0]);
+		resources.push_back({gl_name_hash(name.c_str()), values[1], std::move(name)});
+	}
+
+	return resources;
+}
+
+static int32_t find_resource(const std::vector<gl_program_resource_t>& resources, uint32_t name_hash)
+{
+	for (const auto& resource: resources)
+	{
+		if (resource.name_hash == name_hash) return resource.location;
+	}
+	return -1;
+}
+
+bool gl_program_init(gl_program_t& program, uint32_t program_id)
+{
+	program = {};
+	program.id = program_id;
+
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program_id, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE)
+	{
+		GLint max_length = 0;
+		glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &max_length);
+		std::string info_log(static_cast<size_t>(max_length), '\0');
+		if (max_length > 0) glGetProgramInfoLog(program_id, max_length, &max_length, info_log.data());
+		fmt::print("failed to link program {}. GL error: {}\n", program_id, info_log);
+		return false;
+	}
+
+	program.uniforms       = query_resources(program_id, GL_UNIFORM, GL_LOCATION);
+	program.uniform_blocks = query_resources(program_id, GL_UNIFORM_BLOCK, GL_BUFFER_BINDING);
+	program.storage_blocks = query_resources(program_id, GL_SHADER_STORAGE_BLOCK, GL_BUFFER_BINDING);
+	return true;
+}
+
+void gl_program_destroy(gl_program_t& program)
+{
+	if (program.id != 0) glDeleteProgram(program.id);
+	program = {};
+}
+
+int32_t gl_program_uniform_location(const gl_program_t& program, uint32_t name_hash)
+{
+	return find_resource(program.uniforms, name_hash);
+}
+
+int32_t gl_program_uniform_block_binding(const gl_program_t& program, uint32_t name_hash)
+{
+	return find_resource(program.uniform_blocks, name_hash);
+}
+
+int32_t gl_program_storage_block_binding(const gl_program_t& program, uint32_t name_hash)
+{
+	return find_resource(program.storage_blocks, name_hash);
+}
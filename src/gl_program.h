@@ -0,0 +1,49 @@
+#pragma once
+
+// a linked gl program plus everything we need to look up on it, queried once at link time.
+// Locations are looked up by name hash, an integer compare over a handful of entries instead of a
+// glGetUniformLocation call. Look them up once after linking and keep the ints, not every frame.
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// fnv-1a.
+constexpr uint32_t gl_name_hash(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	while (*name != '\0')
+	{
+		hash ^= static_cast<uint8_t>(*name++);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+struct gl_program_resource_t
+{
+	uint32_t name_hash;
+	// location for uniforms, binding point for blocks.
+	int32_t location;
+	std::string name;
+};
+
+struct gl_program_t
+{
+	uint32_t id;
+	std::vector<gl_program_resource_t> uniforms;
+	std::vector<gl_program_resource_t> uniform_blocks;
+	std::vector<gl_program_resource_t> storage_blocks;
+};
+
+// checks the link status of an already linked program and caches its uniforms and blocks.
+// Returns false (and prints the info log) if the program did not link.
+bool gl_program_init(gl_program_t& program, uint32_t program_id);
+void gl_program_destroy(gl_program_t& program);
+
+// -1 if the program does not have it (or the compiler optimized it out).
+int32_t gl_program_uniform_location(const gl_program_t& program, uint32_t name_hash);
+int32_t gl_program_uniform_block_binding(const gl_program_t& program, uint32_t name_hash);
+int32_t gl_program_storage_block_binding(const gl_program_t& program, uint32_t name_hash);
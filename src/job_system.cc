@@ -0,0 +1,178 @@
+#include "job_system.h"
+
+#include <algorithm> // std::max
+
+// 0 for every thread that is not one of our workers.
+static thread_local size_t current_thread_index = 0;
+
+static uint64_t pack_range(uint64_t begin, uint64_t end)
+{
+	return (begin << 32) | end;
+}
+
+static uint64_t range_begin(uint64_t range) { return range >> 32; }
+static uint64_t range_end(uint64_t range) { return range & 0xffffffff; }
+
+// take the first chunk of our own slice.
+static bool pop_chunk(job_slice_t& slice, uint64_t& chunk_index)
+{
+	uint64_t range = slice.range.load(std::memory_order_acquire);
+	while (range_begin(range) < range_end(range))
+	{
+		uint64_t desired = pack_range(range_begin(range) + 1, range_end(range));
+		if (slice.range.compare_exchange_weak(range, desired, std::memory_order_acq_rel))
+		{
+			chunk_index = range_begin(range);
+			return true;
+		}
+	}
+	return false;
+}
+
+// take the back half of someone else's slice and make it our own.
+static bool steal_chunks(job_slice_t& victim, job_slice_t& own)
+{
+	uint64_t range = victim.range.load(std::memory_order_acquire);
+	while (range_begin(range) < range_end(range))
+	{
+		uint64_t begin = range_begin(range);
+		uint64_t end = range_end(range);
+		uint64_t split = end - (end - begin + 1) / 2;
+		if (victim.range.compare_exchange_weak(range, pack_range(begin, split), std::memory_order_acq_rel))
+		{
+			// our own slice is empty, so nobody else is going to touch it.
+			own.range.store(pack_range(split, end), std::memory_order_release);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void run_chunks(job_system_t& job_system, size_t thread_idx)
+{
+	job_slice_t& own = job_system.slices[thread_idx];
+	const size_t chunk_size = job_system.chunk_size;
+	const size_t count = job_system.count;
+
+	while (true)
+	{
+		uint64_t chunk_index = 0;
+		while (pop_chunk(own, chunk_index))
+		{
+			size_t begin = chunk_index * chunk_size;
+			size_t end = std::min(begin + chunk_size, count);
+			(*job_system.fn)(chunk_index, begin, end);
+		}
+
+		// out of work: walk the other slices, starting with our neighbour so thieves spread out.
+		bool stole = false;
+		for (size_t offset = 1; offset != job_system.thread_count && !stole; ++offset)
+		{
+			size_t victim_idx = (thread_idx + offset) % job_system.thread_count;
+			stole = steal_chunks(job_system.slices[victim_idx], own);
+		}
+		if (!stole) return;
+	}
+}
+
+static void worker_main(job_system_t& job_system, size_t thread_idx)
+{
+	current_thread_index = thread_idx;
+	uint64_t seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(job_system.mutex);
+			job_system.wake_cv.wait(lock, [&] { return job_system.quit || job_system.generation != seen_generation; });
+			if (job_system.quit) return;
+			seen_generation = job_system.generation;
+		}
+
+		run_chunks(job_system, thread_idx);
+
+		{
+			std::lock_guard<std::mutex> lock(job_system.mutex);
+			job_system.busy_workers -= 1;
+			if (job_system.busy_workers == 0) job_system.done_cv.notify_one();
+		}
+	}
+}
+
+void job_system_init(job_system_t& job_system, size_t thread_count)
+{
+	if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	job_system.thread_count = thread_count;
+	job_system.slices = std::make_unique<job_slice_t[]>(thread_count);
+	job_system.workers.reserve(thread_count - 1);
+	for (size_t thread_idx = 1; thread_idx != thread_count; ++thread_idx)
+	{
+		job_system.workers.emplace_back(worker_main, std::ref(job_system), thread_idx);
+	}
+}
+
+void job_system_shutdown(job_system_t& job_system)
+{
+	{
+		std::lock_guard<std::mutex> lock(job_system.mutex);
+		job_system.quit = true;
+	}
+	job_system.wake_cv.notify_all();
+	for (auto& worker: job_system.workers)
+	{
+		worker.join();
+	}
+	job_system.workers.clear();
+	job_system.slices.reset();
+	job_system.thread_count = 0;
+}
+
+void parallel_for(job_system_t& job_system, size_t count, size_t chunk_size, const job_range_fn_t& fn)
+{
+	if (count == 0) return;
+	chunk_size = std::max<size_t>(chunk_size, 1);
+	const size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+	// not worth waking anyone up.
+	if (job_system.thread_count <= 1 || chunk_count == 1)
+	{
+		for (size_t chunk_index = 0; chunk_index != chunk_count; ++chunk_index)
+		{
+			size_t begin = chunk_index * chunk_size;
+			fn(chunk_index, begin, std::min(begin + chunk_size, count));
+		}
+		return;
+	}
+
+	job_system.fn = &fn;
+	job_system.count = count;
+	job_system.chunk_size = chunk_size;
+
+	// hand every thread an equal contiguous slice up front, so stealing is the exception.
+	for (size_t thread_idx = 0; thread_idx != job_system.thread_count; ++thread_idx)
+	{
+		uint64_t begin = chunk_count * thread_idx / job_system.thread_count;
+		uint64_t end = chunk_count * (thread_idx + 1) / job_system.thread_count;
+		job_system.slices[thread_idx].range.store(pack_range(begin, end), std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(job_system.mutex);
+		job_system.busy_workers = job_system.workers.size();
+		job_system.generation += 1;
+	}
+	job_system.wake_cv.notify_all();
+
+	run_chunks(job_system, 0);
+
+	// every worker has to check in before we return, otherwise a late one could
+	// still be looking at the slices when the next parallel_for resets them.
+	std::unique_lock<std::mutex> lock(job_system.mutex);
+	job_system.done_cv.wait(lock, [&] { return job_system.busy_workers == 0; });
+	job_system.fn = nullptr;
+}
+
+size_t job_thread_index()
+{
+	return current_thread_index;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// a small work-stealing job system for data parallel loops (e.g. the particle update).
+//
+// parallel_for splits [0, count) into fixed size chunks. Every thread starts out owning a
+// contiguous slice of the chunks and pops from the front of it; threads that run out steal
+// half of what is left from the back of another thread's slice.
+// chunk boundaries only depend on count and chunk_size, never on the thread count or on who
+// ends up running a chunk, so as long as a chunk only writes to its own range the result is
+// the same for any number of threads.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fn(chunk_index, begin, end)
+using job_range_fn_t = std::function<void(size_t, size_t, size_t)>;
+
+// [begin, end) in chunk indices, packed into one word so it can be updated with a single CAS.
+// padded to a cache line so threads popping from their own slice do not false share.
+struct alignas(64) job_slice_t
+{
+	std::atomic<uint64_t> range{0};
+};
+
+struct job_system_t
+{
+	// thread 0 is the thread that calls parallel_for, the others are workers.
+	size_t thread_count = 0;
+	std::vector<std::thread> workers;
+	std::unique_ptr<job_slice_t[]> slices;
+
+	// the job that is currently running.
+	const job_range_fn_t* fn = nullptr;
+	size_t count = 0;
+	size_t chunk_size = 0;
+
+	std::mutex mutex;
+	std::condition_variable wake_cv;
+	std::condition_variable done_cv;
+	uint64_t generation = 0;
+	size_t busy_workers = 0;
+	bool quit = false;
+};
+
+// thread_count == 0 means one thread per hardware thread.
+void job_system_init(job_system_t& job_system, size_t thread_count = 0);
+void job_system_shutdown(job_system_t& job_system);
+
+// calls fn(chunk_index, begin, end) exactly once for every chunk of [0, count) and returns
+// when all of them are done. The calling thread helps out.
+void parallel_for(job_system_t& job_system, size_t count, size_t chunk_size, const job_range_fn_t& fn);
+
+// the thread a chunk runs on: 0 for the thread that called parallel_for, 1 to thread_count - 1
+// for the workers. For per-thread state (scratch memory, command pools) that chunks can use
+// without locking.
+size_t job_thread_index();
@@ -1,8 +1,5 @@
-#define VK_USE_PLATFORM_WIN32_KHR
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#define GLFW_EXPOSE_NATIVE_WIN32
-#include <GLFW/glfw3native.h>
 #define FMT_HEADER_ONLY
 #include <fmt/core.h> 
 #include <glm/glm.hpp>
@@ -10,15 +7,139 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <array>
+#include <cmath> // sinf, cosf, tanf
 #include <vector>
 #include <set>
-#include <limits> // std::numeric_limits
-#include <algorithm> // std::clamp
+#include <algorithm> // std::remove_if
+#include <cstring> // strcmp
+#include <cstdlib> // strtoul, strtof
+
+#include "barnes_hut.h"
+#include "frame_clock.h"
+#include "job_system.h"
+#include "particle_engine.h" // particle_force_point
+#include "random.h"
+#include "shader_reload.h"
+#include "vk_allocator.h"
+#include "vk_device_select.h"
+#include "vk_descriptors.h"
+#include "vk_frames.h"
+#include "vk_offscreen.h"
+#include "vk_particles.h"
+#include "vk_pipeline_cache.h"
+#include "vk_profiler.h"
+#include "vk_recorder.h"
+#include "vk_render_graph.h"
+#include "vk_scheduler.h"
+#include "vk_swapchain.h"
+#include "vk_transfer.h"
 
 // window specifics
 const uint32_t window_width = 1920;
 const uint32_t window_height = 1080;
 
+// camera (the same as old_main.cc, which never moved it either).
+const float camera_fov = 90.0f;
+const float z_near = 0.5f;
+const float z_far = 10000.0f;
+const glm::vec3 camera_position{-50.1f, 50.0f, 75.0f};
+
+// particles
+const uint32_t default_particle_count = 10000000;
+const uint32_t attractor_count = 8;
+// --barnes-hut: this many attractors, in a barnes-hut tree (barnes_hut.h), the same ones as particle_bench.
+const uint32_t barnes_hut_attractor_count = 4096;
+// particles per secondary command buffer: the draw is recorded on all cores in chunks this size.
+const uint32_t particle_draw_chunk_size = 1 << 20;
+// random numbers (see random.h). Same seed, same particles.
+const uint64_t particle_seed = default_random_seed;
+
+// where the pipeline cache is kept between runs.
+const char* pipeline_cache_directory = "cache";
+// watched by --hot-reload.
+const char* shader_directory = "shaders";
+
+// headless specifics
+const uint32_t default_headless_frame_count = 1000;
+
+// set by the key callback, picked up by the frame loop: switch between mailbox and fifo.
+static bool toggle_present_mode_requested = false;
+// set by the framebuffer size callback: the swapchain no longer matches the window.
+static bool framebuffer_resized = false;
+
+struct options_t
+{
+	// render into offscreen images instead of a window: no glfw, no surface, no swapchain.
+	bool headless = false;
+	uint32_t frame_count = default_headless_frame_count;
+	// copy every frame back to the cpu.
+	bool readback = false;
+	// write the last frame that was read back to this file (implies readback).
+	const char* output_path = nullptr;
+	// load and save the pipeline cache. Off measures a cold start.
+	bool pipeline_cache = true;
+	// more frames in flight: more throughput, more latency.
+	uint32_t frames_in_flight = vk_default_frames_in_flight;
+	// mailbox for latency, fifo for vsync. Toggled with v at runtime.
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// simulated on the gpu. 0 only clears the screen.
+	uint32_t particle_count = default_particle_count;
+	// a physical device name (substring) or uuid, instead of the best scoring one.
+	const char* device = nullptr;
+	// recompile and swap in the particle shaders when they change on disk.
+	bool hot_reload = false;
+	// time the passes on the gpu and the frame on the cpu, and print a summary at the end.
+	bool profile = false;
+	// also write every scope to this file as a chrome trace (implies profile).
+	const char* trace_path = nullptr;
+	// simulate with particle_bh.comp: thousands of attractors through a barnes-hut tree.
+	bool barnes_hut = false;
+	float barnes_hut_theta = barnes_hut_default_theta;
+};
+
+static bool parse_options(int argc, char** argv, options_t& options)
+{
+	for (int idx = 1; idx < argc; ++idx)
+	{
+		const char* arg = argv[idx];
+		const bool has_value = idx + 1 < argc;
+		if (strcmp(arg, "--headless") == 0) options.headless = true;
+		else if (strcmp(arg, "--readback") == 0) options.readback = true;
+		else if (strcmp(arg, "--no-pipeline-cache") == 0) options.pipeline_cache = false;
+		else if (strcmp(arg, "--frames") == 0 && has_value) options.frame_count = static_cast<uint32_t>(strtoul(argv[++idx], nullptr, 10));
+		else if (strcmp(arg, "--particles") == 0 && has_value) options.particle_count = static_cast<uint32_t>(strtoul(argv[++idx], nullptr, 10));
+		else if (strcmp(arg, "--frames-in-flight") == 0 && has_value) options.frames_in_flight = static_cast<uint32_t>(strtoul(argv[++idx], nullptr, 10));
+		else if (strcmp(arg, "--fifo") == 0) options.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+		else if (strcmp(arg, "--mailbox") == 0) options.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+		else if (strcmp(arg, "--device") == 0 && has_value) options.device = argv[++idx];
+		else if (strcmp(arg, "--hot-reload") == 0) options.hot_reload = true;
+		else if (strcmp(arg, "--profile") == 0) options.profile = true;
+		else if (strcmp(arg, "--barnes-hut") == 0)
+		{
+			options.barnes_hut = true;
+			// the opening angle is optional.
+			if (has_value && argv[idx + 1][0] != '-') options.barnes_hut_theta = strtof(argv[++idx], nullptr);
+		}
+		else if (strcmp(arg, "--trace") == 0 && has_value)
+		{
+			options.trace_path = argv[++idx];
+			options.profile = true;
+		}
+		else if (strcmp(arg, "--output") == 0 && has_value)
+		{
+			options.output_path = argv[++idx];
+			options.readback = true;
+		}
+		else
+		{
+			fmt::print("usage: {} [--headless] [--frames n] [--readback] [--output file.ppm] [--no-pipeline-cache] [--frames-in-flight n] [--fifo | --mailbox] [--particles n] [--device name | uuid] [--hot-reload] [--profile] [--trace file.json] [--barnes-hut [theta]]\n", argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
 // vulkan specifics
 
 const std::vector<const char*> enabled_validation_layers = {
@@ -63,6 +184,9 @@ void on_key_pressed(GLFWwindow* window, int key, int scancode, int action, int m
             case GLFW_KEY_ESCAPE:
                 glfwSetWindowShouldClose(window, GLFW_TRUE); // Close the window when the Escape key is pressed
                 break;
+            case GLFW_KEY_V:
+                toggle_present_mode_requested = true; // mailbox <-> fifo
+                break;
             default:
                 // Handle other key presses
                 break;
@@ -73,6 +197,11 @@ void on_key_pressed(GLFWwindow* window, int key, int scancode, int action, int m
     }
 }
 
+void on_framebuffer_resized(GLFWwindow* window, int width, int height)
+{
+	framebuffer_resized = true;
+}
+
 static bool check_validation_layer_support(const std::vector<const char*>& validation_layers)
 {
 	uint32_t layer_count;
@@ -86,20 +215,20 @@ static bool check_validation_layer_support(const std::vector<const char*>& valid
 		bool layer_found = false;
 		for (const auto& layer_properties: available_layers)
 		{
-			fmt::print("supported layer: {}\n", layer_properties.layerName);
 			if (strcmp(layer_name, layer_properties.layerName) == 0)
 			{
 				layer_found = true;
-				break; // huh?
+				break;
 			}
 		}
 		if (!layer_found)
 		{
+			fmt::print("[vk] validation layer {} is not available.\n", layer_name);
 			return false;
 		}
 	}
 
-	return false;
+	return true;
 }
 
 static void populate_DebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& create_info)
@@ -118,6 +247,40 @@ static void populate_DebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT
 
 
 
+// the attractors move around the way simulate() in old_main.cc moves them. step is the frame
+// index of the simulation step, phase is old_main's counter.
+static vk_particle_step_constants_t particle_step_constants(uint32_t step, float dt, float& phase)
+{
+	phase += dt;
+	if (phase >= 1.0f) phase = -0.0001f;
+
+	std::array<glm::vec4, attractor_count> attractors;
+	for (uint32_t idx = 0; idx != attractor_count; ++idx)
+	{
+		glm::uvec4 bits = random_bits(particle_seed, random_stream_attractor_update, idx, step);
+		glm::vec3 offset = random_symmetric3(bits, 100.0f / 500.0f);
+		attractors[idx] = glm::vec4(offset.x * sinf(phase), offset.y * cosf(phase), tanf(phase), 0.0f);
+	}
+
+	vk_particle_step_constants_t constants{};
+	constants.force_point = particle_force_point(attractors.data(), attractor_count);
+	constants.dt = dt;
+	constants.frame_index = step;
+	constants.seed = random_key(particle_seed);
+	return constants;
+}
+
+static glm::mat4 view_projection_matrix(VkExtent2D extent)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(camera_fov), static_cast<float>(extent.width) / static_cast<float>(extent.height), z_near, z_far);
+	// vulkan clip space has y pointing down.
+	projection[1][1] *= -1.0f;
+	glm::mat4 view = glm::lookAt(camera_position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return projection * view;
+}
+
+
+
 #define assert_with_message(condition, message) \
     do { \
         if (!(condition)) { \
@@ -128,18 +291,23 @@ static void populate_DebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT
 
 
 
-int main()
+int main(int argc, char** argv)
 {
+	options_t options{};
+	if (!parse_options(argc, argv, options)) return 1;
+
 	GLFWwindow* main_window = nullptr;
 	uint32_t glfw_extension_count = 0;
-	const char** glfw_required_extensions;
+	const char** glfw_required_extensions = nullptr;
 	// glfw stuff
+	if (!options.headless)
 	{
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 		main_window = glfwCreateWindow(window_width, window_height, "Vulkan", nullptr, nullptr);
 	    // Set the key callback function
     	glfwSetKeyCallback(main_window, on_key_pressed);
+		glfwSetFramebufferSizeCallback(main_window, on_framebuffer_resized);
 
 
 		// get glfw extension count and required extensions for vk.
@@ -163,9 +331,17 @@ int main()
 			fmt::print("\t {}\n", extension.extensionName);
 		}
 	}
+
+	// render farm nodes and ci boxes usually do not have the validation layers installed. Run without them.
+	const bool use_validation_layers = enable_validation_layers && check_validation_layer_support(enabled_validation_layers);
+	if (enable_validation_layers && !use_validation_layers)
+	{
+		fmt::print("[vk] validation layers requested but are not available. Continuing without them.\n");
+	}
+
 	// this is getting messy. We need to add the required glfw extensions _and_ the validation layer extensions together.
 	std::vector<const char*> extensions(glfw_required_extensions, glfw_required_extensions + glfw_extension_count);
-	if (enable_validation_layers)
+	if (use_validation_layers)
 	{
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	}
@@ -178,13 +354,15 @@ int main()
 	app_info.applicationVersion = VK_MAKE_VERSION(1,0,0);
 	app_info.pEngineName = "My Engine";
 	app_info.engineVersion = VK_MAKE_VERSION(1,0,0);
-	app_info.apiVersion = VK_API_VERSION_1_0;
+	// 1.2 for timeline semaphores, which are all we synchronize with. 1.1 brought dedicated
+	// allocations and vkGetPhysicalDeviceMemoryProperties2 (memory budget).
+	app_info.apiVersion = VK_API_VERSION_1_2;
 
 	// setup validation layers
 	VkInstanceCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	create_info.pApplicationInfo = &app_info;
-	if (enable_validation_layers) 
+	if (use_validation_layers) 
 	{
 		create_info.enabledLayerCount = static_cast<uint32_t>(enabled_validation_layers.size());
 		create_info.ppEnabledLayerNames = enabled_validation_layers.data();
@@ -200,19 +378,18 @@ int main()
 
 	// set up debug messenger if we have validation layers on.
 	VkDebugUtilsMessengerCreateInfoEXT debug_create_info{}; 
-	if (enable_validation_layers)
+	if (use_validation_layers)
 	{
 		populate_DebugMessengerCreateInfo(debug_create_info);
 		create_info.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debug_create_info;
 	}
 
-	assert_with_message(enable_validation_layers && !check_validation_layer_support(enabled_validation_layers), "[vk] validation layers requested but are not available.");
 	VkResult result = vkCreateInstance(&create_info, nullptr, &vk_instance);
 	assert_with_message(result == VK_SUCCESS, "[vk] vkCreateInstance failed.");
 
 
 	VkDebugUtilsMessengerEXT debug_messenger{};
-	if (enable_validation_layers)
+	if (use_validation_layers)
 	{
 		VkDebugUtilsMessengerCreateInfoEXT create_info{};
 		populate_DebugMessengerCreateInfo(create_info);
@@ -229,18 +406,9 @@ int main()
 		}
 	}
 
+	// glfw actually create the window surface (this picks the platform surface extension for us).
 	VkSurfaceKHR surface{};
-	{
-		VkWin32SurfaceCreateInfoKHR surface_create_info{};
-		surface_create_info.sType =  VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-		surface_create_info.hwnd = glfwGetWin32Window(main_window);
-		surface_create_info.hinstance = GetModuleHandle(nullptr);
-
-		auto result = vkCreateWin32SurfaceKHR(vk_instance, &surface_create_info, nullptr, &surface);
-		assert_with_message(result == VK_SUCCESS, "[vk][ Failed to vkCreateWin32SurfaceKHR.");
-	}
-
-	// glfw actually create the window surface
+	if (!options.headless)
 	{
 		auto result = glfwCreateWindowSurface(vk_instance, main_window, nullptr, &surface);
 		assert_with_message(result == VK_SUCCESS, "[glfw] failed to create a window surface.");
@@ -248,179 +416,64 @@ int main()
 
 	// --> we have an instance with validation layers and a debug messenger.
 
+	// headless mode has nothing to present to, so it does not need the swapchain either.
+	std::vector<const char*> device_extensions = enabled_device_extensions;
+	if (options.headless)
+	{
+		auto is_swapchain = [](const char* name) { return strcmp(name, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; };
+		device_extensions.erase(std::remove_if(device_extensions.begin(), device_extensions.end(), is_swapchain), device_extensions.end());
+	}
 
 	// physical device
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
 	{
-		// get all physical devices.
 		uint32_t device_count = 0;
 		vkEnumeratePhysicalDevices(vk_instance, &device_count, nullptr);
 		assert_with_message(device_count > 0, "[vk] failed to find any GPU with vulkan support.");
-		std::vector<VkPhysicalDevice> devices(device_count);
-		vkEnumeratePhysicalDevices(vk_instance, &device_count, devices.data());
-
-
-		// do we have any suitable devices?
-		//@FIXME(SJM): we do not distinguish between multiple devices here.
-		for (const auto& device: devices)
-		{
-
-			// do we have discrete gpu and geometry shader support?
-			VkPhysicalDeviceProperties device_properties{};
-			vkGetPhysicalDeviceProperties(device, &device_properties);
-			VkPhysicalDeviceFeatures device_features{};
-			vkGetPhysicalDeviceFeatures(device, &device_features);
-			bool device_has_discrete_gpu_and_geometry_shader = (device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) && device_features.geometryShader;
-
-
-			//what extensions are supported?
-			uint32_t extension_count{};
-			vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
-			std::vector<VkExtensionProperties> available_extensions{extension_count};
-			vkEnumerateDeviceExtensionProperties(device, nullptr, extension_count, available_extensions.data());
-
-			std::set<std::string> required_physical_device_extensions(enabled_device_extensions.begin(), enabled_device_extensions.end());
-
-			for (const auto& extension: available_extensions)
-			{
-				required_physical_device_extensions.erase(extension.extensionName);
-			}
-			bool device_has_required_extensions = required_physical_device_extensions.empty();
-
-			bool device_is_suitable = device_has_discrete_gpu_and_geometry_shader && device_has_required_extensions;
-			fmt::print("[vk] found suitable device: {}\n", device_is_suitable);
-			if (device_is_suitable) physical_device = device;
-		}
-
 
+		// the fastest suitable device, unless --device says otherwise.
+		physical_device = vk_device_select(vk_instance, options.headless ? VK_NULL_HANDLE : surface, device_extensions, options.device);
+		assert_with_message(physical_device != VK_NULL_HANDLE, "[vk] no suitable physical device.");
 	}
 
+	// the profiler resets its queries from the host.
+	VkPhysicalDeviceHostQueryResetFeatures host_query_reset_features{};
+	const bool has_profiler = options.profile && vk_profiler_supported(physical_device, host_query_reset_features);
+	if (options.profile && !has_profiler) fmt::print("[vk] no profiler on this device (needs timestamps and hostQueryReset).\n");
 
-	// @NOTE(SJM): this is actually a prerequisite before deciding whether the physical device is suitable.
-	// Physical device: what swap chain capabilities are supported?
-	struct swap_chain_support_details_t
-	{
-		VkSurfaceCapabilitiesKHR capabilities;
-		std::vector<VkSurfaceFormatKHR> formats;
-		std::vector<VkPresentModeKHR> present_modes;
-	};
-
-	swap_chain_support_details_t swap_chain_support_details{};
+	// optional device extensions: enabled when the device has them.
+	bool has_memory_budget = false;
+	bool has_calibrated_timestamps = false;
 	{
-		vkGetPhysicalDeviceSurfaceCapabilities(physical_device, surface, &details.capabilities);
-
-		uint32_t format_count{};
-		vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, nullptr);
-		assert_with_message(format_count != 0, "[vk] vkGetPhysicalDeviceSurfaceFormatsKHR reports 0 surface formats.");
-		if (format_count != 0)
+		uint32_t extension_count{};
+		vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+		std::vector<VkExtensionProperties> available_extensions(extension_count);
+		vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data());
+		for (const auto& extension: available_extensions)
 		{
-			swap_chain_support_details.formats.resize(format_count);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, swap_chain_support_details.formats.data());
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) has_memory_budget = true;
+			if (has_profiler && strcmp(extension.extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0) has_calibrated_timestamps = true;
 		}
-
-		uint32_t present_mode_count{};
-		vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, nullptr);
-		assert_with_message(present_mode_count != 0, "[vk] vkGetPhysicalDeviceSurfacePresentModesKHR reports 0 present modes.");
-		if (present_mode_count != 0)
-		{
-			swap_chain_support_details.present_modes.resize(present_mode_count);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, swap_chain_support_details.present_modes.data()	);
-		}
-
-		assert_with_message(!swap_chain_support_details.formats.empty() && !swap_chain_support_details.present_modes.empty(), "[vk] no formats or present_modes.");
-
-		// choose the right  (swap) surface format.
-		VkSurfaceFormatKHR suitable_surface_format = {};
-		for (const auto& available_format: swap_chain_support_details.formats)
-		{
-			if (available_format.format == VK_FORMAT_B8G8R8A8_SRGB && avilable_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
-			{
-				suitable_surface_format = available_format;
-				break;
-			}
-		}
-
-		// choose the right (swap) presentation mode. default to double buffer FIFO.
-		VkPresentModeKHR suitable_present_mode = VK_PRESENT_MODE_FIFO_KHR; 
-		for (const auto& available_present_mode: swap_chain_support_details.present_modes)
-		{
-			if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
-			{
-				suitable_present_mode = available_present_mode;
-			}
-		}
-
-		// choose swap extent.
-		// the swap extent is the resolution of the swap chain images and it's almost exactly equal to the resolution of the window that we're drawin to in pixels.
-		VkExtend2D suitable_swap_extent{};
-		if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
-		{
-			suitable_swap_extent = capabilities.currentExtent;
-
-		}
-		else 
-		{
-			int width = {};
-			int height = {};
-
-			glfwGetFrameBufferSize(window, &width, &height);
-
-			VkExtend2D actual_extent = {
-				static_Cast<uint32_t>{width},
-				static_Cast<uint32_t>{height}
-			};
-
-			actual_extent.width = std::clamp(
-				actual_extent.width,
-				capabilities.minImageExtent.width,
-				capabilities.maxImageExtent.width);
-			
-			actual_extent.height = std::clamp(
-				actual_extent.height,
-				capabilities.minImageExtent.height,
-				capabilities.maxImageExtent.height);
-
-			suitable_swap_extent = actual_extent;
-		}
-
-
-		// actually create the swap chain.
-
-		uint32_t image_count = swap_chain_support_details.capabilities.minImageCount + 1; // request 1 over minimum?
-
-		// we should not exceed max images.
-		if (swap_chain_support_details.capabilities.maxImageCount > 0 && image_count > swap_chain_support_details.capabilities.maxImageCount)
-		{
-			image_count = swap_chain_support_details.capabilities.maxImageCount;
-		}
-
-		VkSwapChainCreateInfoKHR swap_chain_create_info{};
-		swap_chain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_swap_chain_create_info_KHR;
-		swap_chain_create_info.surface = surface;
-		swap_chain_create_info.minImageCount = image_count;
-		swap_chain_create_info.imageFormat = suitable_surface_format.format;
-		swap_chain_create_info.ColorSpace = suitable_surface_format.colorSpace;
-		swap_chain_create_info.imageExtent = suitable_swap_extent;
-		swap_chain_create_info.imageArrayLayers = 1; // the amouint of layers each image consists of (always 1 unless we do stereoscopiuc 3d application?  VR?)
-		swap_chain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		if (has_memory_budget) device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (has_calibrated_timestamps) device_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
 	}
 
 
-
-
 	// @NOTE(SJM): this is actually a prerequisite before deciding whether the physical device is suitable.
 	// Physical device: which queue families are supported?
-	// -1 is sentinel value.
+	// UINT32_MAX is the sentinel value.
 	struct queue_family_indices_t {
-		uint32_t graphics_family = -1; 
-		uint32_t present_family = -1;
+		uint32_t graphics_family = UINT32_MAX;
+		uint32_t present_family = UINT32_MAX;
+		uint32_t compute_family = UINT32_MAX;
+		uint32_t transfer_family = UINT32_MAX;
 	};
 
 	queue_family_indices_t indices; // 
 	{
-		auto queue_family_indices_is_complete = [](queue_family_indices_t& indices) -> bool 
+		auto queue_family_indices_is_complete = [&options](queue_family_indices_t& indices) -> bool 
 		{
-			return (indices.graphics_family != -1  && indices.present_family != -1);
+			return (indices.graphics_family != UINT32_MAX && (options.headless || indices.present_family != UINT32_MAX));
 		};
 
 
@@ -431,17 +484,17 @@ int main()
 		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
 
 
-		for (size_t idx = 0; idx != queue_family_count; ++idx)
+		for (uint32_t idx = 0; idx != queue_family_count; ++idx)
 		{
 			if (queue_families[idx].queueFlags & VK_QUEUE_GRAPHICS_BIT)
 			{
 				indices.graphics_family = idx;
 			}
 
+			// also get the present support (i.e. "can we present something to a surface")
 			VkBool32 present_support = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, idx, surface, &present_support);
+			if (!options.headless) vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, idx, surface, &present_support);
 
-			// also get the present support (i.e. "can we present something to a surface")
 			if (present_support)
 			{
 				indices.present_family = idx;
@@ -453,8 +506,37 @@ int main()
 			}
 
 		}
-		assert_with_message(indices.graphics_family != -1, "[vk] no queues found that have VK_QUEUE_GRAPHICS_BIT set.");
-		assert_with_message(indices.present_family  != -1, "[vk] no queues found that have present support.");
+		// nothing is presented in headless mode, the graphics queue stands in for the present queue.
+		if (options.headless) indices.present_family = indices.graphics_family;
+
+		// a compute family without graphics runs next to the graphics queue (async compute). Without
+		// one, compute goes on the graphics queue.
+		for (uint32_t idx = 0; idx != queue_family_count; ++idx)
+		{
+			const VkQueueFlags flags = queue_families[idx].queueFlags;
+			if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				indices.compute_family = idx;
+				break;
+			}
+		}
+		if (indices.compute_family == UINT32_MAX) indices.compute_family = indices.graphics_family;
+
+		// a transfer only family is the copy engine on discrete gpus: uploads run next to both
+		// the graphics and the compute queue. Without one, they go on the graphics queue.
+		for (uint32_t idx = 0; idx != queue_family_count; ++idx)
+		{
+			const VkQueueFlags flags = queue_families[idx].queueFlags;
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+			{
+				indices.transfer_family = idx;
+				break;
+			}
+		}
+		if (indices.transfer_family == UINT32_MAX) indices.transfer_family = indices.graphics_family;
+
+		assert_with_message(indices.graphics_family != UINT32_MAX, "[vk] no queues found that have VK_QUEUE_GRAPHICS_BIT set.");
+		assert_with_message(indices.present_family  != UINT32_MAX, "[vk] no queues found that have present support.");
 	}
 	
 
@@ -465,15 +547,28 @@ int main()
 		device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
 		// these extensions have been checked to be supported by the physical device.
-		device_create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
-		device_create_info.ppEnabledExtensionNames = enabled_ex.data();
+		device_create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+		device_create_info.ppEnabledExtensionNames = device_extensions.data();
 
 
 		VkPhysicalDeviceFeatures device_features{}; // default 0 for now.
 		device_create_info.pEnabledFeatures= &device_features;
+
+		// checked when picking the physical device.
+		VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features{};
+		timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		timeline_features.timelineSemaphore = VK_TRUE;
+		device_create_info.pNext = &timeline_features;
+		// the optional features go after it.
+		void** features_next = &timeline_features.pNext;
+		if (has_profiler)
+		{
+			*features_next = &host_query_reset_features;
+			features_next = &host_query_reset_features.pNext;
+		}
 		// this is not strictly necessary apparently but we do it anyway(?)
 		
-		if (enable_validation_layers)
+		if (use_validation_layers)
 		{
 			device_create_info.enabledLayerCount = static_cast<uint32_t>(enabled_validation_layers.size());
 			device_create_info.ppEnabledLayerNames = enabled_validation_layers.data();
@@ -484,7 +579,7 @@ int main()
 
 		// create the presentation queue and retrieve the VkQueue handle.
 		std::vector<VkDeviceQueueCreateInfo> queue_create_infos{};
-		std::set<uint32_t> unique_queue_families = {indices.graphics_family, indices.present_family};
+		std::set<uint32_t> unique_queue_families = {indices.graphics_family, indices.present_family, indices.compute_family, indices.transfer_family};
 
 		float queue_priority = 1.0f;
 		for (auto queue_family: unique_queue_families)
@@ -513,17 +608,463 @@ int main()
 	{
 		vkGetDeviceQueue(device, indices.present_family, 0, &present_queue);
 	}
+	VkQueue compute_queue{};
+	if (indices.compute_family != indices.graphics_family)
+	{
+		vkGetDeviceQueue(device, indices.compute_family, 0, &compute_queue);
+	}
 
+	VkQueue transfer_queue{};
+	if (indices.transfer_family != indices.graphics_family)
+	{
+		vkGetDeviceQueue(device, indices.transfer_family, 0, &transfer_queue);
+	}
 
+	// every submit goes through the scheduler, which signals a timeline semaphore per queue.
+	// Compute and transfer share the graphics queue (and its timeline) when they have no family of
+	// their own.
+	vk_scheduler_t scheduler{};
+	{
+		bool scheduler_ok = vk_scheduler_init(scheduler, device, graphics_queue, indices.graphics_family, compute_queue, indices.compute_family, transfer_queue, indices.transfer_family);
+		assert_with_message(scheduler_ok, "[vk] failed to create the scheduler.");
+	}
 
+	// all device memory comes from here.
+	vk_allocator_t allocator{};
+	vk_allocator_init(allocator, physical_device, device, app_info.apiVersion, has_memory_budget);
 
-	while (!glfwWindowShouldClose(main_window))
+	// every pipeline is created through this cache, so the second launch does not compile them again.
+	vk_pipeline_cache_t pipeline_cache{};
 	{
-		glfwPollEvents();
+		bool pipeline_cache_ok = vk_pipeline_cache_init(pipeline_cache, physical_device, device, options.pipeline_cache ? pipeline_cache_directory : nullptr);
+		assert_with_message(pipeline_cache_ok, "[vk] failed to create the pipeline cache.");
 	}
 
 
+	// every bulk upload goes through the staging ring, on the transfer queue.
+	vk_transfer_t transfer{};
+	{
+		bool transfer_ok = vk_transfer_init(transfer, allocator, scheduler);
+		assert_with_message(transfer_ok, "[vk] failed to create the transfer ring.");
+	}
+
+	// command pools, command buffers and semaphores for every frame in flight. Shared by the
+	// headless and the windowed loop.
+	vk_frames_t frames{};
+	{
+		bool frames_ok = vk_frames_init(frames, scheduler, options.frames_in_flight);
+		assert_with_message(frames_ok, "[vk] failed to create the frames in flight.");
+	}
+
+	// descriptor set layouts are shared through the cache. The only sets are the particles' own,
+	// which live as long as the particles (vk_particles.cc).
+	vk_descriptor_layout_cache_t layout_cache{};
+	vk_descriptor_layout_cache_init(layout_cache, device);
+
+	// --profile: gpu scopes in the frame's command buffer, cpu scopes around recording and submit.
+	vk_profiler_t profiler{};
+	const bool profiler_enabled = has_profiler &&
+		vk_profiler_init(profiler, physical_device, device, scheduler, options.frames_in_flight, has_calibrated_timestamps, options.trace_path != nullptr);
+	vk_profiler_t* frame_profiler = profiler_enabled ? &profiler : nullptr;
+	auto begin_gpu_scope = [&](VkCommandBuffer command_buffer, const char* name)
+	{
+		if (profiler_enabled) vk_profiler_begin(profiler, command_buffer, vk_queue_kind_t::graphics, name);
+	};
+	auto end_gpu_scope = [&](VkCommandBuffer command_buffer)
+	{
+		if (profiler_enabled) vk_profiler_end(profiler, command_buffer, vk_queue_kind_t::graphics);
+	};
+	auto begin_cpu_scope = [&](const char* name)
+	{
+		if (profiler_enabled) vk_profiler_cpu_begin(profiler, name);
+	};
+	auto end_cpu_scope = [&]()
+	{
+		if (profiler_enabled) vk_profiler_cpu_end(profiler);
+	};
+
+	job_system_t job_system{};
+	job_system_init(job_system);
+
+	// a command pool per job thread per frame in flight, for the secondary command buffers.
+	vk_recorder_t recorder{};
+	{
+		bool recorder_ok = vk_recorder_init(recorder, device, job_system, indices.graphics_family, options.frames_in_flight);
+		assert_with_message(recorder_ok, "[vk] failed to create the recorder.");
+	}
+
+	// barnes-hut mode: the attractors do not move, the tree is built once.
+	barnes_hut_tree_t barnes_hut_tree{};
+	if (options.barnes_hut)
+	{
+		std::vector<glm::vec4> attractors(barnes_hut_attractor_count);
+		for (uint32_t idx = 0; idx != barnes_hut_attractor_count; ++idx)
+		{
+			glm::uvec4 bits = random_bits(particle_seed, random_stream_attractor_init, idx);
+			attractors[idx] = glm::vec4(random_symmetric3(bits, 500.0f / 30.0f), 1.0f);
+		}
+		barnes_hut_build(barnes_hut_tree, job_system, attractors.data(), attractors.size());
+	}
+
+	// the particles are optional: without the compiled shaders we only clear the screen.
+	vk_particles_t particles{};
+	bool particles_enabled = options.particle_count != 0 &&
+		vk_particles_init(particles, allocator, scheduler, transfer, layout_cache, pipeline_cache.cache, job_system, options.particle_count, options.frames_in_flight, particle_seed,
+			options.barnes_hut ? &barnes_hut_tree : nullptr, options.barnes_hut_theta);
+	auto create_particle_draw_pipeline = [&](VkRenderPass render_pass)
+	{
+		if (particles_enabled && !vk_particles_create_draw_pipeline(particles, pipeline_cache.cache, render_pass))
+		{
+			vk_particles_destroy(particles);
+			particles_enabled = false;
+		}
+	};
+	// started once the draw pipeline exists, stopped before its render pass goes away. The rebuilds
+	// compile with a worker cache of their own, merged back when the pipeline cache is saved.
+	shader_reload_t shader_reload{};
+	VkPipelineCache reload_pipeline_cache = VK_NULL_HANDLE;
+	auto start_shader_reload = [&]()
+	{
+		if (!options.hot_reload || !particles_enabled) return;
+		reload_pipeline_cache = vk_pipeline_cache_create_worker(pipeline_cache, device);
+		if (reload_pipeline_cache == VK_NULL_HANDLE)
+		{
+			fmt::print("[reload] failed to create a pipeline cache for the reload thread.\n");
+			return;
+		}
+		// read here, before the reload thread runs: the frame loop swaps the draw pipeline later.
+		const bool has_draw_pipeline = particles.draw_pipeline != VK_NULL_HANDLE;
+		shader_reload_init(shader_reload, shader_directory);
+		shader_reload_watch(shader_reload, {options.barnes_hut ? "particle_bh.comp" : "particle_sim.comp"},
+			[&]() { return vk_particles_rebuild_compute_pipeline(particles, reload_pipeline_cache); },
+			[&]() { vk_particles_swap_compute_pipeline(particles); });
+		if (has_draw_pipeline)
+		{
+			shader_reload_watch(shader_reload, {"particle_draw.vert", "particle_draw.frag"},
+				[&]() { return vk_particles_rebuild_draw_pipeline(particles, reload_pipeline_cache); },
+				[&]() { vk_particles_swap_draw_pipeline(particles); });
+		}
+		shader_reload_start(shader_reload);
+	};
+	// at the frame boundary: nothing of the new frame is recorded yet. Only the swap callbacks put
+	// pipelines in, under the reload's lock and only after their build finished.
+	auto apply_shader_reload = [&]()
+	{
+		if (!particles_enabled) return;
+		shader_reload_apply(shader_reload);
+		vk_particles_collect_pipelines(particles);
+	};
+	float attractor_phase = 0.0f;
+
+	frame_clock_t clock{};
+	frame_clock_init(clock);
+
+	// the step that is drawn next. Simulating step n + 1 is submitted before frame n is, so the
+	// compute queue works on it while graphics draws step n.
+	uint64_t particle_step = 0;
+	if (particles_enabled) particle_step = vk_particles_simulate(particles, particle_step_constants(0, 0.0f, attractor_phase));
+
+	// in the frame's command buffer, outside and inside the render pass.
+	uint64_t draw_step = 0;
+	auto simulate_and_acquire_particles = [&](VkCommandBuffer command_buffer)
+	{
+		if (!particles_enabled) return;
+		draw_step = particle_step;
+		particle_step = vk_particles_simulate(particles, particle_step_constants(static_cast<uint32_t>(draw_step + 1), static_cast<float>(clock.dt), attractor_phase), frame_profiler);
+		vk_particles_acquire(particles, command_buffer, draw_step);
+	};
+	// inside a render pass that takes secondary command buffers.
+	auto draw_particles = [&](VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D extent)
+	{
+		if (!particles_enabled) return;
+		const glm::mat4 matrix = view_projection_matrix(extent);
+		vk_recorder_record(recorder, command_buffer, render_pass, framebuffer, particles.count, particle_draw_chunk_size, [&](VkCommandBuffer secondary, size_t begin, size_t end)
+		{
+			vk_particles_draw(particles, secondary, draw_step, extent, matrix, static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin));
+		});
+	};
+	auto release_particles = [&](VkCommandBuffer command_buffer, vk_submit_t& submit)
+	{
+		if (!particles_enabled) return;
+		vk_particles_release(particles, command_buffer, draw_step);
+		vk_submit_wait(submit, scheduler, vk_particles_step_point(particles, draw_step), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+	};
+	auto particles_drawn = [&](const vk_frame_t& frame)
+	{
+		if (particles_enabled) vk_particles_drawn(particles, draw_step, frame.submitted);
+	};
+
+	if (options.headless)
+	{
+		// one target per frame in flight: the target is free again when its frame slot is.
+		vk_offscreen_t offscreen{};
+		const bool offscreen_ok = vk_offscreen_init(offscreen, allocator, {window_width, window_height}, options.frames_in_flight, options.readback);
+		assert_with_message(offscreen_ok, "[vk] failed to create the offscreen targets.");
+		create_particle_draw_pipeline(offscreen.render_pass);
+		start_shader_reload();
+
+		// draw into the frame's target, then copy it back. The passes record the frame in frame_slot.
+		uint32_t frame_slot = 0;
+		uint64_t frame_index = 0;
+		VkClearColorValue clear_color{};
+		vk_render_graph_t frame_graph{};
+		vk_render_graph_init(frame_graph, allocator);
+		// every frame draws all of the target: what the frame before left in it does not matter.
+		const uint32_t target = vk_render_graph_import_image(frame_graph, "target", VK_IMAGE_ASPECT_COLOR_BIT,
+			options.readback ? vk_render_graph_usage_t::transfer_src : vk_render_graph_usage_t::color_attachment, vk_render_graph_usage_t::none, true);
+		const uint32_t draw_pass = vk_render_graph_add_pass(frame_graph, "draw", [&](VkCommandBuffer command_buffer)
+		{
+			vk_offscreen_begin_frame(offscreen, command_buffer, frame_slot, frame_index, clear_color, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			draw_particles(command_buffer, offscreen.render_pass, offscreen.targets[frame_slot].framebuffer, offscreen.extent);
+			vk_offscreen_end_frame(offscreen, command_buffer, frame_slot);
+		});
+		vk_render_graph_use(frame_graph, draw_pass, target, vk_render_graph_usage_t::color_attachment);
+		uint32_t readback_buffer = 0;
+		if (options.readback)
+		{
+			readback_buffer = vk_render_graph_import_buffer(frame_graph, "readback", vk_render_graph_usage_t::none, vk_render_graph_usage_t::host_read);
+			const uint32_t readback_pass = vk_render_graph_add_pass(frame_graph, "readback", [&](VkCommandBuffer command_buffer)
+			{
+				vk_offscreen_copy_readback(offscreen, command_buffer, frame_slot);
+			});
+			vk_render_graph_use(frame_graph, readback_pass, target, vk_render_graph_usage_t::transfer_src);
+			vk_render_graph_use(frame_graph, readback_pass, readback_buffer, vk_render_graph_usage_t::transfer_dst);
+		}
+		const bool frame_graph_ok = vk_render_graph_compile(frame_graph);
+		assert_with_message(frame_graph_ok, "[vk] failed to compile the frame graph.");
+
+		for (uint32_t frame_idx = 0; frame_idx != options.frame_count; ++frame_idx)
+		{
+			vk_frame_t& frame = vk_frames_begin(frames);
+			vk_recorder_begin_frame(recorder, frame.slot);
+			apply_shader_reload();
+			if (profiler_enabled) vk_profiler_begin_frame(profiler);
+
+			// something that changes every frame, so the readback is easy to check.
+			const float t = static_cast<float>(frame_idx) / static_cast<float>(options.frame_count);
+			clear_color = {{t, 0.25f, 1.0f - t, 1.0f}};
+			frame_slot = frame.slot;
+			frame_index = frame.frame_index;
+			vk_render_graph_set_image(frame_graph, target, offscreen.targets[frame.slot].image);
+			if (options.readback) vk_render_graph_set_buffer(frame_graph, readback_buffer, offscreen.targets[frame.slot].readback_buffer);
+
+			begin_cpu_scope("record");
+			begin_gpu_scope(frame.command_buffer, "frame");
+			simulate_and_acquire_particles(frame.command_buffer);
+			vk_render_graph_execute(frame_graph, frame.command_buffer, frame_profiler);
+
+			vk_submit_t submit{};
+			release_particles(frame.command_buffer, submit);
+			end_gpu_scope(frame.command_buffer);
+			end_cpu_scope();
+			begin_cpu_scope("submit");
+			bool frame_ok = vk_frames_submit(frames, frame, submit);
+			end_cpu_scope();
+			assert_with_message(frame_ok, "[vk] failed to render an offscreen frame.");
+			particles_drawn(frame);
+			frame_clock_tick(clock);
+		}
+		vk_frames_wait_idle(frames);
+		shader_reload_stop(shader_reload);
+		vk_offscreen_finish(offscreen);
+
+		const double elapsed = frame_clock_elapsed(clock);
+		fmt::print("[headless] {} frames of {}x{} in {:.3f} s: {:.1f} fps\n", options.frame_count, window_width, window_height, elapsed, options.frame_count / elapsed);
+		if (options.readback)
+		{
+			fmt::print("[headless] read back {:.1f} MB ({:.1f} MB/s)\n", offscreen.readback_bytes / 1e6, offscreen.readback_bytes / 1e6 / elapsed);
+		}
+		fmt::print("[headless] waited for the gpu {} times ({:.3f} s) with {} frames in flight.\n", frames.wait_count, frames.wait_time, frames.frames.size());
+		frame_clock_report(clock);
+		vk_allocator_update_budget(allocator);
+		vk_allocator_report(allocator);
+
+		if (options.output_path != nullptr)
+		{
+			bool write_ok = vk_offscreen_write_ppm(offscreen, options.output_path);
+			fmt::print("[headless] {} frame {} to {}\n", write_ok ? "wrote" : "failed to write", offscreen.last_readback_frame, options.output_path);
+		}
+
+		vk_render_graph_destroy(frame_graph);
+		vk_offscreen_destroy(offscreen, device);
+	}
+	else
+	{
+		auto framebuffer_extent = [main_window]() -> VkExtent2D
+		{
+			int width = {};
+			int height = {};
+			glfwGetFramebufferSize(main_window, &width, &height);
+			return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+		};
+
+		vk_swapchain_t swapchain{};
+		{
+			bool swapchain_ok = vk_swapchain_create(swapchain, physical_device, device, surface, framebuffer_extent(), options.present_mode, indices.graphics_family, indices.present_family);
+			assert_with_message(swapchain_ok, "[vk] failed to create the swapchain.");
+		}
+		// the render pass outlives every recreation, and viewport and scissor are dynamic: the
+		// pipeline never has to be made again.
+		create_particle_draw_pipeline(swapchain.render_pass);
+		start_shader_reload();
+
+		// draw into the acquired image, which is presented after. The pass records into image_index.
+		uint32_t image_index{};
+		vk_render_graph_t frame_graph{};
+		vk_render_graph_init(frame_graph, allocator);
+		// the submit waits for the image acquired semaphore at color attachment output, so that is
+		// where the layout transition waits too.
+		const uint32_t swapchain_image = vk_render_graph_import_image(frame_graph, "swapchain", VK_IMAGE_ASPECT_COLOR_BIT,
+			vk_render_graph_usage_t::color_attachment, vk_render_graph_usage_t::present, true);
+		const uint32_t draw_pass = vk_render_graph_add_pass(frame_graph, "draw", [&](VkCommandBuffer command_buffer)
+		{
+			VkClearValue clear_value{};
+			clear_value.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+			VkRenderPassBeginInfo render_pass_begin_info{};
+			render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			render_pass_begin_info.renderPass = swapchain.render_pass;
+			render_pass_begin_info.framebuffer = swapchain.framebuffers[image_index];
+			render_pass_begin_info.renderArea = {{0, 0}, swapchain.extent};
+			render_pass_begin_info.clearValueCount = 1;
+			render_pass_begin_info.pClearValues = &clear_value;
+			vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			draw_particles(command_buffer, swapchain.render_pass, swapchain.framebuffers[image_index], swapchain.extent);
+			vkCmdEndRenderPass(command_buffer);
+		});
+		vk_render_graph_use(frame_graph, draw_pass, swapchain_image, vk_render_graph_usage_t::color_attachment);
+		const bool frame_graph_ok = vk_render_graph_compile(frame_graph);
+		assert_with_message(frame_graph_ok, "[vk] failed to compile the frame graph.");
+
+		// no waiting for the gpu: the old swapchain is retired and destroyed once the frames that
+		// still use it are done.
+		bool swapchain_out_of_date = false;
+		auto recreate_swapchain = [&]() -> bool
+		{
+			if (!vk_swapchain_recreate(swapchain, scheduler, physical_device, device, surface, framebuffer_extent(), options.present_mode, indices.graphics_family, indices.present_family)) return false;
+			framebuffer_resized = false;
+			swapchain_out_of_date = false;
+			return true;
+		};
+
+		while (!glfwWindowShouldClose(main_window))
+		{
+			glfwPollEvents();
+
+			if (toggle_present_mode_requested)
+			{
+				toggle_present_mode_requested = false;
+				options.present_mode = (swapchain.present_mode == VK_PRESENT_MODE_FIFO_KHR) ? VK_PRESENT_MODE_MAILBOX_KHR : VK_PRESENT_MODE_FIFO_KHR;
+				// the present mode is baked into the swapchain.
+				if (vk_swapchain_choose_present_mode(swapchain, options.present_mode) != swapchain.present_mode) swapchain_out_of_date = true;
+				else fmt::print("[vk] present mode {} is not supported.\n", vk_present_mode_name(options.present_mode));
+			}
+
+			if (framebuffer_resized || swapchain_out_of_date)
+			{
+				// minimized: nothing to draw into until the window comes back.
+				if (!recreate_swapchain())
+				{
+					glfwWaitEvents();
+					continue;
+				}
+			}
+			vk_swapchain_collect(swapchain, scheduler, device);
+
+			vk_frame_t& frame = vk_frames_begin(frames);
+			vk_recorder_begin_frame(recorder, frame.slot);
+			apply_shader_reload();
+			if (profiler_enabled) vk_profiler_begin_frame(profiler);
+
+			VkResult acquire_result = vkAcquireNextImageKHR(device, swapchain.swapchain, UINT64_MAX, frame.image_acquired, VK_NULL_HANDLE, &image_index);
+			// nothing was acquired, so nothing waits on the semaphore: recreate and try again. A
+			// suboptimal swapchain still gave us an image (and will signal the semaphore), so that
+			// frame is drawn and presented first.
+			if (acquire_result == VK_SUBOPTIMAL_KHR) swapchain_out_of_date = true;
+			else if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				swapchain_out_of_date = true;
+				continue;
+			}
+			else if (acquire_result != VK_SUCCESS)
+			{
+				// a lost surface or device fails the same way next time: give up instead of spinning.
+				assert_with_message(acquire_result >= 0, "[vk] failed to acquire a swapchain image.");
+				continue;
+			}
+
+			begin_cpu_scope("record");
+			begin_gpu_scope(frame.command_buffer, "frame");
+			simulate_and_acquire_particles(frame.command_buffer);
+			vk_render_graph_set_image(frame_graph, swapchain_image, swapchain.images[image_index]);
+			vk_render_graph_execute(frame_graph, frame.command_buffer, frame_profiler);
+
+			VkSemaphore render_finished = swapchain.render_finished[image_index];
+			vk_submit_t submit{};
+			release_particles(frame.command_buffer, submit);
+			end_gpu_scope(frame.command_buffer);
+			end_cpu_scope();
+			vk_submit_wait_binary(submit, frame.image_acquired, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+			vk_submit_signal_binary(submit, render_finished);
+			begin_cpu_scope("submit");
+			bool frame_ok = vk_frames_submit(frames, frame, submit);
+			end_cpu_scope();
+			assert_with_message(frame_ok, "[vk] failed to submit a frame.");
+			particles_drawn(frame);
+
+			VkPresentInfoKHR present_info{};
+			present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			present_info.waitSemaphoreCount = 1;
+			present_info.pWaitSemaphores = &render_finished;
+			present_info.swapchainCount = 1;
+			present_info.pSwapchains = &swapchain.swapchain;
+			present_info.pImageIndices = &image_index;
+			VkResult present_result = vkQueuePresentKHR(present_queue, &present_info);
+			if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR) swapchain_out_of_date = true;
+			else assert_with_message(present_result == VK_SUCCESS, "[vk] failed to present.");
+
+			frame_clock_tick(clock);
+		}
+
+		vk_frames_wait_idle(frames);
+		shader_reload_stop(shader_reload);
+		vkQueueWaitIdle(present_queue);
+		frame_clock_report(clock);
+		vk_render_graph_destroy(frame_graph);
+		vk_swapchain_destroy(swapchain, device);
+	}
+
+	// the last step may still be running on the compute queue.
+	vk_scheduler_wait_idle(scheduler);
+	if (profiler_enabled)
+	{
+		// the frames still in the ring.
+		for (size_t idx = 0; idx != profiler.frames.size(); ++idx) vk_profiler_begin_frame(profiler);
+		vk_profiler_report(profiler);
+		if (options.trace_path != nullptr)
+		{
+			bool trace_ok = vk_profiler_write_trace(profiler, options.trace_path);
+			fmt::print("[profiler] {} the trace to {}\n", trace_ok ? "wrote" : "failed to write", options.trace_path);
+		}
+		vk_profiler_destroy(profiler);
+	}
+	vk_particles_destroy(particles);
+	vk_recorder_destroy(recorder);
+	job_system_shutdown(job_system);
+	vk_descriptor_layout_cache_destroy(layout_cache);
+	vk_frames_destroy(frames);
+	vk_transfer_destroy(transfer);
+
+	vk_pipeline_cache_save(pipeline_cache, device);
+	vk_pipeline_cache_destroy(pipeline_cache, device);
+	vk_allocator_destroy(allocator);
+	vk_scheduler_wait_idle(scheduler);
+	vk_scheduler_destroy(scheduler);
+
+	vkDestroyDevice(device, nullptr);
+
 	// destroy debug messenger.
+	if (use_validation_layers)
 	{
 		auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)(vkGetInstanceProcAddr(vk_instance, "vkDestroyDebugUtilsMessengerEXT")); // does the instance need to exist at this point in time?
 		if (func != nullptr)
@@ -537,12 +1078,15 @@ int main()
 	}
 
 	// destroy the surface.
-	vkDestroySurfaceKHR(vk_instance, surface, nullptr);
+	if (!options.headless) vkDestroySurfaceKHR(vk_instance, surface, nullptr);
 
 	// destroy instance
 	vkDestroyInstance(vk_instance, nullptr);
 
 
-	glfwDestroyWindow(main_window);
-	glfwTerminate();
+	if (!options.headless)
+	{
+		glfwDestroyWindow(main_window);
+		glfwTerminate();
+	}
 }
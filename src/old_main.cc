@@ -9,6 +9,16 @@
 
 #include <vector>
 #include <array>
+#include <cstddef> // offsetof
+#include <cstring> // memcpy
+
+#include "random.h"
+#include "job_system.h"
+#include "particle_init.h"
+#include "uniform_ring.h"
+#include "gl_program.h"
+#include "frame_stats.h"
+#include "frame_clock.h"
 
 // window parameters
 const int window_width = 3840;
@@ -37,11 +47,28 @@ const float camera_zoom_speed = 10.0f;
 const int particle_count = 10000000;
 // const int particle_count = 1000;
 const int attractor_count = 8;
+// fixed timestep: the simulation advances in steps of simulation_dt, whatever the frame rate is.
+// otherwise it takes one step of the measured frame time per frame.
+const bool fixed_timestep = true;
+const double simulation_dt = 1.0 / 120.0;
+
+// the particles themselves only live in gpu buffers (see particle_init.h).
 
-std::array<glm::vec4, particle_count>  compute_positions;
-std::array<float, particle_count>      compute_lifetimes;
-std::array<glm::vec4, particle_count>  compute_velocities;
-std::array<glm::vec4, attractor_count> compute_attractors;
+// everything that changes per frame, written to a uniform_ring_t slice once per frame.
+// this is the FrameConstants block (std140) in particle.comp and particle.vert.
+struct frame_constants_t
+{
+    glm::mat4 projection_matrix;
+    glm::mat4 view_matrix;
+    std::array<glm::vec4, attractor_count> attractors;
+    float dt;
+    uint32_t frame_index;
+    glm::uvec2 seed;
+};
+static_assert(offsetof(frame_constants_t, attractors) == 128, "frame_constants_t has to match the glsl block.");
+static_assert(offsetof(frame_constants_t, dt) == 256, "frame_constants_t has to match the glsl block.");
+static_assert(offsetof(frame_constants_t, seed) == 264, "frame_constants_t has to match the glsl block.");
+const uint32_t frame_constants_binding = 0;
 
 // arbitrary constants
 const float E = 2.71828183f;
@@ -49,15 +76,17 @@ const float pi = 3.14159265f;
 const float epsilon = 0.0001f; // what kind of epsilon?
 
 // rendering stuff (these names are HORRIBLE)
-int rendered_frames = 0;
-double frame_time = 0.0;
 double counter = 0.0;
-double fps = 0.0;
 uint32_t VAO;
 
 // compute shader
 const int workgroup_size = 128;
 
+// random numbers (see random.h). Same seed, same particles.
+const uint64_t random_seed = default_random_seed;
+// counts simulation steps, not rendered frames.
+uint32_t frame_index = 0;
+
 
 #define INVALID_SHADER_PROGRAM_ID 0
 
@@ -104,7 +133,7 @@ static void check_for_errors(int shader_id)
     }
 }
 
-static int create_point_shader_program(const char* vertex_path, const char* fragment_path)
+static uint32_t create_point_shader_program(const char* vertex_path, const char* fragment_path)
 {
     const uint32_t shader_program = glCreateProgram();
 
@@ -136,7 +165,7 @@ static int create_point_shader_program(const char* vertex_path, const char* frag
     return shader_program;
 }
 
-static int create_compute_shader_program(const char* compute_path)
+static uint32_t create_compute_shader_program(const char* compute_path)
 {
     const uint32_t shader_program = glCreateProgram();
 
@@ -156,60 +185,67 @@ static int create_compute_shader_program(const char* compute_path)
     return shader_program;
 }
 
-// find some way to remove the attractor buffer, but better to pass it in now.
+// where the compute program wants its buffers and the step offset, looked up once after linking.
+struct compute_bindings_t
+{
+    int32_t position_buffer;
+    int32_t velocity_buffer;
+    int32_t life_buffer;
+    // -1 if the compiler optimized it out; glUniform ignores that.
+    int32_t step_offset_location;
+};
+
+// frame_constants holds the camera, simulate fills in the rest.
+// runs step_count simulation steps of dt each (0 is fine, then it only draws).
 static void simulate(
     float dt, 
-    uint32_t particle_shader_id,
-    uint32_t compute_shader_id,
+    uint32_t step_count,
+    const gl_program_t& particle_program,
+    const gl_program_t& compute_program,
+    const compute_bindings_t& compute_bindings,
     uint32_t position_buffer,
     uint32_t velocity_buffer,
-    uint32_t attractor_buffer,
-    uint32_t lifetime_buffer)
+    uint32_t lifetime_buffer,
+    uniform_ring_t& frame_constants_ring,
+    frame_constants_t& frame_constants)
 {
-    counter += dt;
-    fmt::print("dt: {}\n",dt);
+    counter += dt * step_count;
     
     if (counter >= 1.0)
         counter = 0.0 - epsilon;
-    
-    if (counter <= 0.0)
-        fps = (int) 1.0 / dt;
 
 
-    // fixme: this should definitely not be the way. just create a uniform buffer that we update?
-    // update the attractors (to move the particles around/)    
-
-    glBindBuffer(GL_ARRAY_BUFFER, attractor_buffer);
-    // modify gpu-based buffer, whatever was in there can be discarded.
-    glm::vec4* attractor_buffer_ptr = (glm::vec4*)glMapBufferRange(GL_ARRAY_BUFFER, 0, attractor_count * sizeof(glm::vec4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    // update the attractors (to move the particles around/)
     for (size_t idx = 0; idx < attractor_count; ++idx)
     {
-        attractor_buffer_ptr[idx].x = (rand() % 100) / 500.0 - (rand() % 100) / 500.0;
-        attractor_buffer_ptr[idx].y = (rand() % 100) / 500.0 - (rand() % 100) / 500.0;
-        attractor_buffer_ptr[idx].z = (rand() % 100) / 500.0 - (rand() % 100) / 500.0;
-
-        attractor_buffer_ptr[idx].x *= sinf(counter);
-        attractor_buffer_ptr[idx].y *= cosf(counter);
-        attractor_buffer_ptr[idx].z = tanf(counter);
-
-        // attractor_buffer_ptr[idx].x = sinf(counter) * (rand() % 500) / 10.0;
-        // attractor_buffer_ptr[idx].y = cosf(counter) * (rand() % 500) / 10.0;
-        // attractor_buffer_ptr[idx].z = tanf(counter);
+        auto bits = random_bits(random_seed, random_stream_attractor_update, idx, frame_index);
+        glm::vec3 offset = random_symmetric3(bits, 100.0f / 500.0f);
+        frame_constants.attractors[idx] = glm::vec4(offset.x * sinf(counter), offset.y * cosf(counter), tanf(counter), 0.0f);
     }
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+    frame_constants.dt = dt;
+    frame_constants.frame_index = frame_index;
+    frame_constants.seed = random_key(random_seed);
+
+    // the slice is write-combined memory: build the constants on the stack and copy them in one go.
+    void* frame_constants_slice = uniform_ring_begin_frame(frame_constants_ring);
+    memcpy(frame_constants_slice, &frame_constants, sizeof(frame_constants_t));
+    uniform_ring_bind(frame_constants_ring, frame_constants_binding);
 
     {
         glDisable(GL_CULL_FACE);
-        glUseProgram(compute_shader_id);
-        glUniform1fv(glGetUniformLocation(compute_shader_id, "dt"), 1, &dt);
+        glUseProgram(compute_program.id);
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, position_buffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocity_buffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, attractor_buffer);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, lifetime_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, compute_bindings.position_buffer, position_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, compute_bindings.velocity_buffer, velocity_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, compute_bindings.life_buffer, lifetime_buffer);
 
-        glDispatchCompute(particle_count / workgroup_size, 1, 1);
-        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+        // the constants are per frame, the shader adds step_offset to frame_index for the random numbers.
+        for (uint32_t step = 0; step != step_count; ++step)
+        {
+            glUniform1ui(compute_bindings.step_offset_location, step);
+            glDispatchCompute(particle_count / workgroup_size, 1, 1);
+            glMemoryBarrier(GL_ALL_BARRIER_BITS);
+        }
         glUseProgram(0);
     }
 
@@ -217,7 +253,7 @@ static void simulate(
     // or the lifetime buffer?
     // check before and after!
     {
-        glUseProgram(particle_shader_id);
+        glUseProgram(particle_program.id);
         glEnable(GL_CULL_FACE);
         glBindBuffer (GL_ARRAY_BUFFER, position_buffer);
         // default VAO?
@@ -226,28 +262,12 @@ static void simulate(
         glDrawArrays(GL_POINTS, 0, particle_count);
     }
 
-}
-
-
-//@FIXME(SMIA):
-// this is super stupid: we keep resetting the glfw time to 0.0 
-// as a sort of clean "delta time" hack since last invocation.
-static float get_dt()
-{
-    float dt = glfwGetTime();
-    glfwSetTime(0.0);
-
-    rendered_frames += 1;
-    frame_time += dt;
+    uniform_ring_end_frame(frame_constants_ring);
+    frame_index += step_count;
 
-    if (rendered_frames >= 1000) {
-        printf ("fps: %i\n", (int) (1.0 / ((double)frame_time / (double)rendered_frames)));
-        frame_time = 0.0;
-        rendered_frames = 0;
-    }
-    return static_cast<float>(dt);
 }
 
+
 // to get openGL debug info, you need a glfw version > 3.3 (4.5 should work)
 // as well as a OPENGL_DEBUG_CONTEXT!
 int main() {
@@ -296,10 +316,42 @@ int main() {
 
     }
 
-    int compute_shader  = create_compute_shader_program("shaders/particle.comp");
-    int particle_shader = create_point_shader_program("shaders/particle.vert", "shaders/particle.frag");
+    job_system_t job_system{};
+    job_system_init(job_system);
+
+    gl_program_t compute_program{};
+    gl_program_t particle_program{};
+    if (!gl_program_init(compute_program, create_compute_shader_program("shaders/particle.comp")) ||
+        !gl_program_init(particle_program, create_point_shader_program("shaders/particle.vert", "shaders/particle.frag")))
+    {
+        return -1;
+    }
+
+    // uniform_ring_bind uses a fixed binding point, make sure the shaders agree.
+    for (const gl_program_t* program: {&compute_program, &particle_program})
+    {
+        int32_t binding = gl_program_uniform_block_binding(*program, gl_name_hash("FrameConstants"));
+        if (binding != static_cast<int32_t>(frame_constants_binding))
+        {
+            fmt::print("FrameConstants is at binding {} in program {}, expected {}\n", binding, program->id, frame_constants_binding);
+            return -1;
+        }
+    }
+
+    // the storage blocks the compute program needs, so the frame loop does not look them up.
+    compute_bindings_t compute_bindings{};
+    compute_bindings.position_buffer = gl_program_storage_block_binding(compute_program, gl_name_hash("PositionBuffer"));
+    compute_bindings.velocity_buffer = gl_program_storage_block_binding(compute_program, gl_name_hash("VelocityBuffer"));
+    compute_bindings.life_buffer = gl_program_storage_block_binding(compute_program, gl_name_hash("LifeBuffer"));
+    compute_bindings.step_offset_location = gl_program_uniform_location(compute_program, gl_name_hash("step_offset"));
+    if (compute_bindings.position_buffer < 0 || compute_bindings.velocity_buffer < 0 || compute_bindings.life_buffer < 0)
+    {
+        fmt::print("the compute program is missing one of PositionBuffer, VelocityBuffer and LifeBuffer\n");
+        return -1;
+    }
 
-    // set up uniforms.
+    // set up the per frame constants. The camera does not move (yet), simulate fills in the rest.
+    frame_constants_t frame_constants{};
     {
         glm::mat4 perspective = glm::perspective(g_fov, aspect_ratio,z_near,z_far);
         glm::vec3 target_position{0.0, 0.0, 0.0};
@@ -307,56 +359,61 @@ int main() {
         glm::vec3 up_direction{0.0, 1.0, 0.0};
         glm::mat4 view = glm::lookAt(camera_position, target_position, up_direction);
 
-        // bind the correct shader before setting uniforms.
-        glUseProgram(particle_shader);
-        int32_t projection_matrix_uniform_location = glGetUniformLocation(particle_shader, "projection_matrix");
-        int32_t view_matrix_uniform_location       = glGetUniformLocation(particle_shader, "view_matrix");
-        glUniformMatrix4fv(projection_matrix_uniform_location, 1, GL_FALSE, glm::value_ptr(perspective));
-        glUniformMatrix4fv(view_matrix_uniform_location,      1, GL_FALSE, glm::value_ptr(view));
-    }
-    // at this point we should at least be good to go from the point_shader perspective.
-
-    for (auto& attractor:  compute_attractors) {
-        attractor.x = (rand() % 500) / 30.0 - (rand() % 500) / 30.0;
-        attractor.y = (rand() % 500) / 30.0 - (rand() % 500) / 30.0;
-        attractor.z = (rand() % 500) / 30.0 - (rand() % 500) / 30.0;
-        attractor.w = 0;
+        frame_constants.projection_matrix = perspective;
+        frame_constants.view_matrix = view;
     }
 
-    for (auto& position: compute_positions)
+    uniform_ring_t frame_constants_ring{};
+    if (!uniform_ring_init(frame_constants_ring, sizeof(frame_constants_t)))
     {
-        position.x = (rand() % 100) / 500.0 - (rand() % 100) / 500.0;
-        position.y = (rand() % 100) / 500.0 - (rand() % 100) / 500.0;
-        position.z = (rand() % 100) / 500.0 - (rand() % 100) / 500.0;
+        return -1;
     }
 
-    for (auto& velocity: compute_velocities)
+    // the particle buffers get immutable storage that we map once, write the initial state into
+    // from all cores, and unmap. No host copy, and no second copy inside glBufferData.
+    // @NOTE(SJM): positions are vec3 in particle.comp, but a std430 vec3[] has a 16 byte stride,
+    // so the buffer has to be sized for vec4s (it used to be sizeof(glm::vec3), 1/4 too small).
+    auto create_particle_buffer = [](size_t size) -> uint32_t
     {
-        velocity.x = (rand() % 500) / 30.0 - (rand() % 500) / 30.0;
-        velocity.y = (rand() % 500) / 30.0 - (rand() % 500) / 30.0;
-        velocity.z = (rand() % 500) / 30.0 - (rand() % 500) / 30.0;
-        velocity.w = 0;
-    }
+        uint32_t buffer{};
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, GL_MAP_WRITE_BIT);
+        return buffer;
+    };
+    auto map_particle_buffer = [](uint32_t buffer, size_t size) -> void*
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        return glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    };
+
+    const size_t position_buffer_size = particle_count * sizeof(glm::vec4);
+    const size_t velocity_buffer_size = particle_count * sizeof(glm::vec4);
+    const size_t lifetime_buffer_size = particle_count * sizeof(float);
 
-    uint32_t attractor_buffer{};
-    glGenBuffers(1, &attractor_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, attractor_buffer);
-    glBufferData(GL_ARRAY_BUFFER, attractor_count * sizeof(glm::vec4), compute_attractors.data(), GL_DYNAMIC_COPY);
+    uint32_t position_buffer = create_particle_buffer(position_buffer_size);
+    uint32_t velocity_buffer = create_particle_buffer(velocity_buffer_size);
+    uint32_t lifetime_buffer = create_particle_buffer(lifetime_buffer_size);
 
-    uint32_t position_buffer{};
-    glGenBuffers    (1, &position_buffer);
-    glBindBuffer    (GL_ARRAY_BUFFER, position_buffer);
-    glBufferData    (GL_ARRAY_BUFFER, particle_count * sizeof(glm::vec3), compute_positions.data(), GL_DYNAMIC_COPY);
+    {
+        auto* positions  = static_cast<glm::vec4*>(map_particle_buffer(position_buffer, position_buffer_size));
+        auto* velocities = static_cast<glm::vec4*>(map_particle_buffer(velocity_buffer, velocity_buffer_size));
+        auto* lifetimes  = static_cast<float*>(map_particle_buffer(lifetime_buffer, lifetime_buffer_size));
+        if (positions == nullptr || velocities == nullptr || lifetimes == nullptr)
+        {
+            fmt::print("failed to map the particle buffers\n");
+            return -1;
+        }
 
-    uint32_t lifetime_buffer{};
-    glGenBuffers    (1, &lifetime_buffer);
-    glBindBuffer    (GL_ARRAY_BUFFER, lifetime_buffer);
-    glBufferData    (GL_ARRAY_BUFFER, particle_count * sizeof(float), compute_lifetimes.data(), GL_DYNAMIC_COPY);
+        init_particles(job_system, particle_count, random_seed, positions, velocities, lifetimes);
 
-    uint32_t velocity_buffer{};
-    glGenBuffers    (1, &velocity_buffer);
-    glBindBuffer    (GL_ARRAY_BUFFER, velocity_buffer);
-    glBufferData    (GL_ARRAY_BUFFER, particle_count * sizeof(glm::vec4), compute_velocities.data(), GL_DYNAMIC_COPY);
+        glBindBuffer(GL_ARRAY_BUFFER, position_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, velocity_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, lifetime_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
 
     // create VAO?
     glGenVertexArrays(1, &VAO);
@@ -369,7 +426,13 @@ int main() {
     glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), 0);
 
 
-    double dt = 0.0;
+    frame_stats_t frame_stats{};
+    frame_stats_init(frame_stats);
+    const uint32_t simulate_section = frame_stats_add_section(frame_stats, "simulate (cpu)");
+
+    frame_clock_t frame_clock{};
+    frame_clock_init(frame_clock, fixed_timestep ? simulation_dt : 0.0);
+
     while (!glfwWindowShouldClose(window))
     {
         glClear(GL_COLOR_BUFFER_BIT);
@@ -377,22 +440,36 @@ int main() {
         // -------------------------------------------------------------------------------
 
         // simulate?
-        float new_dt = get_dt();
+        // the time of the frame that just ended, measured, not the one before it.
+        double frame_dt = frame_clock_tick(frame_clock);
+        float dt = fixed_timestep ? static_cast<float>(simulation_dt) : static_cast<float>(frame_dt);
+        uint32_t step_count = fixed_timestep ? frame_clock_fixed_steps(frame_clock) : 1;
+
+        double simulate_start = frame_stats_now();
         simulate(
             dt, 
-            particle_shader,
-            compute_shader,
+            step_count,
+            particle_program,
+            compute_program,
+            compute_bindings,
             position_buffer,
             velocity_buffer,
-            attractor_buffer,
-            lifetime_buffer);
-
-        dt = new_dt;
+            lifetime_buffer,
+            frame_constants_ring,
+            frame_constants);
+        frame_stats_record(frame_stats, simulate_section, frame_stats_now() - simulate_start);
 
         glfwSwapBuffers(window);
 
         glfwPollEvents();
+        if (frame_stats_end_frame(frame_stats))
+        {
+            frame_clock_report(frame_clock);
+        }
     }
 
-
+    uniform_ring_shutdown(frame_constants_ring);
+    gl_program_destroy(particle_program);
+    gl_program_destroy(compute_program);
+    job_system_shutdown(job_system);
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+// runs the cpu particle engine (particle_engine.h) without a window or gpu and
+// reports throughput in particles per second, so we can compare it to the gpu path.
+//
+// usage: particle_bench [particle_count] [frame_count] [thread_count]
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+#include <glm/glm.hpp>
+
+#include "particle_engine.h"
+#include "job_system.h"
+#include "particle_init.h"
+#include "particle_compact.h"
+#include "spatial_grid.h"
+#include "barnes_hut.h"
+#include "random.h"
+
+#include <algorithm> // std::min, std::max
+#include <array>
+#include <chrono>
+#include <cstdlib> // strtoull
+#include <vector>
+
+// same particle count as old_main.cc.
+const size_t default_particle_count = 10000000;
+const size_t default_frame_count = 10;
+const size_t attractor_count = 8;
+// for the barnes-hut mode.
+const size_t many_attractor_count = 4096;
+// the particles the tree is checked against the direct sum on, and the opening angles it is checked with.
+const size_t barnes_hut_sample_count = 65536;
+const std::array<float, 4> barnes_hut_bench_thetas = {0.25f, 0.5f, 0.75f, 1.0f};
+const float bench_dt = 1.0f / 60.0f;
+
+int main(int argc, char** argv)
+{
+	size_t particle_count = default_particle_count;
+	size_t frame_count = default_frame_count;
+	if (argc > 1) particle_count = strtoull(argv[1], nullptr, 10);
+	// also what anything that is not a number (--help) parses as.
+	if (particle_count == 0)
+	{
+		fmt::print("usage: particle_bench [particle_count] [frame_count] [thread_count]\n");
+		return 1;
+	}
+	if (argc > 2) frame_count = strtoull(argv[2], nullptr, 10);
+	size_t thread_count = 0;
+	if (argc > 3) thread_count = strtoull(argv[3], nullptr, 10);
+
+	const uint64_t seed = default_random_seed;
+
+	// initial state is the same distribution as in old_main.cc.
+	std::array<glm::vec4, attractor_count> attractors{};
+	for (size_t idx = 0; idx != attractor_count; ++idx)
+	{
+		auto bits = random_bits(seed, random_stream_attractor_init, static_cast<uint32_t>(idx));
+		attractors[idx] = glm::vec4(random_symmetric3(bits, 500.0f / 30.0f), 0.0f);
+	}
+
+	job_system_t init_job_system{};
+	job_system_init(init_job_system, thread_count);
+
+	particle_soa_t initial_particles{};
+	particle_soa_resize(initial_particles, particle_count);
+	init_particles(init_job_system, initial_particles, seed);
+	job_system_shutdown(init_job_system);
+
+	particle_update_params_t params{};
+	params.force_point = particle_force_point(attractors.data(), attractors.size());
+	params.dt = bench_dt;
+	params.seed = seed;
+	fmt::print("[cpu] {} particles, {} frames.\n", particle_count, frame_count);
+
+	auto run = [&](job_system_t& job_system, particle_kernel_t kernel)
+	{
+		particle_soa_t particles = initial_particles;
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t frame = 0; frame != frame_count; ++frame)
+		{
+			params.frame_index = static_cast<uint32_t>(frame);
+			update_particles_parallel(job_system, particles, params, kernel);
+		}
+		auto stop = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(stop - start).count();
+		double particles_per_second = static_cast<double>(particle_count) * frame_count / seconds;
+		fmt::print("[cpu] {:>6}, {:>3} threads: {:.3f} ms/frame, {:.1f} M particles/s\n",
+			particle_kernel_name(kernel),
+			job_system.thread_count,
+			seconds * 1000.0 / frame_count,
+			particles_per_second / 1.0e6);
+	};
+
+	// every kernel on one thread, then the best kernel on all of them.
+	const auto best_kernel = particle_best_kernel();
+	{
+		job_system_t job_system{};
+		job_system_init(job_system, 1);
+		for (int kernel_idx = 0; kernel_idx <= static_cast<int>(best_kernel); ++kernel_idx)
+		{
+			run(job_system, static_cast<particle_kernel_t>(kernel_idx));
+		}
+		job_system_shutdown(job_system);
+	}
+	{
+		job_system_t job_system{};
+		job_system_init(job_system, thread_count);
+		run(job_system, best_kernel);
+
+		// what it costs to get the particles into the compact layout (particle_compact.h) every frame.
+		std::vector<particle_compact_t> compact_particles(particle_count);
+		particle_soa_t unpacked_particles{};
+		particle_soa_resize(unpacked_particles, particle_count);
+
+		auto start = std::chrono::steady_clock::now();
+		particle_bounds_t bounds = compute_particle_bounds(job_system, initial_particles);
+		pack_particles_parallel(job_system, initial_particles, bounds, compact_particles.data());
+		auto packed = std::chrono::steady_clock::now();
+		unpack_particles_parallel(job_system, compact_particles.data(), bounds, unpacked_particles);
+		auto unpacked = std::chrono::steady_clock::now();
+
+		const size_t full_size = particle_count * (2 * sizeof(glm::vec4) + sizeof(float));
+		const size_t compact_size = particle_count * sizeof(particle_compact_t);
+		fmt::print("[cpu] compact: {:.1f} MB -> {:.1f} MB, pack {:.3f} ms, unpack {:.3f} ms\n",
+			full_size / 1.0e6,
+			compact_size / 1.0e6,
+			std::chrono::duration<double, std::milli>(packed - start).count(),
+			std::chrono::duration<double, std::milli>(unpacked - packed).count());
+
+		// the per frame rebuild of the neighbour grid (spatial_grid.h).
+		spatial_grid_t grid{};
+		spatial_grid_init(grid, 1.0f, particle_count);
+		auto grid_start = std::chrono::steady_clock::now();
+		spatial_grid_build(grid, job_system, initial_particles);
+		auto grid_stop = std::chrono::steady_clock::now();
+		fmt::print("[cpu] spatial grid: {} buckets, rebuild {:.3f} ms\n",
+			grid.bucket_count,
+			std::chrono::duration<double, std::milli>(grid_stop - grid_start).count());
+
+		// barnes-hut mode (barnes_hut.h) with a lot more attractors.
+		std::vector<glm::vec4> many_attractors(many_attractor_count);
+		for (size_t idx = 0; idx != many_attractor_count; ++idx)
+		{
+			auto bits = random_bits(seed, random_stream_attractor_init, static_cast<uint32_t>(idx));
+			many_attractors[idx] = glm::vec4(random_symmetric3(bits, 500.0f / 30.0f), 1.0f);
+		}
+		barnes_hut_tree_t tree{};
+		particle_soa_t particles = initial_particles;
+		auto build_start = std::chrono::steady_clock::now();
+		barnes_hut_build(tree, job_system, many_attractors.data(), many_attractors.size());
+		auto build_stop = std::chrono::steady_clock::now();
+		update_particles_barnes_hut(job_system, particles, tree, params, barnes_hut_default_theta, barnes_hut_default_softening);
+		auto update_stop = std::chrono::steady_clock::now();
+		fmt::print("[cpu] barnes-hut: {} attractors, {} nodes, build {:.3f} ms, update {:.3f} ms\n",
+			many_attractor_count,
+			tree.nodes.size(),
+			std::chrono::duration<double, std::milli>(build_stop - build_start).count(),
+			std::chrono::duration<double, std::milli>(update_stop - build_stop).count());
+
+		// the tree against the O(N * M) sum, on the first particles: time and force error per theta.
+		const size_t sample_count = std::min(particle_count, barnes_hut_sample_count);
+		if (sample_count != 0)
+		{
+			std::vector<glm::vec3> direct_forces(sample_count);
+			std::vector<glm::vec3> tree_forces(sample_count);
+			auto direct_start = std::chrono::steady_clock::now();
+			parallel_for(job_system, sample_count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+			{
+				for (size_t idx = begin; idx != end; ++idx)
+				{
+					glm::vec3 position{initial_particles.x[idx], initial_particles.y[idx], initial_particles.z[idx]};
+					direct_forces[idx] = direct_attractor_force(many_attractors.data(), many_attractors.size(), position, barnes_hut_default_softening);
+				}
+			});
+			const double direct_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - direct_start).count();
+			fmt::print("[cpu] barnes-hut: {} particles, direct {:.3f} ms\n", sample_count, direct_ms);
+
+			for (float theta: barnes_hut_bench_thetas)
+			{
+				auto tree_start = std::chrono::steady_clock::now();
+				parallel_for(job_system, sample_count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+				{
+					for (size_t idx = begin; idx != end; ++idx)
+					{
+						glm::vec3 position{initial_particles.x[idx], initial_particles.y[idx], initial_particles.z[idx]};
+						tree_forces[idx] = barnes_hut_force(tree, position, theta, barnes_hut_default_softening);
+					}
+				});
+				const double tree_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tree_start).count();
+
+				// relative to the exact force. Where the attractors cancel out the exact force is tiny,
+				// so the max is much larger than the mean.
+				double max_error = 0.0;
+				double error_sum = 0.0;
+				for (size_t idx = 0; idx != sample_count; ++idx)
+				{
+					const double error = glm::length(tree_forces[idx] - direct_forces[idx]) / std::max(glm::length(direct_forces[idx]), 1e-30f);
+					max_error = std::max(max_error, error);
+					error_sum += error;
+				}
+				fmt::print("[cpu] barnes-hut: theta {:.2f}: {:.3f} ms ({:.1f}x), max error {:.2e}, mean error {:.2e}\n",
+					theta,
+					tree_ms,
+					direct_ms / tree_ms,
+					max_error,
+					error_sum / static_cast<double>(sample_count));
+			}
+		}
+
+		job_system_shutdown(job_system);
+	}
+}
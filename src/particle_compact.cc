@@ -0,0 +1,270 @@
+#define GLM_FORCE_INTRINSICS
+#include "particle_compact.h"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/simd/platform.h>
+
+#include <algorithm> // std::min
+#include <vector>
+
+// the simd path needs SSE4.1 (_mm_packus_epi32) and F16C (_mm_cvtps_ph).
+#if (GLM_ARCH & GLM_ARCH_SSE41_BIT) && defined(__F16C__)
+#	define PARTICLE_COMPACT_SIMD 1
+#else
+#	define PARTICLE_COMPACT_SIMD 0
+#endif
+
+particle_bounds_t compute_particle_bounds(job_system_t& job_system, const particle_soa_t& particles)
+{
+	if (particles.count == 0) return particle_bounds_t{};
+
+	const size_t chunk_count = (particles.count + particle_chunk_size - 1) / particle_chunk_size;
+	std::vector<particle_bounds_t> chunk_bounds(chunk_count);
+
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t chunk_index, size_t begin, size_t end)
+	{
+		glm::vec3 min{particles.x[begin], particles.y[begin], particles.z[begin]};
+		glm::vec3 max = min;
+		for (size_t idx = begin; idx != end; ++idx)
+		{
+			glm::vec3 position{particles.x[idx], particles.y[idx], particles.z[idx]};
+			min = glm::min(min, position);
+			max = glm::max(max, position);
+		}
+		chunk_bounds[chunk_index] = particle_bounds_t{min, max};
+	});
+
+	particle_bounds_t bounds = chunk_bounds[0];
+	for (const auto& chunk: chunk_bounds)
+	{
+		bounds.min = glm::min(bounds.min, chunk.min);
+		bounds.max = glm::max(bounds.max, chunk.max);
+	}
+	return bounds;
+}
+
+static glm::vec3 inverse_extent(const particle_bounds_t& bounds)
+{
+	glm::vec3 extent = bounds.max - bounds.min;
+	return glm::vec3(
+		extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+		extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+		extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+}
+
+static void pack_particles_scalar(
+	const particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_compact_t* dst)
+{
+	const glm::vec3 inv_extent = inverse_extent(bounds);
+	for (size_t idx = begin; idx != end; ++idx)
+	{
+		glm::vec3 position{particles.x[idx], particles.y[idx], particles.z[idx]};
+		glm::vec3 normalized = (position - bounds.min) * inv_extent;
+		dst[idx].position_life = glm::packUnorm4x16(glm::vec4(normalized, particles.life[idx]));
+		dst[idx].velocity = glm::packHalf4x16(glm::vec4(particles.vx[idx], particles.vy[idx], particles.vz[idx], 0.0f));
+	}
+}
+
+static void unpack_particles_scalar(
+	const particle_compact_t* src,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_soa_t& particles)
+{
+	const glm::vec3 extent = bounds.max - bounds.min;
+	for (size_t idx = begin; idx != end; ++idx)
+	{
+		glm::vec4 position_life = glm::unpackUnorm4x16(src[idx].position_life);
+		glm::vec4 velocity = glm::unpackHalf4x16(src[idx].velocity);
+		glm::vec3 position = bounds.min + glm::vec3(position_life) * extent;
+		particles.x[idx] = position.x;
+		particles.y[idx] = position.y;
+		particles.z[idx] = position.z;
+		particles.life[idx] = position_life.w;
+		particles.vx[idx] = velocity.x;
+		particles.vy[idx] = velocity.y;
+		particles.vz[idx] = velocity.z;
+	}
+}
+
+#if PARTICLE_COMPACT_SIMD
+// (v - min) * inv_extent, clamped to [0, 1] and scaled to [0, 65535].
+static glm_i32vec4 quantize_unorm16(glm_f32vec4 v, glm_f32vec4 min, glm_f32vec4 inv_extent)
+{
+	glm_f32vec4 normalized = _mm_mul_ps(_mm_sub_ps(v, min), inv_extent);
+	normalized = _mm_min_ps(_mm_max_ps(normalized, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvtps_epi32(_mm_mul_ps(normalized, _mm_set1_ps(65535.0f)));
+}
+
+// 4 particles per iteration. The soa inputs are transposed into one 16 byte record per particle
+// with unpacks, so all stores are full, sequential 16 byte stores.
+static size_t pack_particles_simd(
+	const particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_compact_t* dst)
+{
+	const glm::vec3 inv_extent = inverse_extent(bounds);
+	const glm_f32vec4 min_x = _mm_set1_ps(bounds.min.x);
+	const glm_f32vec4 min_y = _mm_set1_ps(bounds.min.y);
+	const glm_f32vec4 min_z = _mm_set1_ps(bounds.min.z);
+	const glm_f32vec4 inv_x = _mm_set1_ps(inv_extent.x);
+	const glm_f32vec4 inv_y = _mm_set1_ps(inv_extent.y);
+	const glm_f32vec4 inv_z = _mm_set1_ps(inv_extent.z);
+	const glm_f32vec4 zero = _mm_setzero_ps();
+	const glm_f32vec4 one = _mm_set1_ps(1.0f);
+
+	size_t idx = begin;
+	for (; idx + 4 <= end; idx += 4)
+	{
+		glm_i32vec4 qx = quantize_unorm16(_mm_loadu_ps(&particles.x[idx]), min_x, inv_x);
+		glm_i32vec4 qy = quantize_unorm16(_mm_loadu_ps(&particles.y[idx]), min_y, inv_y);
+		glm_i32vec4 qz = quantize_unorm16(_mm_loadu_ps(&particles.z[idx]), min_z, inv_z);
+		glm_i32vec4 ql = quantize_unorm16(_mm_loadu_ps(&particles.life[idx]), zero, one);
+
+		// x0 x1 x2 x3 y0 y1 y2 y3 / z0 z1 z2 z3 l0 l1 l2 l3
+		glm_i32vec4 xy = _mm_packus_epi32(qx, qy);
+		glm_i32vec4 zl = _mm_packus_epi32(qz, ql);
+		// x0 z0 x1 z1 x2 z2 x3 z3 / y0 l0 y1 l1 y2 l2 y3 l3
+		glm_i32vec4 xz = _mm_unpacklo_epi16(xy, zl);
+		glm_i32vec4 yl = _mm_unpackhi_epi16(xy, zl);
+		// x0 y0 z0 l0 x1 y1 z1 l1 / x2 y2 z2 l2 x3 y3 z3 l3
+		glm_i32vec4 position_01 = _mm_unpacklo_epi16(xz, yl);
+		glm_i32vec4 position_23 = _mm_unpackhi_epi16(xz, yl);
+
+		// halves end up in the low 64 bits.
+		glm_i32vec4 hx = _mm_cvtps_ph(_mm_loadu_ps(&particles.vx[idx]), _MM_FROUND_TO_NEAREST_INT);
+		glm_i32vec4 hy = _mm_cvtps_ph(_mm_loadu_ps(&particles.vy[idx]), _MM_FROUND_TO_NEAREST_INT);
+		glm_i32vec4 hz = _mm_cvtps_ph(_mm_loadu_ps(&particles.vz[idx]), _MM_FROUND_TO_NEAREST_INT);
+		// x0 y0 x1 y1 x2 y2 x3 y3 / z0 0 z1 0 z2 0 z3 0
+		glm_i32vec4 hxy = _mm_unpacklo_epi16(hx, hy);
+		glm_i32vec4 hz0 = _mm_unpacklo_epi16(hz, _mm_setzero_si128());
+		// x0 y0 z0 0 x1 y1 z1 0 / x2 y2 z2 0 x3 y3 z3 0
+		glm_i32vec4 velocity_01 = _mm_unpacklo_epi32(hxy, hz0);
+		glm_i32vec4 velocity_23 = _mm_unpackhi_epi32(hxy, hz0);
+
+		glm_i32vec4* out = reinterpret_cast<glm_i32vec4*>(&dst[idx]);
+		_mm_storeu_si128(out + 0, _mm_unpacklo_epi64(position_01, velocity_01));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi64(position_01, velocity_01));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi64(position_23, velocity_23));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi64(position_23, velocity_23));
+	}
+	return idx;
+}
+
+// the exact reverse of pack_particles_simd: 4 records in, transposed back to soa.
+static size_t unpack_particles_simd(
+	const particle_compact_t* src,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_soa_t& particles)
+{
+	const glm::vec3 extent = bounds.max - bounds.min;
+	const glm_f32vec4 min_x = _mm_set1_ps(bounds.min.x);
+	const glm_f32vec4 min_y = _mm_set1_ps(bounds.min.y);
+	const glm_f32vec4 min_z = _mm_set1_ps(bounds.min.z);
+	const glm_f32vec4 scale_x = _mm_set1_ps(extent.x / 65535.0f);
+	const glm_f32vec4 scale_y = _mm_set1_ps(extent.y / 65535.0f);
+	const glm_f32vec4 scale_z = _mm_set1_ps(extent.z / 65535.0f);
+	const glm_f32vec4 scale_l = _mm_set1_ps(1.0f / 65535.0f);
+	const glm_i32vec4 zero = _mm_setzero_si128();
+
+	size_t idx = begin;
+	for (; idx + 4 <= end; idx += 4)
+	{
+		const glm_i32vec4* in = reinterpret_cast<const glm_i32vec4*>(&src[idx]);
+		glm_i32vec4 r0 = _mm_loadu_si128(in + 0);
+		glm_i32vec4 r1 = _mm_loadu_si128(in + 1);
+		glm_i32vec4 r2 = _mm_loadu_si128(in + 2);
+		glm_i32vec4 r3 = _mm_loadu_si128(in + 3);
+
+		// 4x4 transpose of 16 bit values: x0 y0 z0 l0 x1 y1 z1 l1 / x2 .. l3
+		glm_i32vec4 position_01 = _mm_unpacklo_epi64(r0, r1);
+		glm_i32vec4 position_23 = _mm_unpacklo_epi64(r2, r3);
+		glm_i32vec4 a = _mm_unpacklo_epi16(position_01, position_23); // x0 x2 y0 y2 z0 z2 l0 l2
+		glm_i32vec4 b = _mm_unpackhi_epi16(position_01, position_23); // x1 x3 y1 y3 z1 z3 l1 l3
+		glm_i32vec4 xy = _mm_unpacklo_epi16(a, b);                    // x0 x1 x2 x3 y0 y1 y2 y3
+		glm_i32vec4 zl = _mm_unpackhi_epi16(a, b);                    // z0 z1 z2 z3 l0 l1 l2 l3
+
+		glm_f32vec4 x = _mm_cvtepi32_ps(_mm_unpacklo_epi16(xy, zero));
+		glm_f32vec4 y = _mm_cvtepi32_ps(_mm_unpackhi_epi16(xy, zero));
+		glm_f32vec4 z = _mm_cvtepi32_ps(_mm_unpacklo_epi16(zl, zero));
+		glm_f32vec4 l = _mm_cvtepi32_ps(_mm_unpackhi_epi16(zl, zero));
+		_mm_storeu_ps(&particles.x[idx], _mm_add_ps(_mm_mul_ps(x, scale_x), min_x));
+		_mm_storeu_ps(&particles.y[idx], _mm_add_ps(_mm_mul_ps(y, scale_y), min_y));
+		_mm_storeu_ps(&particles.z[idx], _mm_add_ps(_mm_mul_ps(z, scale_z), min_z));
+		_mm_storeu_ps(&particles.life[idx], _mm_mul_ps(l, scale_l));
+
+		// the same transpose for the halves.
+		glm_i32vec4 velocity_01 = _mm_unpackhi_epi64(r0, r1);
+		glm_i32vec4 velocity_23 = _mm_unpackhi_epi64(r2, r3);
+		a = _mm_unpacklo_epi16(velocity_01, velocity_23);
+		b = _mm_unpackhi_epi16(velocity_01, velocity_23);
+		glm_i32vec4 hxy = _mm_unpacklo_epi16(a, b);
+		glm_i32vec4 hz0 = _mm_unpackhi_epi16(a, b);
+		_mm_storeu_ps(&particles.vx[idx], _mm_cvtph_ps(hxy));
+		_mm_storeu_ps(&particles.vy[idx], _mm_cvtph_ps(_mm_unpackhi_epi64(hxy, hxy)));
+		_mm_storeu_ps(&particles.vz[idx], _mm_cvtph_ps(hz0));
+	}
+	return idx;
+}
+#endif
+
+void pack_particles(
+	const particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_compact_t* dst)
+{
+	end = std::min(end, particles.count);
+#if PARTICLE_COMPACT_SIMD
+	begin = pack_particles_simd(particles, begin, end, bounds, dst);
+#endif
+	pack_particles_scalar(particles, begin, end, bounds, dst);
+}
+
+void unpack_particles(
+	const particle_compact_t* src,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_soa_t& particles)
+{
+	end = std::min(end, particles.count);
+#if PARTICLE_COMPACT_SIMD
+	begin = unpack_particles_simd(src, begin, end, bounds, particles);
+#endif
+	unpack_particles_scalar(src, begin, end, bounds, particles);
+}
+
+void pack_particles_parallel(
+	job_system_t& job_system,
+	const particle_soa_t& particles,
+	const particle_bounds_t& bounds,
+	particle_compact_t* dst)
+{
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		pack_particles(particles, begin, end, bounds, dst);
+	});
+}
+
+void unpack_particles_parallel(
+	job_system_t& job_system,
+	const particle_compact_t* src,
+	const particle_bounds_t& bounds,
+	particle_soa_t& particles)
+{
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		unpack_particles(src, begin, end, bounds, particles);
+	});
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// compact particle storage: 16 bytes per particle instead of the 36 bytes of
+// vec4 position + vec4 velocity + float lifetime that particle.comp uses.
+// only the cpu side exists: the bulk pack and unpack, measured by particle_bench. The renderers
+// keep their float buffers; nothing on the gpu reads this layout yet.
+//
+//   position_life: x, y, z as unorm16 relative to a bounding box, lifetime as unorm16
+//                  (glm::packUnorm4x16 layout, so x is in the low 16 bits).
+//   velocity:      x, y, z, 0 as half floats (glm::packHalf4x16 layout).
+//
+// as a glsl uvec4: x = pos.x | pos.y << 16, y = pos.z | life << 16, z = vel.x | vel.y << 16,
+// w = vel.z, so unpackUnorm2x16 / unpackHalf2x16 decode it.
+// position precision is (bounds extent / 65535), i.e. ~0.6mm for a 40m box.
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "particle_engine.h"
+
+#include <cstddef>
+#include <cstdint>
+
+struct particle_compact_t
+{
+	uint64_t position_life;
+	uint64_t velocity;
+};
+static_assert(sizeof(particle_compact_t) == 16, "particle_compact_t has to match a glsl uvec4.");
+
+struct particle_bounds_t
+{
+	glm::vec3 min{0.0f};
+	glm::vec3 max{0.0f};
+};
+
+// the tightest box around all particles (computed in parallel).
+particle_bounds_t compute_particle_bounds(job_system_t& job_system, const particle_soa_t& particles);
+
+// positions outside of bounds are clamped to it, lifetimes are clamped to [0, 1].
+// the simd paths round ties to even, the scalar path (glm) rounds them up, so the two can differ
+// in the last bit for values that land exactly halfway.
+void pack_particles(
+	const particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_compact_t* dst);
+
+void unpack_particles(
+	const particle_compact_t* src,
+	size_t begin,
+	size_t end,
+	const particle_bounds_t& bounds,
+	particle_soa_t& particles);
+
+void pack_particles_parallel(
+	job_system_t& job_system,
+	const particle_soa_t& particles,
+	const particle_bounds_t& bounds,
+	particle_compact_t* dst);
+
+void unpack_particles_parallel(
+	job_system_t& job_system,
+	const particle_compact_t* src,
+	const particle_bounds_t& bounds,
+	particle_soa_t& particles);
@@ -0,0 +1,445 @@
+// we want the glm simd helpers (glm/simd/*.h), which are only enabled with intrinsics.
+#define GLM_FORCE_INTRINSICS
+#include "particle_engine.h"
+
+#include <glm/simd/common.h>
+
+#include <algorithm> // std::min
+#include <cmath>
+#include <cstring> // memcpy
+
+void particle_soa_resize(particle_soa_t& particles, size_t count)
+{
+	particles.count = count;
+	particles.x.resize(count);
+	particles.y.resize(count);
+	particles.z.resize(count);
+	particles.vx.resize(count);
+	particles.vy.resize(count);
+	particles.vz.resize(count);
+	particles.life.resize(count);
+}
+
+particle_kernel_t particle_best_kernel()
+{
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	return particle_kernel_t::avx2;
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+	return particle_kernel_t::sse;
+#else
+	return particle_kernel_t::scalar;
+#endif
+}
+
+const char* particle_kernel_name(particle_kernel_t kernel)
+{
+	switch (kernel)
+	{
+		case particle_kernel_t::scalar: return "scalar";
+		case particle_kernel_t::sse:    return "sse";
+		case particle_kernel_t::avx2:   return "avx2";
+	}
+	return "unknown";
+}
+
+glm::vec3 particle_force_point(const glm::vec4* attractors, size_t attractor_count)
+{
+	glm::vec3 force_point{0.0f};
+	for (size_t idx = 0; idx != attractor_count; ++idx)
+	{
+		force_point += glm::vec3(attractors[idx]);
+	}
+	return force_point;
+}
+
+// "lanes" describe how to do float math on 1, 4 or 8 particles at a time.
+// the kernel below is written once against this interface, so the scalar path
+// computes exactly the same approximations (and roundings) as the simd paths.
+// the random numbers are integer math, so those also match particle.comp exactly.
+struct scalar_lanes_t
+{
+	using float_t = float;
+	using mask_t = bool;
+	static constexpr size_t width = 1;
+
+	static float_t load(const float* ptr) { return *ptr; }
+	static void store(float* ptr, float_t v) { *ptr = v; }
+	static float_t set(float v) { return v; }
+
+	static float_t add(float_t a, float_t b) { return a + b; }
+	static float_t sub(float_t a, float_t b) { return a - b; }
+	static float_t mul(float_t a, float_t b) { return a * b; }
+	static float_t div(float_t a, float_t b) { return a / b; }
+	static float_t fma(float_t a, float_t b, float_t c)
+	{
+#if defined(__FMA__)
+		return std::fma(a, b, c);
+#else
+		return a * b + c;
+#endif
+	}
+	static float_t min(float_t a, float_t b) { return a < b ? a : b; }
+	static float_t max(float_t a, float_t b) { return a > b ? a : b; }
+	static float_t sqrt(float_t a) { return std::sqrt(a); }
+	static float_t floor(float_t a) { return std::floor(a); }
+
+	// 2^n for a float n that holds an integer in [-126, 127].
+	static float_t exp2_int(float_t n)
+	{
+		uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+		float result;
+		memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	static mask_t less_equal(float_t a, float_t b) { return a <= b; }
+	static float_t select(mask_t mask, float_t a, float_t b) { return mask ? a : b; }
+
+	using uint_t = uint32_t;
+	static uint_t set_u(uint32_t v) { return v; }
+	// base, base + 1, ... for every lane.
+	static uint_t iota_u(uint32_t base) { return base; }
+	static uint_t xor_u(uint_t a, uint_t b) { return a ^ b; }
+	static uint_t and_u(uint_t a, uint_t b) { return a & b; }
+	template <int bits> static uint_t shift_right_u(uint_t a) { return a >> bits; }
+	// only exact for a < 2^24.
+	static float_t to_float_u(uint_t a) { return static_cast<float>(a); }
+	// the full 64 bit product of m * a, split into two words.
+	static void mul_wide_u(uint32_t m, uint_t a, uint_t& hi, uint_t& lo)
+	{
+		uint64_t product = static_cast<uint64_t>(m) * a;
+		hi = static_cast<uint32_t>(product >> 32);
+		lo = static_cast<uint32_t>(product);
+	}
+};
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+struct sse_lanes_t
+{
+	using float_t = glm_f32vec4;
+	using mask_t = glm_f32vec4;
+	static constexpr size_t width = 4;
+
+	static float_t load(const float* ptr) { return _mm_loadu_ps(ptr); }
+	static void store(float* ptr, float_t v) { _mm_storeu_ps(ptr, v); }
+	static float_t set(float v) { return _mm_set1_ps(v); }
+
+	static float_t add(float_t a, float_t b) { return glm_vec4_add(a, b); }
+	static float_t sub(float_t a, float_t b) { return glm_vec4_sub(a, b); }
+	static float_t mul(float_t a, float_t b) { return glm_vec4_mul(a, b); }
+	static float_t div(float_t a, float_t b) { return glm_vec4_div(a, b); }
+	static float_t fma(float_t a, float_t b, float_t c)
+	{
+		// glm_vec4_fma never fuses on clang, we want the same rounding as the other lanes.
+#if defined(__FMA__)
+		return _mm_fmadd_ps(a, b, c);
+#else
+		return glm_vec4_add(glm_vec4_mul(a, b), c);
+#endif
+	}
+	static float_t min(float_t a, float_t b) { return _mm_min_ps(a, b); }
+	static float_t max(float_t a, float_t b) { return _mm_max_ps(a, b); }
+	static float_t sqrt(float_t a) { return _mm_sqrt_ps(a); }
+	static float_t floor(float_t a) { return glm_vec4_floor(a); }
+
+	static float_t exp2_int(float_t n)
+	{
+		glm_i32vec4 exponent = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+		return _mm_castsi128_ps(_mm_slli_epi32(exponent, 23));
+	}
+
+	static mask_t less_equal(float_t a, float_t b) { return _mm_cmple_ps(a, b); }
+	static float_t select(mask_t mask, float_t a, float_t b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	using uint_t = glm_u32vec4;
+	static uint_t set_u(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+	static uint_t iota_u(uint32_t base) { return _mm_add_epi32(set_u(base), _mm_setr_epi32(0, 1, 2, 3)); }
+	static uint_t xor_u(uint_t a, uint_t b) { return _mm_xor_si128(a, b); }
+	static uint_t and_u(uint_t a, uint_t b) { return _mm_and_si128(a, b); }
+	template <int bits> static uint_t shift_right_u(uint_t a) { return _mm_srli_epi32(a, bits); }
+	static float_t to_float_u(uint_t a) { return _mm_cvtepi32_ps(a); }
+	static void mul_wide_u(uint32_t m, uint_t a, uint_t& hi, uint_t& lo)
+	{
+		// _mm_mul_epu32 only multiplies lanes 0 and 2, so do the odd lanes separately.
+		const uint_t m_v = set_u(m);
+		uint_t even = _mm_mul_epu32(a, m_v);                    // lo0 hi0 lo2 hi2
+		uint_t odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m_v); // lo1 hi1 lo3 hi3
+		even = _mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0)); // lo0 lo2 hi0 hi2
+		odd = _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0));   // lo1 lo3 hi1 hi3
+		lo = _mm_unpacklo_epi32(even, odd);
+		hi = _mm_unpackhi_epi32(even, odd);
+	}
+};
+#endif
+
+// glm has no 8-wide helpers, so the AVX2 lanes use the intrinsics directly.
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+struct avx2_lanes_t
+{
+	using float_t = __m256;
+	using mask_t = __m256;
+	static constexpr size_t width = 8;
+
+	static float_t load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+	static void store(float* ptr, float_t v) { _mm256_storeu_ps(ptr, v); }
+	static float_t set(float v) { return _mm256_set1_ps(v); }
+
+	static float_t add(float_t a, float_t b) { return _mm256_add_ps(a, b); }
+	static float_t sub(float_t a, float_t b) { return _mm256_sub_ps(a, b); }
+	static float_t mul(float_t a, float_t b) { return _mm256_mul_ps(a, b); }
+	static float_t div(float_t a, float_t b) { return _mm256_div_ps(a, b); }
+	static float_t fma(float_t a, float_t b, float_t c)
+	{
+#if defined(__FMA__)
+		return _mm256_fmadd_ps(a, b, c);
+#else
+		return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+	}
+	static float_t min(float_t a, float_t b) { return _mm256_min_ps(a, b); }
+	static float_t max(float_t a, float_t b) { return _mm256_max_ps(a, b); }
+	static float_t sqrt(float_t a) { return _mm256_sqrt_ps(a); }
+	static float_t floor(float_t a) { return _mm256_floor_ps(a); }
+
+	static float_t exp2_int(float_t n)
+	{
+		__m256i exponent = _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127));
+		return _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+	}
+
+	static mask_t less_equal(float_t a, float_t b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static float_t select(mask_t mask, float_t a, float_t b) { return _mm256_blendv_ps(b, a, mask); }
+
+	using uint_t = __m256i;
+	static uint_t set_u(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+	static uint_t iota_u(uint32_t base) { return _mm256_add_epi32(set_u(base), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)); }
+	static uint_t xor_u(uint_t a, uint_t b) { return _mm256_xor_si256(a, b); }
+	static uint_t and_u(uint_t a, uint_t b) { return _mm256_and_si256(a, b); }
+	template <int bits> static uint_t shift_right_u(uint_t a) { return _mm256_srli_epi32(a, bits); }
+	static float_t to_float_u(uint_t a) { return _mm256_cvtepi32_ps(a); }
+	// the same as the sse version, the shuffles and unpacks work per 128 bit half.
+	static void mul_wide_u(uint32_t m, uint_t a, uint_t& hi, uint_t& lo)
+	{
+		const uint_t m_v = set_u(m);
+		uint_t even = _mm256_mul_epu32(a, m_v);
+		uint_t odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m_v);
+		even = _mm256_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0));
+		odd = _mm256_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0));
+		lo = _mm256_unpacklo_epi32(even, odd);
+		hi = _mm256_unpackhi_epi32(even, odd);
+	}
+};
+#endif
+
+// e^x for x <= 0. We split x * log2(e) into an integer part n and a remainder f in [-0.5, 0.5],
+// so e^x = 2^n * e^(f * ln(2)), and the second factor is a short taylor series.
+template <typename lanes_t>
+static typename lanes_t::float_t exp_approx(typename lanes_t::float_t x)
+{
+	using L = lanes_t;
+	x = L::max(x, L::set(-87.0f)); // 2^-126 is the smallest normal float.
+
+	auto t = L::mul(x, L::set(1.44269504f));
+	auto n = L::floor(L::add(t, L::set(0.5f)));
+	auto f = L::mul(L::sub(t, n), L::set(0.69314718f));
+
+	auto p = L::set(1.0f / 720.0f);
+	p = L::fma(p, f, L::set(1.0f / 120.0f));
+	p = L::fma(p, f, L::set(1.0f / 24.0f));
+	p = L::fma(p, f, L::set(1.0f / 6.0f));
+	p = L::fma(p, f, L::set(0.5f));
+	p = L::fma(p, f, L::set(1.0f));
+	p = L::fma(p, f, L::set(1.0f));
+
+	return L::mul(p, L::exp2_int(n));
+}
+
+// philox4x32 from random.h on a whole register of counters at once.
+template <typename lanes_t>
+static void philox4x32_lanes(typename lanes_t::uint_t counter[4], glm::uvec2 key)
+{
+	using L = lanes_t;
+	for (int round = 0; round != philox_rounds; ++round)
+	{
+		typename L::uint_t hi_0, lo_0, hi_1, lo_1;
+		L::mul_wide_u(philox_m0, counter[0], hi_0, lo_0);
+		L::mul_wide_u(philox_m1, counter[2], hi_1, lo_1);
+
+		counter[0] = L::xor_u(L::xor_u(hi_1, counter[1]), L::set_u(key.x));
+		counter[1] = lo_1;
+		counter[2] = L::xor_u(L::xor_u(hi_0, counter[3]), L::set_u(key.y));
+		counter[3] = lo_0;
+		key += glm::uvec2(philox_w0, philox_w1);
+	}
+}
+
+// random_unit, random_unit_lo16 and random_unit_hi16 from random.h.
+template <typename lanes_t>
+static typename lanes_t::float_t unit_float(typename lanes_t::uint_t bits)
+{
+	using L = lanes_t;
+	return L::mul(L::to_float_u(L::template shift_right_u<8>(bits)), L::set(1.0f / 16777216.0f));
+}
+
+template <typename lanes_t>
+static typename lanes_t::float_t unit_float_lo16(typename lanes_t::uint_t bits)
+{
+	using L = lanes_t;
+	return L::mul(L::to_float_u(L::and_u(bits, L::set_u(0xffff))), L::set(1.0f / 65536.0f));
+}
+
+template <typename lanes_t>
+static typename lanes_t::float_t unit_float_hi16(typename lanes_t::uint_t bits)
+{
+	using L = lanes_t;
+	return L::mul(L::to_float_u(L::template shift_right_u<16>(bits)), L::set(1.0f / 65536.0f));
+}
+
+// processes [begin, end) in steps of lanes_t::width. Returns where it stopped,
+// the caller finishes the tail with the scalar kernel.
+template <typename lanes_t>
+static size_t update_particles_kernel(
+	particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_update_params_t& params)
+{
+	using L = lanes_t;
+
+	const auto fp_x = L::set(params.force_point.x);
+	const auto fp_y = L::set(params.force_point.y);
+	const auto fp_z = L::set(params.force_point.z);
+
+	const glm::uvec2 key = random_key(params.seed);
+	const auto frame_index = L::set_u(params.frame_index);
+	const auto stream = L::set_u(random_stream_particle_update);
+	const auto zero_u = L::set_u(0);
+
+	const float new_dt = params.dt * 50.0f;
+	const auto new_dt_v = L::set(new_dt);
+
+	const float gauss = 10000.0f;
+	const float k_weak = 1.0f;
+	const float k_v = 1.5f;
+
+	size_t idx = begin;
+	for (; idx + L::width <= end; idx += L::width)
+	{
+		auto x = L::load(&particles.x[idx]);
+		auto y = L::load(&particles.y[idx]);
+		auto z = L::load(&particles.z[idx]);
+		auto vx = L::load(&particles.vx[idx]);
+		auto vy = L::load(&particles.vy[idx]);
+		auto vz = L::load(&particles.vz[idx]);
+		auto life = L::load(&particles.life[idx]);
+
+		// the same counter as particle.comp: (index, frame_index, stream, 0).
+		typename L::uint_t bits[4] = {L::iota_u(static_cast<uint32_t>(idx)), frame_index, stream, zero_u};
+		philox4x32_lanes<L>(bits, key);
+
+		// calcForceFor(forcePoint, pos)
+		auto dir_x = L::sub(fp_x, x);
+		auto dir_y = L::sub(fp_y, y);
+		auto dir_z = L::sub(fp_z, z);
+		auto dir_length_2 = L::fma(dir_x, dir_x, L::fma(dir_y, dir_y, L::mul(dir_z, dir_z)));
+		auto dir_length = L::sqrt(dir_length_2);
+		// pow(e, -pow(vecLen(dir), 2) / gauss)
+		auto g = exp_approx<L>(L::mul(dir_length_2, L::set(-1.0f / gauss)));
+		auto r_0 = unit_float<L>(bits[0]);
+		auto r_1 = unit_float<L>(bits[1]);
+		auto strength = L::mul(L::add(L::set(1.0f), L::sub(r_0, r_1)), L::set(k_weak / 10.0f));
+		// normalize(dir) * strength * g
+		auto force_scale = L::div(L::mul(strength, g), dir_length);
+		auto noise = L::mul(unit_float<L>(bits[2]), L::set(1.0f / 100.0f));
+		auto f_x = L::fma(dir_x, force_scale, noise);
+		auto f_y = L::fma(dir_y, force_scale, noise);
+		auto f_z = L::fma(dir_z, force_scale, noise);
+
+		// v = normalize(vel.xyz + (f * newDT)) * k_v
+		auto u_x = L::fma(f_x, new_dt_v, vx);
+		auto u_y = L::fma(f_y, new_dt_v, vy);
+		auto u_z = L::fma(f_z, new_dt_v, vz);
+		auto u_length = L::sqrt(L::fma(u_x, u_x, L::fma(u_y, u_y, L::mul(u_z, u_z))));
+		auto u_scale = L::div(L::set(k_v), u_length);
+		// v += (forcePoint - pos) * 0.00005
+		auto attraction = L::set(0.00005f);
+		auto v_x = L::fma(dir_x, attraction, L::mul(u_x, u_scale));
+		auto v_y = L::fma(dir_y, attraction, L::mul(u_y, u_scale));
+		auto v_z = L::fma(dir_z, attraction, L::mul(u_z, u_scale));
+
+		// s = pos + v * newDT
+		auto s_x = L::fma(v_x, new_dt_v, x);
+		auto s_y = L::fma(v_y, new_dt_v, y);
+		auto s_z = L::fma(v_z, new_dt_v, z);
+
+		auto new_life = L::sub(life, L::set(0.001f * new_dt));
+
+		// if the particle expires, reset it. Both sides are computed and blended.
+		auto expired = L::less_equal(new_life, L::set(0.0f));
+		auto jitter = L::mul(L::sub(unit_float_lo16<L>(bits[3]), unit_float_hi16<L>(bits[3])), L::set(20.0f));
+		auto zero = L::set(0.0f);
+		s_x = L::select(expired, L::add(L::sub(zero, s_x), jitter), s_x);
+		s_y = L::select(expired, L::add(L::sub(zero, s_y), jitter), s_y);
+		s_z = L::select(expired, L::add(L::sub(zero, s_z), jitter), s_z);
+		new_life = L::select(expired, L::set(0.99f), new_life);
+
+		L::store(&particles.x[idx], s_x);
+		L::store(&particles.y[idx], s_y);
+		L::store(&particles.z[idx], s_z);
+		L::store(&particles.vx[idx], v_x);
+		L::store(&particles.vy[idx], v_y);
+		L::store(&particles.vz[idx], v_z);
+		L::store(&particles.life[idx], new_life);
+	}
+
+	return idx;
+}
+
+void update_particles(
+	particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_update_params_t& params,
+	particle_kernel_t kernel)
+{
+	end = std::min(end, particles.count);
+	kernel = std::min(kernel, particle_best_kernel());
+
+	size_t idx = begin;
+	switch (kernel)
+	{
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+		case particle_kernel_t::avx2:
+		{
+			idx = update_particles_kernel<avx2_lanes_t>(particles, idx, end, params);
+			break;
+		}
+#endif
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		case particle_kernel_t::sse:
+		{
+			idx = update_particles_kernel<sse_lanes_t>(particles, idx, end, params);
+			break;
+		}
+#endif
+		default:
+			break;
+	}
+
+	update_particles_kernel<scalar_lanes_t>(particles, idx, end, params);
+}
+
+void update_particles_parallel(
+	job_system_t& job_system,
+	particle_soa_t& particles,
+	const particle_update_params_t& params,
+	particle_kernel_t kernel)
+{
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		update_particles(particles, begin, end, params, kernel);
+	});
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// CPU version of shaders/particle.comp.
+// particles are stored as a structure of arrays so the kernels can process
+// 4 (SSE) or 8 (AVX2) particles per instruction instead of one vec4 at a time.
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "random.h"
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// local_size_x in particle.comp.
+const size_t particle_tile_size = 128;
+// particles per job: 64 tiles of 7 floats is ~224KB, which stays in L2 on anything recent.
+const size_t particle_chunk_size = 64 * particle_tile_size;
+
+enum class particle_kernel_t
+{
+	scalar,
+	sse,
+	avx2
+};
+
+struct particle_soa_t
+{
+	size_t count = 0;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+	// velocities[index].w is never written by particle.comp, so we do not store it.
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<float> vz;
+
+	std::vector<float> life;
+};
+
+void particle_soa_resize(particle_soa_t& particles, size_t count);
+
+// the widest kernel that was compiled into this binary (depends on -msse4.1 / -mavx2).
+particle_kernel_t particle_best_kernel();
+const char* particle_kernel_name(particle_kernel_t kernel);
+
+// "forcePoint" in particle.comp: the sum of all attractors. This is the same for every particle,
+// so we compute it once per dispatch instead of once per invocation.
+glm::vec3 particle_force_point(const glm::vec4* attractors, size_t attractor_count);
+
+// the uniforms of particle.comp.
+struct particle_update_params_t
+{
+	glm::vec3 force_point{0.0f};
+	float dt = 0.0f;
+	uint32_t frame_index = 0;
+	uint64_t seed = default_random_seed;
+};
+
+// one dispatch of particle.comp for the particles in [begin, end).
+// kernels that are not compiled in fall back to the best one that is.
+void update_particles(
+	particle_soa_t& particles,
+	size_t begin,
+	size_t end,
+	const particle_update_params_t& params,
+	particle_kernel_t kernel);
+
+// the same as update_particles over all particles, split into particle_chunk_size chunks.
+// every particle only depends on itself, so the result does not depend on the thread count.
+void update_particles_parallel(
+	job_system_t& job_system,
+	particle_soa_t& particles,
+	const particle_update_params_t& params,
+	particle_kernel_t kernel);
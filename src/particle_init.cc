@@ -0,0 +1,105 @@
+#define GLM_FORCE_INTRINSICS
+#include "particle_init.h"
+#include "random.h"
+
+#include <glm/simd/platform.h>
+
+#include <cstring> // memcpy
+
+static glm::vec3 initial_position(uint64_t seed, size_t idx)
+{
+	auto bits = random_bits(seed, random_stream_particle_position, static_cast<uint32_t>(idx));
+	return random_symmetric3(bits, particle_init_position_scale);
+}
+
+static glm::vec3 initial_velocity(uint64_t seed, size_t idx)
+{
+	auto bits = random_bits(seed, random_stream_particle_velocity, static_cast<uint32_t>(idx));
+	return random_symmetric3(bits, particle_init_velocity_scale);
+}
+
+// mapped buffers are usually write-combined (or at least not something we want in our cache),
+// so bypass the cache when we can.
+static void stream_store(glm::vec4* dst, glm::vec4 value)
+{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	_mm_stream_ps(reinterpret_cast<float*>(dst), _mm_setr_ps(value.x, value.y, value.z, value.w));
+#else
+	*dst = value;
+#endif
+}
+
+static void stream_store(float* dst, float value)
+{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	_mm_stream_si32(reinterpret_cast<int*>(dst), bits);
+#else
+	*dst = value;
+#endif
+}
+
+static void stream_fence()
+{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	_mm_sfence();
+#endif
+}
+
+void init_particles(
+	job_system_t& job_system,
+	size_t count,
+	uint64_t seed,
+	glm::vec4* positions,
+	glm::vec4* velocities,
+	float* lifetimes,
+	size_t first)
+{
+	parallel_for(job_system, count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		// one buffer at a time, so every chunk writes three long sequential runs.
+		if (positions != nullptr)
+		{
+			for (size_t idx = begin; idx != end; ++idx)
+			{
+				stream_store(&positions[idx], glm::vec4(initial_position(seed, first + idx), 0.0f));
+			}
+		}
+		if (velocities != nullptr)
+		{
+			for (size_t idx = begin; idx != end; ++idx)
+			{
+				stream_store(&velocities[idx], glm::vec4(initial_velocity(seed, first + idx), 0.0f));
+			}
+		}
+		// lifetimes start at 0: every particle respawns on the first dispatch.
+		if (lifetimes != nullptr)
+		{
+			for (size_t idx = begin; idx != end; ++idx)
+			{
+				stream_store(&lifetimes[idx], 0.0f);
+			}
+		}
+		stream_fence();
+	});
+}
+
+void init_particles(job_system_t& job_system, particle_soa_t& particles, uint64_t seed)
+{
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx != end; ++idx)
+		{
+			glm::vec3 position = initial_position(seed, idx);
+			glm::vec3 velocity = initial_velocity(seed, idx);
+			particles.x[idx] = position.x;
+			particles.y[idx] = position.y;
+			particles.z[idx] = position.z;
+			particles.vx[idx] = velocity.x;
+			particles.vy[idx] = velocity.y;
+			particles.vz[idx] = velocity.z;
+			particles.life[idx] = 0.0f;
+		}
+	});
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// initial particle state, generated in parallel straight into its destination.
+// For the gpu path that destination is mapped buffer memory, so there is no host side copy
+// of the particles at all (old_main.cc used to keep three 10M element std::arrays around just
+// to hand them to glBufferData once).
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "particle_engine.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// the same distributions as the original rand() based initialization.
+const float particle_init_position_scale = 100.0f / 500.0f;
+const float particle_init_velocity_scale = 500.0f / 30.0f;
+
+// writes particles [first, first + count) in the layout particle.comp reads (vec4 positions, vec4
+// velocities, float lifetimes), to the start of the destination. Any of the pointers may be null
+// to skip that buffer, and chunks generated with a different first fit together seamlessly.
+// the destination is only ever written (with streaming stores where we have them), never read,
+// so it is fine to point this at write-combined memory. positions and velocities have to be
+// 16 byte aligned (mapped buffers always are).
+void init_particles(
+	job_system_t& job_system,
+	size_t count,
+	uint64_t seed,
+	glm::vec4* positions,
+	glm::vec4* velocities,
+	float* lifetimes,
+	size_t first = 0);
+
+// the same particles, for the cpu engine.
+void init_particles(job_system_t& job_system, particle_soa_t& particles, uint64_t seed);
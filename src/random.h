@@ -0,0 +1,86 @@
+#pragma once
+
+// counter based random numbers (philox4x32-10, Salmon et al. 2011).
+// there is no state: the output is a pure function of (counter, key), so every particle can
+// draw its own numbers in parallel, and the same seed always gives the same particles.
+// shaders/particle.comp has the same function, so the cpu engine and the gpu agree bit for bit.
+//
+// counter layout: x = element index (particle, attractor), y = frame index, z = stream, w = 0.
+// key: the 64 bit seed.
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// different uses of the same index must not draw the same numbers.
+enum random_stream_t : uint32_t
+{
+	random_stream_particle_update   = 0, // the noise in particle.comp.
+	random_stream_particle_position = 1,
+	random_stream_particle_velocity = 2,
+	random_stream_attractor_init    = 3,
+	random_stream_attractor_update  = 4,
+};
+
+const uint64_t default_random_seed = 0x5eed5eed5eed5eedull;
+
+const uint32_t philox_m0 = 0xD2511F53u;
+const uint32_t philox_m1 = 0xCD9E8D57u;
+const uint32_t philox_w0 = 0x9E3779B9u;
+const uint32_t philox_w1 = 0xBB67AE85u;
+const int philox_rounds = 10;
+
+inline glm::uvec4 philox4x32(glm::uvec4 counter, glm::uvec2 key)
+{
+	for (int round = 0; round != philox_rounds; ++round)
+	{
+		uint64_t product_0 = static_cast<uint64_t>(philox_m0) * counter.x;
+		uint64_t product_1 = static_cast<uint64_t>(philox_m1) * counter.z;
+		uint32_t hi_0 = static_cast<uint32_t>(product_0 >> 32);
+		uint32_t lo_0 = static_cast<uint32_t>(product_0);
+		uint32_t hi_1 = static_cast<uint32_t>(product_1 >> 32);
+		uint32_t lo_1 = static_cast<uint32_t>(product_1);
+
+		counter = glm::uvec4(hi_1 ^ counter.y ^ key.x, lo_1, hi_0 ^ counter.w ^ key.y, lo_0);
+		key += glm::uvec2(philox_w0, philox_w1);
+	}
+	return counter;
+}
+
+inline glm::uvec2 random_key(uint64_t seed)
+{
+	return glm::uvec2(static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32));
+}
+
+// 128 random bits for element `index` of `stream`.
+inline glm::uvec4 random_bits(uint64_t seed, random_stream_t stream, uint32_t index, uint32_t frame_index = 0)
+{
+	return philox4x32(glm::uvec4(index, frame_index, stream, 0u), random_key(seed));
+}
+
+// [0, 1) from the top 24 bits, which is all a float can hold.
+inline float random_unit(uint32_t bits)
+{
+	return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// [0, 1) from either half of a word, for when we need more than 4 numbers from one call.
+inline float random_unit_lo16(uint32_t bits)
+{
+	return static_cast<float>(bits & 0xffff) * (1.0f / 65536.0f);
+}
+
+inline float random_unit_hi16(uint32_t bits)
+{
+	return static_cast<float>(bits >> 16) * (1.0f / 65536.0f);
+}
+
+// (a - b) * scale with a and b uniform in [0, 1), per component. This is what the old
+// `(rand() % n) / d - (rand() % n) / d` initialization computed.
+inline glm::vec3 random_symmetric3(glm::uvec4 bits, float scale)
+{
+	return glm::vec3(
+		random_unit_lo16(bits.x) - random_unit_hi16(bits.x),
+		random_unit_lo16(bits.y) - random_unit_hi16(bits.y),
+		random_unit_lo16(bits.z) - random_unit_hi16(bits.z)) * scale;
+}
@@ -0,0 +1,63 @@
+// the last step of the shader build in build.bat: reflects every SPIR-V module glslc made and
+// writes the reflection next to it (<name>.spv.refl, see shader_reflect.h), so the app only has to
+// load the two blobs at startup.
+//
+// usage: shader_build file.spv [file.spv ...]
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include "shader_reflect.h"
+
+#include <vector>
+
+static const char* stage_name(VkShaderStageFlagBits stage)
+{
+	switch (stage)
+	{
+		case VK_SHADER_STAGE_VERTEX_BIT: return "vertex";
+		case VK_SHADER_STAGE_FRAGMENT_BIT: return "fragment";
+		case VK_SHADER_STAGE_COMPUTE_BIT: return "compute";
+		default: return "other";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fmt::print("usage: {} file.spv [file.spv ...]\n", argv[0]);
+		return 1;
+	}
+
+	int failed = 0;
+	for (int arg = 1; arg != argc; ++arg)
+	{
+		const char* path = argv[arg];
+		std::vector<uint32_t> code;
+		shader_reflection_t reflection;
+		if (!shader_read_spirv(path, code))
+		{
+			fmt::print("[shader] failed to read {}.\n", path);
+			failed += 1;
+			continue;
+		}
+		if (!shader_reflect(code.data(), code.size(), reflection) || !shader_reflection_write(path, reflection))
+		{
+			fmt::print("[shader] failed to reflect {}.\n", path);
+			failed += 1;
+			continue;
+		}
+
+		fmt::print("[shader] {}: {}", path, stage_name(reflection.stage));
+		if (reflection.stage == VK_SHADER_STAGE_COMPUTE_BIT)
+		{
+			fmt::print(" {}x{}x{}", reflection.local_size[0], reflection.local_size[1], reflection.local_size[2]);
+		}
+		fmt::print(", {} bindings, {} bytes of push constants.\n", reflection.bindings.size(), reflection.push_constant_size);
+		for (const shader_binding_t& binding: reflection.bindings)
+		{
+			fmt::print("[shader]   set {} binding {}: descriptor type {}, count {}.\n", binding.set, binding.binding, static_cast<uint32_t>(binding.descriptor_type), binding.count);
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
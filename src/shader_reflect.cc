@@ -0,0 +1,466 @@
+#include "shader_reflect.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+const uint32_t spirv_magic_number = 0x07230203;
+// "RFLS" in a hex dump.
+const uint32_t reflection_magic = 0x534c4652;
+const uint32_t reflection_version = 1;
+
+// the opcodes, decorations and enums we look at (from the SPIR-V specification).
+enum : uint32_t
+{
+	op_entry_point = 15,
+	op_execution_mode = 16,
+	op_type_bool = 20,
+	op_type_int = 21,
+	op_type_float = 22,
+	op_type_vector = 23,
+	op_type_matrix = 24,
+	op_type_image = 25,
+	op_type_sampler = 26,
+	op_type_sampled_image = 27,
+	op_type_array = 28,
+	op_type_runtime_array = 29,
+	op_type_struct = 30,
+	op_type_pointer = 32,
+	op_constant = 43,
+	op_variable = 59,
+	op_decorate = 71,
+	op_member_decorate = 72,
+
+	decoration_block = 2,
+	decoration_buffer_block = 3,
+	decoration_array_stride = 6,
+	decoration_matrix_stride = 7,
+	decoration_binding = 33,
+	decoration_descriptor_set = 34,
+	decoration_offset = 35,
+
+	execution_mode_local_size = 17,
+	execution_mode_local_size_id = 38,
+
+	storage_class_uniform_constant = 0,
+	storage_class_uniform = 2,
+	storage_class_push_constant = 9,
+	storage_class_storage_buffer = 12,
+
+	image_dim_buffer = 5,
+	image_dim_subpass_data = 6,
+};
+
+struct spirv_type_t
+{
+	uint32_t opcode;
+	// the instruction's operands after the result id.
+	std::vector<uint32_t> operands;
+};
+
+struct spirv_decorations_t
+{
+	bool has_set;
+	bool has_binding;
+	bool block;
+	bool buffer_block;
+	uint32_t set;
+	uint32_t binding;
+	uint32_t array_stride;
+};
+
+struct spirv_member_decorations_t
+{
+	uint32_t offset;
+	uint32_t matrix_stride;
+};
+
+struct spirv_variable_t
+{
+	uint32_t id;
+	uint32_t pointer_type;
+	uint32_t storage_class;
+};
+
+struct spirv_module_t
+{
+	std::unordered_map<uint32_t, spirv_type_t> types;
+	std::unordered_map<uint32_t, uint32_t> constants;
+	std::unordered_map<uint32_t, spirv_decorations_t> decorations;
+	// [struct id][member].
+	std::unordered_map<uint32_t, std::vector<spirv_member_decorations_t>> member_decorations;
+	std::vector<spirv_variable_t> variables;
+};
+
+bool shader_read_spirv(const char* path, std::vector<uint32_t>& code)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr) return false;
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	bool ok = size > 0 && size % sizeof(uint32_t) == 0;
+	if (ok)
+	{
+		code.resize(static_cast<size_t>(size) / sizeof(uint32_t));
+		ok = fread(code.data(), 1, static_cast<size_t>(size), file) == static_cast<size_t>(size);
+	}
+	fclose(file);
+	return ok;
+}
+
+uint64_t shader_spirv_hash(const uint32_t* code, size_t word_count)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t idx = 0; idx != word_count; ++idx)
+	{
+		hash ^= code[idx];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static bool stage_of(uint32_t execution_model, VkShaderStageFlagBits& stage)
+{
+	switch (execution_model)
+	{
+		case 0: stage = VK_SHADER_STAGE_VERTEX_BIT; return true;
+		case 1: stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; return true;
+		case 2: stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; return true;
+		case 3: stage = VK_SHADER_STAGE_GEOMETRY_BIT; return true;
+		case 4: stage = VK_SHADER_STAGE_FRAGMENT_BIT; return true;
+		case 5: stage = VK_SHADER_STAGE_COMPUTE_BIT; return true;
+		default: return false;
+	}
+}
+
+// the size of a type inside a push constant block (or any other explicitly laid out block).
+static uint32_t type_size(const spirv_module_t& module, uint32_t type_id, uint32_t matrix_stride)
+{
+	auto it = module.types.find(type_id);
+	if (it == module.types.end()) return 0;
+	const spirv_type_t& type = it->second;
+	switch (type.opcode)
+	{
+		case op_type_bool: return 4;
+		case op_type_int:
+		case op_type_float: return type.operands[0] / 8;
+		case op_type_vector: return type.operands[1] * type_size(module, type.operands[0], 0);
+		case op_type_matrix:
+		{
+			const uint32_t column_size = matrix_stride != 0 ? matrix_stride : type_size(module, type.operands[0], 0);
+			return type.operands[1] * column_size;
+		}
+		case op_type_array:
+		{
+			auto length = module.constants.find(type.operands[1]);
+			auto decorations = module.decorations.find(type_id);
+			const uint32_t stride = decorations != module.decorations.end() && decorations->second.array_stride != 0 ?
+				decorations->second.array_stride : type_size(module, type.operands[0], matrix_stride);
+			return length != module.constants.end() ? length->second * stride : 0;
+		}
+		case op_type_struct:
+		{
+			// the end of the member that ends last.
+			uint32_t size = 0;
+			auto members = module.member_decorations.find(type_id);
+			for (uint32_t member = 0; member != type.operands.size(); ++member)
+			{
+				spirv_member_decorations_t decorations{};
+				if (members != module.member_decorations.end() && member < members->second.size()) decorations = members->second[member];
+				size = std::max(size, decorations.offset + type_size(module, type.operands[member], decorations.matrix_stride));
+			}
+			return size;
+		}
+		default: return 0;
+	}
+}
+
+static bool descriptor_type_of(const spirv_module_t& module, uint32_t storage_class, uint32_t type_id, VkDescriptorType& descriptor_type)
+{
+	auto it = module.types.find(type_id);
+	if (it == module.types.end()) return false;
+	const spirv_type_t& type = it->second;
+
+	if (storage_class == storage_class_storage_buffer)
+	{
+		descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		return true;
+	}
+	if (storage_class == storage_class_uniform)
+	{
+		// before SPIR-V 1.3 storage buffers are Uniform blocks decorated BufferBlock.
+		auto decorations = module.decorations.find(type_id);
+		const bool buffer_block = decorations != module.decorations.end() && decorations->second.buffer_block;
+		descriptor_type = buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		return true;
+	}
+	if (storage_class != storage_class_uniform_constant) return false;
+
+	switch (type.opcode)
+	{
+		case op_type_sampler: descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER; return true;
+		case op_type_sampled_image: descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; return true;
+		case op_type_image:
+		{
+			// operands: sampled type, dim, depth, arrayed, ms, sampled (2: storage), format.
+			const uint32_t dim = type.operands[1];
+			const bool storage = type.operands[5] == 2;
+			if (dim == image_dim_subpass_data) descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			else if (dim == image_dim_buffer) descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			else descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			return true;
+		}
+		default: return false;
+	}
+}
+
+bool shader_reflect(const uint32_t* code, size_t word_count, shader_reflection_t& reflection)
+{
+	reflection = {};
+	if (word_count < 5 || code[0] != spirv_magic_number)
+	{
+		fmt::print("[shader] not SPIR-V.\n");
+		return false;
+	}
+	reflection.spirv_hash = shader_spirv_hash(code, word_count);
+	reflection.local_size[0] = reflection.local_size[1] = reflection.local_size[2] = 1;
+
+	spirv_module_t module;
+	bool has_entry_point = false;
+	// LocalSizeId names constants, which may come after the execution mode.
+	uint32_t local_size_ids[3]{};
+	bool has_local_size_ids = false;
+
+	for (size_t offset = 5; offset < word_count;)
+	{
+		const uint32_t word_count_of_instruction = code[offset] >> 16;
+		const uint32_t opcode = code[offset] & 0xffff;
+		if (word_count_of_instruction == 0 || offset + word_count_of_instruction > word_count)
+		{
+			fmt::print("[shader] truncated SPIR-V at word {}.\n", offset);
+			return false;
+		}
+		const uint32_t* operands = code + offset + 1;
+		const uint32_t operand_count = word_count_of_instruction - 1;
+		offset += word_count_of_instruction;
+
+		switch (opcode)
+		{
+			case op_entry_point:
+			{
+				// the first entry point; glslc only ever makes one.
+				if (has_entry_point) break;
+				if (!stage_of(operands[0], reflection.stage))
+				{
+					fmt::print("[shader] unknown execution model {}.\n", operands[0]);
+					return false;
+				}
+				has_entry_point = true;
+				break;
+			}
+			case op_execution_mode:
+			{
+				if (operands[1] == execution_mode_local_size && operand_count >= 5)
+				{
+					reflection.local_size[0] = operands[2];
+					reflection.local_size[1] = operands[3];
+					reflection.local_size[2] = operands[4];
+				}
+				else if (operands[1] == execution_mode_local_size_id && operand_count >= 5)
+				{
+					local_size_ids[0] = operands[2];
+					local_size_ids[1] = operands[3];
+					local_size_ids[2] = operands[4];
+					has_local_size_ids = true;
+				}
+				break;
+			}
+			case op_decorate:
+			{
+				spirv_decorations_t& decorations = module.decorations[operands[0]];
+				const uint32_t value = operand_count >= 3 ? operands[2] : 0;
+				switch (operands[1])
+				{
+					case decoration_descriptor_set: decorations.has_set = true; decorations.set = value; break;
+					case decoration_binding: decorations.has_binding = true; decorations.binding = value; break;
+					case decoration_block: decorations.block = true; break;
+					case decoration_buffer_block: decorations.buffer_block = true; break;
+					case decoration_array_stride: decorations.array_stride = value; break;
+					default: break;
+				}
+				break;
+			}
+			case op_member_decorate:
+			{
+				if (operand_count < 4) break;
+				auto& members = module.member_decorations[operands[0]];
+				if (members.size() <= operands[1]) members.resize(operands[1] + 1);
+				if (operands[2] == decoration_offset) members[operands[1]].offset = operands[3];
+				if (operands[2] == decoration_matrix_stride) members[operands[1]].matrix_stride = operands[3];
+				break;
+			}
+			case op_type_bool:
+			case op_type_int:
+			case op_type_float:
+			case op_type_vector:
+			case op_type_matrix:
+			case op_type_image:
+			case op_type_sampler:
+			case op_type_sampled_image:
+			case op_type_array:
+			case op_type_runtime_array:
+			case op_type_struct:
+			case op_type_pointer:
+			{
+				module.types[operands[0]] = {opcode, std::vector<uint32_t>(operands + 1, operands + operand_count)};
+				break;
+			}
+			case op_constant:
+			{
+				// operands: result type, id, value (the low word of wider constants is plenty here).
+				if (operand_count >= 3) module.constants[operands[1]] = operands[2];
+				break;
+			}
+			case op_variable:
+			{
+				module.variables.push_back({operands[1], operands[0], operands[2]});
+				break;
+			}
+			default: break;
+		}
+	}
+
+	if (!has_entry_point)
+	{
+		fmt::print("[shader] no entry point.\n");
+		return false;
+	}
+	if (has_local_size_ids)
+	{
+		for (uint32_t idx = 0; idx != 3; ++idx)
+		{
+			auto it = module.constants.find(local_size_ids[idx]);
+			if (it == module.constants.end())
+			{
+				fmt::print("[shader] the workgroup size is not a constant.\n");
+				return false;
+			}
+			reflection.local_size[idx] = it->second;
+		}
+	}
+
+	for (const spirv_variable_t& variable: module.variables)
+	{
+		auto pointer = module.types.find(variable.pointer_type);
+		if (pointer == module.types.end() || pointer->second.opcode != op_type_pointer) continue;
+		uint32_t type_id = pointer->second.operands[1];
+
+		if (variable.storage_class == storage_class_push_constant)
+		{
+			reflection.push_constant_size = std::max(reflection.push_constant_size, type_size(module, type_id, 0));
+			continue;
+		}
+
+		auto decorations = module.decorations.find(variable.id);
+		if (decorations == module.decorations.end() || !decorations->second.has_binding) continue;
+
+		// arrays of descriptors: a count, or 0 when runtime sized.
+		uint32_t count = 1;
+		auto type = module.types.find(type_id);
+		if (type != module.types.end() && type->second.opcode == op_type_array)
+		{
+			auto length = module.constants.find(type->second.operands[1]);
+			count = length != module.constants.end() ? length->second : 1;
+			type_id = type->second.operands[0];
+		}
+		else if (type != module.types.end() && type->second.opcode == op_type_runtime_array)
+		{
+			count = 0;
+			type_id = type->second.operands[0];
+		}
+
+		shader_binding_t binding{};
+		binding.set = decorations->second.has_set ? decorations->second.set : 0;
+		binding.binding = decorations->second.binding;
+		binding.count = count;
+		if (!descriptor_type_of(module, variable.storage_class, type_id, binding.descriptor_type))
+		{
+			fmt::print("[shader] unknown descriptor type at set {} binding {}.\n", binding.set, binding.binding);
+			return false;
+		}
+
+		// aliased variables share a binding; it is reflected once.
+		auto same = [&binding](const shader_binding_t& other) { return other.set == binding.set && other.binding == binding.binding; };
+		if (std::none_of(reflection.bindings.begin(), reflection.bindings.end(), same)) reflection.bindings.push_back(binding);
+	}
+
+	std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const shader_binding_t& lhs, const shader_binding_t& rhs)
+	{
+		return lhs.set != rhs.set ? lhs.set < rhs.set : lhs.binding < rhs.binding;
+	});
+	return true;
+}
+
+// the sidecar, all little endian uint32_t:
+//   magic, version, hash (low, high), stage, local_size[3], push_constant_size, binding_count,
+//   then per binding: set, binding, descriptor_type, count.
+bool shader_reflection_write(const char* spirv_path, const shader_reflection_t& reflection)
+{
+	std::vector<uint32_t> words = {
+		reflection_magic,
+		reflection_version,
+		static_cast<uint32_t>(reflection.spirv_hash),
+		static_cast<uint32_t>(reflection.spirv_hash >> 32),
+		static_cast<uint32_t>(reflection.stage),
+		reflection.local_size[0],
+		reflection.local_size[1],
+		reflection.local_size[2],
+		reflection.push_constant_size,
+		static_cast<uint32_t>(reflection.bindings.size())
+	};
+	for (const shader_binding_t& binding: reflection.bindings)
+	{
+		words.insert(words.end(), {binding.set, binding.binding, static_cast<uint32_t>(binding.descriptor_type), binding.count});
+	}
+
+	const std::string path = std::string(spirv_path) + ".refl";
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr) return false;
+	bool ok = fwrite(words.data(), sizeof(uint32_t), words.size(), file) == words.size();
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
+
+bool shader_reflection_read(const char* spirv_path, shader_reflection_t& reflection)
+{
+	reflection = {};
+	const std::string path = std::string(spirv_path) + ".refl";
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr) return false;
+
+	uint32_t header[10]{};
+	bool ok = fread(header, sizeof(uint32_t), 10, file) == 10 && header[0] == reflection_magic && header[1] == reflection_version;
+	if (ok)
+	{
+		reflection.spirv_hash = header[2] | (uint64_t{header[3]} << 32);
+		reflection.stage = static_cast<VkShaderStageFlagBits>(header[4]);
+		reflection.local_size[0] = header[5];
+		reflection.local_size[1] = header[6];
+		reflection.local_size[2] = header[7];
+		reflection.push_constant_size = header[8];
+		reflection.bindings.resize(header[9]);
+		for (shader_binding_t& binding: reflection.bindings)
+		{
+			uint32_t words[4]{};
+			ok = ok && fread(words, sizeof(uint32_t), 4, file) == 4;
+			binding = {words[0], words[1], static_cast<VkDescriptorType>(words[2]), words[3]};
+		}
+	}
+	fclose(file);
+	return ok;
+}
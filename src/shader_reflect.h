@@ -0,0 +1,51 @@
+#pragma once
+
+// what a SPIR-V module needs from the pipeline around it: the stage, the workgroup size, the
+// descriptor bindings and the size of the push constants.
+//
+// shader_build (src/shader_build.cc) reflects every compiled shader once, at build time, and
+// writes the result next to it as a small binary sidecar (<name>.spv.refl). At startup the sidecar
+// is read as is; nothing parses SPIR-V or shader text at runtime. The sidecar carries a hash of
+// the SPIR-V it was made from, so a stale one is caught instead of trusted.
+//
+// the reflection only knows the few SPIR-V instructions glslc emits for the things above; it does
+// not validate the module (the driver does that when the module is created).
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct shader_binding_t
+{
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType descriptor_type;
+	// 0 for a runtime sized array.
+	uint32_t count;
+};
+
+struct shader_reflection_t
+{
+	// fnv-1a of the SPIR-V words.
+	uint64_t spirv_hash;
+	VkShaderStageFlagBits stage;
+	// 1x1x1 for anything but compute.
+	uint32_t local_size[3];
+	// 0 without push constants.
+	uint32_t push_constant_size;
+	// sorted by (set, binding).
+	std::vector<shader_binding_t> bindings;
+};
+
+// the words of a .spv file.
+bool shader_read_spirv(const char* path, std::vector<uint32_t>& code);
+uint64_t shader_spirv_hash(const uint32_t* code, size_t word_count);
+
+// prints why when the module has something the reflection does not understand.
+bool shader_reflect(const uint32_t* code, size_t word_count, shader_reflection_t& reflection);
+
+// <spirv_path>.refl.
+bool shader_reflection_write(const char* spirv_path, const shader_reflection_t& reflection);
+bool shader_reflection_read(const char* spirv_path, shader_reflection_t& reflection);
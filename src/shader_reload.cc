@@ -0,0 +1,297 @@
+#include "shader_reload.h"
+
+#include "shader_reflect.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include <utility>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// how long the reload thread sleeps between looks (and how long stop can take).
+const auto reload_poll_interval = std::chrono::milliseconds(100);
+// editors write a file in several steps: wait this long after a change before compiling.
+const auto reload_settle_time = std::chrono::milliseconds(50);
+
+// what the reload thread remembers between looks at the directory.
+struct watch_state_t
+{
+	// the write time of every file, when there is no inotify.
+	std::unordered_map<std::string, std::filesystem::file_time_type> write_times;
+};
+
+static bool ends_with(const std::string& text, const char* suffix)
+{
+	const size_t length = strlen(suffix);
+	return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// marks the programs that use the file. A change to an include (.glsl) marks all of them, because
+// we do not know who includes what.
+static void mark_dirty(shader_reload_t& reload, const std::string& name)
+{
+	const bool include = ends_with(name, ".glsl");
+	for (auto& program: reload.programs)
+	{
+		for (const auto& source: program.sources)
+		{
+			if (include || source == name) program.dirty = true;
+		}
+	}
+}
+
+#ifdef __linux__
+static void wait_for_changes(shader_reload_t& reload, watch_state_t&)
+{
+	pollfd poll_fd{reload.inotify_fd, POLLIN, 0};
+	if (poll(&poll_fd, 1, static_cast<int>(reload_poll_interval.count())) <= 0) return;
+	std::this_thread::sleep_for(reload_settle_time);
+
+	// every event that arrived, including the ones during the settle time.
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		const ssize_t size = read(reload.inotify_fd, buffer, sizeof(buffer));
+		if (size <= 0) break;
+		for (ssize_t offset = 0; offset < size;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			if (event->len != 0) mark_dirty(reload, event->name);
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+}
+#else
+static void wait_for_changes(shader_reload_t& reload, watch_state_t& state)
+{
+	std::this_thread::sleep_for(reload_poll_interval);
+
+	std::error_code error;
+	bool changed = false;
+	for (const auto& entry: std::filesystem::directory_iterator(reload.directory, error))
+	{
+		const std::string name = entry.path().filename().string();
+		const auto write_time = entry.last_write_time(error);
+		if (error) continue;
+		auto it = state.write_times.find(name);
+		if (it != state.write_times.end() && it->second != write_time)
+		{
+			mark_dirty(reload, name);
+			changed = true;
+		}
+		state.write_times[name] = write_time;
+	}
+	if (changed) std::this_thread::sleep_for(reload_settle_time);
+}
+#endif
+
+// the files of one compiled source: the .spv and its sidecar.
+struct compiled_paths_t
+{
+	std::string spirv;
+	std::string reflection;
+};
+
+static compiled_paths_t compiled_paths(const shader_reload_t& reload, const std::string& source, const char* suffix)
+{
+	const std::string spirv_path = reload.directory + "/" + source + ".spv" + suffix;
+	return {spirv_path, spirv_path + ".refl"};
+}
+
+static void remove_compiled(const compiled_paths_t& paths)
+{
+	std::remove(paths.spirv.c_str());
+	std::remove(paths.reflection.c_str());
+}
+
+// a file that is not there is skipped: a new shader has no old version to move aside.
+static bool rename_compiled(const compiled_paths_t& from, const compiled_paths_t& to)
+{
+	std::error_code error;
+	for (const auto& [from_path, to_path]: {std::make_pair(from.spirv, to.spirv), std::make_pair(from.reflection, to.reflection)})
+	{
+		if (!std::filesystem::exists(from_path, error)) continue;
+		std::filesystem::rename(from_path, to_path, error);
+		if (error) return false;
+	}
+	return true;
+}
+
+// source -> <source>.spv.tmp and its sidecar. Nothing the app loads is touched yet.
+static bool compile(shader_reload_t& reload, const std::string& source)
+{
+	const std::string source_path = reload.directory + "/" + source;
+	const compiled_paths_t temporary = compiled_paths(reload, source, ".tmp");
+
+	const std::string command = fmt::format("{} -O \"{}\" -o \"{}\"", reload.compiler, source_path, temporary.spirv);
+	if (std::system(command.c_str()) != 0)
+	{
+		fmt::print("[reload] {} failed to compile, keeping the old version.\n", source);
+		remove_compiled(temporary);
+		return false;
+	}
+
+	std::vector<uint32_t> code;
+	shader_reflection_t reflection;
+	if (!shader_read_spirv(temporary.spirv.c_str(), code) || !shader_reflect(code.data(), code.size(), reflection) ||
+		!shader_reflection_write(temporary.spirv.c_str(), reflection))
+	{
+		fmt::print("[reload] failed to reflect {}, keeping the old version.\n", source);
+		remove_compiled(temporary);
+		return false;
+	}
+	return true;
+}
+
+// every source of the program compiles to a temporary file first. Only when all of them did are
+// they moved in place (the old ones aside), and only when the build worked as well are the old ones
+// thrown away: a program is never left on disk half new and half old.
+static bool compile_and_build(shader_reload_t& reload, shader_reload_program_t& program)
+{
+	bool ok = true;
+	for (const auto& source: program.sources) ok = ok && compile(reload, source);
+
+	size_t installed = 0;
+	for (; ok && installed != program.sources.size(); ++installed)
+	{
+		const std::string& source = program.sources[installed];
+		const compiled_paths_t current = compiled_paths(reload, source, "");
+		if (!rename_compiled(current, compiled_paths(reload, source, ".old")) || !rename_compiled(compiled_paths(reload, source, ".tmp"), current))
+		{
+			fmt::print("[reload] failed to replace {}, keeping the old version.\n", current.spirv);
+			ok = false;
+			// the old files may be half moved aside already: put them back below with the rest.
+			installed += 1;
+			break;
+		}
+	}
+	ok = ok && program.build();
+
+	for (size_t idx = 0; idx != program.sources.size(); ++idx)
+	{
+		const std::string& source = program.sources[idx];
+		const compiled_paths_t old = compiled_paths(reload, source, ".old");
+		if (!ok && idx < installed)
+		{
+			const compiled_paths_t current = compiled_paths(reload, source, "");
+			remove_compiled(current);
+			rename_compiled(old, current);
+		}
+		remove_compiled(old);
+		remove_compiled(compiled_paths(reload, source, ".tmp"));
+	}
+	return ok;
+}
+
+static void reload_main(shader_reload_t& reload)
+{
+	watch_state_t state;
+	while (reload.running.load())
+	{
+		wait_for_changes(reload, state);
+
+		for (auto& program: reload.programs)
+		{
+			if (!program.dirty) continue;
+			{
+				// the last build has not been swapped in yet: it stays dirty until it is.
+				std::lock_guard<std::mutex> lock(reload.mutex);
+				if (program.built) continue;
+			}
+			program.dirty = false;
+
+			const auto start = std::chrono::steady_clock::now();
+			const bool ok = compile_and_build(reload, program);
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(reload.mutex);
+			if (ok)
+			{
+				program.built = true;
+				reload.reload_count += 1;
+				fmt::print("[reload] rebuilt {} in {:.1f} ms.\n", program.sources[0], ms);
+			}
+			else
+			{
+				reload.failure_count += 1;
+			}
+		}
+	}
+}
+
+void shader_reload_init(shader_reload_t& reload, const char* directory)
+{
+	reload.directory = directory;
+	const char* sdk = getenv("VULKAN_SDK");
+#ifdef _WIN32
+	reload.compiler = sdk != nullptr ? fmt::format("{}\\Bin\\glslc", sdk) : "glslc";
+#else
+	reload.compiler = sdk != nullptr ? fmt::format("{}/bin/glslc", sdk) : "glslc";
+#endif
+}
+
+void shader_reload_watch(shader_reload_t& reload, std::vector<std::string> sources, shader_reload_build_fn_t build, shader_reload_swap_fn_t swap)
+{
+	shader_reload_program_t program{};
+	program.sources = std::move(sources);
+	program.build = std::move(build);
+	program.swap = std::move(swap);
+	reload.programs.push_back(std::move(program));
+}
+
+bool shader_reload_start(shader_reload_t& reload)
+{
+#ifdef __linux__
+	reload.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	// a rename covers editors that save to a new file and move it over the old one.
+	if (reload.inotify_fd < 0 || inotify_add_watch(reload.inotify_fd, reload.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		fmt::print("[reload] cannot watch {}, no hot reload.\n", reload.directory);
+		if (reload.inotify_fd >= 0) close(reload.inotify_fd);
+		reload.inotify_fd = -1;
+		return false;
+	}
+#endif
+	reload.running.store(true);
+	reload.thread = std::thread(reload_main, std::ref(reload));
+	fmt::print("[reload] watching {} shader programs in {}, compiling with {}.\n", reload.programs.size(), reload.directory, reload.compiler);
+	return true;
+}
+
+void shader_reload_apply(shader_reload_t& reload)
+{
+	// try_lock: a build that is finishing right now just waits for the next frame.
+	std::unique_lock<std::mutex> lock(reload.mutex, std::try_to_lock);
+	if (!lock.owns_lock()) return;
+	for (auto& program: reload.programs)
+	{
+		if (!program.built) continue;
+		program.swap();
+		program.built = false;
+	}
+}
+
+void shader_reload_stop(shader_reload_t& reload)
+{
+	if (!reload.running.exchange(false)) return;
+	reload.thread.join();
+#ifdef __linux__
+	close(reload.inotify_fd);
+	reload.inotify_fd = -1;
+#endif
+	if (reload.reload_count + reload.failure_count != 0)
+	{
+		fmt::print("[reload] {} reloads, {} failed.\n", reload.reload_count, reload.failure_count);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// shader hot reload: edit a shader in shaders/ while the app runs and see the result a moment later.
+//
+// a background thread watches the shader directory (inotify on linux, the file times everywhere
+// else). When a source changes it compiles every source of the program with glslc (-O, like
+// build.bat) into temporary files and reflects them (shader_reflect.h). Only when all of them
+// worked are the .spv files and their sidecars replaced, and then it calls the program's build
+// function, still on the background thread, which makes the new pipeline and keeps it aside. The frame loop calls shader_reload_apply at a frame
+// boundary, which calls swap for every program that was rebuilt: the only work the frame loop ever
+// does for a reload is swapping a handle.
+//
+// a failed compile or build leaves everything as it was: the old .spv files of the program are
+// put back on disk, all of them, and the old pipeline keeps running. glslc's errors go to the console.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// runs on the reload thread, once every source of the program is compiled. Returns false when
+// nothing was built.
+using shader_reload_build_fn_t = std::function<bool()>;
+// runs on the frame loop's thread, in shader_reload_apply, after a successful build.
+using shader_reload_swap_fn_t = std::function<void()>;
+
+struct shader_reload_program_t
+{
+	// the glsl sources in the shader directory. Each compiles to <source>.spv.
+	std::vector<std::string> sources;
+	shader_reload_build_fn_t build;
+	shader_reload_swap_fn_t swap;
+	// a source changed since the last build (reload thread only).
+	bool dirty;
+	// built, waiting for apply. Guarded by the mutex.
+	bool built;
+};
+
+struct shader_reload_t
+{
+	std::string directory;
+	// glslc, from $VULKAN_SDK when it is set.
+	std::string compiler;
+	std::vector<shader_reload_program_t> programs;
+
+	std::thread thread;
+	std::atomic<bool> running{false};
+	std::mutex mutex;
+	// inotify instance and its watch, -1 without.
+	int inotify_fd = -1;
+
+	uint32_t reload_count = 0;
+	uint32_t failure_count = 0;
+};
+
+void shader_reload_init(shader_reload_t& reload, const char* directory);
+// before shader_reload_start. sources are names in the directory (e.g. "particle_sim.comp").
+void shader_reload_watch(shader_reload_t& reload, std::vector<std::string> sources, shader_reload_build_fn_t build, shader_reload_swap_fn_t swap);
+bool shader_reload_start(shader_reload_t& reload);
+// at a frame boundary: swaps in whatever was rebuilt since the last call.
+void shader_reload_apply(shader_reload_t& reload);
+// joins the thread. A build that is still running finishes first; a pending one is never swapped
+// in, so its owner has to clean it up.
+void shader_reload_stop(shader_reload_t& reload);
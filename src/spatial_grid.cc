@@ -0,0 +1,108 @@
+#include "spatial_grid.h"
+
+#include <algorithm> // std::sort
+
+// buckets per scan job.
+const size_t spatial_grid_scan_chunk_size = 64 * 1024;
+
+static uint32_t next_power_of_two(size_t value)
+{
+	uint32_t result = 1;
+	while (result < value) result <<= 1;
+	return result;
+}
+
+void spatial_grid_init(spatial_grid_t& grid, float cell_size, size_t particle_count, uint32_t bucket_count)
+{
+	grid.cell_size = cell_size;
+	grid.bucket_count = next_power_of_two(bucket_count != 0 ? bucket_count : particle_count);
+
+	grid.cell_start.assign(grid.bucket_count + 1, 0);
+	grid.sorted_indices.assign(particle_count, 0);
+	grid.particle_bucket.assign(particle_count, 0);
+	grid.bucket_counters = std::make_unique<std::atomic<uint32_t>[]>(grid.bucket_count);
+	grid.chunk_sums.assign((grid.bucket_count + spatial_grid_scan_chunk_size - 1) / spatial_grid_scan_chunk_size, 0);
+}
+
+void spatial_grid_build(spatial_grid_t& grid, job_system_t& job_system, const particle_soa_t& particles)
+{
+	if (grid.sorted_indices.size() != particles.count)
+	{
+		spatial_grid_init(grid, grid.cell_size, particles.count, grid.bucket_count);
+	}
+	const size_t bucket_count = grid.bucket_count;
+
+	parallel_for(job_system, bucket_count, spatial_grid_scan_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t bucket = begin; bucket != end; ++bucket)
+		{
+			grid.bucket_counters[bucket].store(0, std::memory_order_relaxed);
+		}
+	});
+
+	// 1. count.
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx != end; ++idx)
+		{
+			glm::vec3 position{particles.x[idx], particles.y[idx], particles.z[idx]};
+			uint32_t bucket = spatial_grid_bucket(grid, spatial_grid_cell(grid, position));
+			grid.particle_bucket[idx] = bucket;
+			grid.bucket_counters[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	// 2. scan: sum every chunk of buckets, scan the (few) chunk sums serially, then let every chunk
+	// write its own offsets. Also resets the counters to the bucket start for the scatter.
+	parallel_for(job_system, bucket_count, spatial_grid_scan_chunk_size, [&](size_t chunk_index, size_t begin, size_t end)
+	{
+		uint32_t sum = 0;
+		for (size_t bucket = begin; bucket != end; ++bucket)
+		{
+			sum += grid.bucket_counters[bucket].load(std::memory_order_relaxed);
+		}
+		grid.chunk_sums[chunk_index] = sum;
+	});
+
+	uint32_t running_sum = 0;
+	for (auto& chunk_sum: grid.chunk_sums)
+	{
+		uint32_t sum = chunk_sum;
+		chunk_sum = running_sum;
+		running_sum += sum;
+	}
+	grid.cell_start[bucket_count] = running_sum;
+
+	parallel_for(job_system, bucket_count, spatial_grid_scan_chunk_size, [&](size_t chunk_index, size_t begin, size_t end)
+	{
+		uint32_t offset = grid.chunk_sums[chunk_index];
+		for (size_t bucket = begin; bucket != end; ++bucket)
+		{
+			uint32_t count = grid.bucket_counters[bucket].load(std::memory_order_relaxed);
+			grid.cell_start[bucket] = offset;
+			grid.bucket_counters[bucket].store(offset, std::memory_order_relaxed);
+			offset += count;
+		}
+	});
+
+	// 3. scatter.
+	parallel_for(job_system, particles.count, particle_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t idx = begin; idx != end; ++idx)
+		{
+			uint32_t slot = grid.bucket_counters[grid.particle_bucket[idx]].fetch_add(1, std::memory_order_relaxed);
+			grid.sorted_indices[slot] = static_cast<uint32_t>(idx);
+		}
+	});
+
+	// 4. order: buckets hold a handful of particles on average, so this is cheap.
+	parallel_for(job_system, bucket_count, spatial_grid_scan_chunk_size, [&](size_t, size_t begin, size_t end)
+	{
+		for (size_t bucket = begin; bucket != end; ++bucket)
+		{
+			uint32_t* first = grid.sorted_indices.data() + grid.cell_start[bucket];
+			uint32_t* last = grid.sorted_indices.data() + grid.cell_start[bucket + 1];
+			if (last - first > 1) std::sort(first, last);
+		}
+	});
+}
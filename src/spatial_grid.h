@@ -0,0 +1,118 @@
+#pragma once
+
+// uniform grid over the particles, stored as a spatial hash so it does not need bounds.
+// rebuilt from scratch every frame in O(N) with a parallel counting sort:
+//   1. count:   bucket of every particle, atomic increment of its bucket count.
+//   2. scan:    exclusive prefix sum over the counts -> cell_start.
+//   3. scatter: every particle claims a slot in its bucket with an atomic increment.
+//   4. order:   sort every (small) bucket by particle index, so the result does not
+//               depend on the thread count or on who won the atomics.
+// cell_start / sorted_indices are plain uint arrays that can be uploaded as SSBOs as-is;
+// shaders/spatial_grid.glsl has the hash and the lookups for shaders that use the grid.
+//
+// different cells can hash to the same bucket, so a bucket can contain particles from
+// elsewhere. Queries always check the actual distance.
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "particle_engine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// the primes from Teschner et al. 2003, "Optimized Spatial Hashing for Collision Detection of Deformable Objects".
+const uint32_t spatial_hash_prime_x = 73856093u;
+const uint32_t spatial_hash_prime_y = 19349663u;
+const uint32_t spatial_hash_prime_z = 83492791u;
+
+struct spatial_grid_t
+{
+	float cell_size = 1.0f;
+	// power of two.
+	uint32_t bucket_count = 0;
+
+	// the particles in bucket b are sorted_indices[cell_start[b] .. cell_start[b + 1]).
+	std::vector<uint32_t> cell_start;
+	std::vector<uint32_t> sorted_indices;
+
+	// scratch, kept around so a rebuild does not allocate.
+	std::vector<uint32_t> particle_bucket;
+	std::unique_ptr<std::atomic<uint32_t>[]> bucket_counters;
+	std::vector<uint32_t> chunk_sums;
+};
+
+// bucket_count == 0 picks the next power of two >= particle_count.
+void spatial_grid_init(spatial_grid_t& grid, float cell_size, size_t particle_count, uint32_t bucket_count = 0);
+
+void spatial_grid_build(spatial_grid_t& grid, job_system_t& job_system, const particle_soa_t& particles);
+
+inline glm::ivec3 spatial_grid_cell(const spatial_grid_t& grid, glm::vec3 position)
+{
+	return glm::ivec3(glm::floor(position / grid.cell_size));
+}
+
+inline uint32_t spatial_grid_bucket(const spatial_grid_t& grid, glm::ivec3 cell)
+{
+	uint32_t hash =
+		(static_cast<uint32_t>(cell.x) * spatial_hash_prime_x) ^
+		(static_cast<uint32_t>(cell.y) * spatial_hash_prime_y) ^
+		(static_cast<uint32_t>(cell.z) * spatial_hash_prime_z);
+	return hash & (grid.bucket_count - 1);
+}
+
+// calls fn(particle_index, distance_squared) for every particle within radius of position.
+// every particle is reported once, in a fixed order.
+template <typename fn_t>
+void spatial_grid_for_each_neighbor(
+	const spatial_grid_t& grid,
+	const particle_soa_t& particles,
+	glm::vec3 position,
+	float radius,
+	fn_t&& fn)
+{
+	const glm::ivec3 min_cell = spatial_grid_cell(grid, position - radius);
+	const glm::ivec3 max_cell = spatial_grid_cell(grid, position + radius);
+	const float radius_2 = radius * radius;
+
+	// neighbouring cells can share a bucket: collect the buckets of the cells, sorted and without
+	// repeats, then visit each once. Up to 27 cells (radius <= cell_size) stay on the stack.
+	const glm::ivec3 cell_dims = max_cell - min_cell + 1;
+	const size_t cell_count = static_cast<size_t>(cell_dims.x) * cell_dims.y * cell_dims.z;
+
+	const size_t max_local_buckets = 27;
+	uint32_t local_buckets[max_local_buckets];
+	std::vector<uint32_t> heap_buckets;
+	uint32_t* buckets = local_buckets;
+	if (cell_count > max_local_buckets)
+	{
+		heap_buckets.resize(cell_count);
+		buckets = heap_buckets.data();
+	}
+
+	size_t bucket_count = 0;
+	for (int z = min_cell.z; z <= max_cell.z; ++z)
+	for (int y = min_cell.y; y <= max_cell.y; ++y)
+	for (int x = min_cell.x; x <= max_cell.x; ++x)
+	{
+		buckets[bucket_count++] = spatial_grid_bucket(grid, glm::ivec3(x, y, z));
+	}
+	std::sort(buckets, buckets + bucket_count);
+	bucket_count = std::unique(buckets, buckets + bucket_count) - buckets;
+
+	for (size_t bucket_idx = 0; bucket_idx != bucket_count; ++bucket_idx)
+	{
+		const uint32_t bucket = buckets[bucket_idx];
+		for (uint32_t slot = grid.cell_start[bucket]; slot != grid.cell_start[bucket + 1]; ++slot)
+		{
+			uint32_t particle_index = grid.sorted_indices[slot];
+			glm::vec3 delta = glm::vec3(particles.x[particle_index], particles.y[particle_index], particles.z[particle_index]) - position;
+			float distance_2 = glm::dot(delta, delta);
+			if (distance_2 <= radius_2) fn(particle_index, distance_2);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#include "uniform_ring.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+// how long to block per glClientWaitSync before trying again.
+const GLuint64 uniform_ring_wait_timeout_ns = 1000000000;
+
+static size_t align_up(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+bool uniform_ring_init(uniform_ring_t& ring, size_t size, uint32_t slice_count)
+{
+	ring = {};
+
+	GLint offset_alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+	if (offset_alignment <= 0) offset_alignment = 256;
+
+	ring.slice_size = align_up(size, static_cast<size_t>(offset_alignment));
+	ring.slice_count = slice_count < 1 ? 1 : (slice_count > uniform_ring_max_slices ? uniform_ring_max_slices : slice_count);
+
+	// coherent, so there is no flush either: writes are visible to commands issued after them.
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const size_t buffer_size = ring.slice_size * ring.slice_count;
+
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+	glBufferStorage(GL_UNIFORM_BUFFER, buffer_size, nullptr, flags);
+	ring.mapped = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, buffer_size, flags));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	if (ring.mapped == nullptr)
+	{
+		fmt::print("failed to map the uniform ring buffer ({} bytes)\n", buffer_size);
+		uniform_ring_shutdown(ring);
+		return false;
+	}
+	return true;
+}
+
+void uniform_ring_shutdown(uniform_ring_t& ring)
+{
+	for (auto& fence: ring.fences)
+	{
+		if (fence != nullptr) glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	if (ring.buffer != 0)
+	{
+		if (ring.mapped != nullptr)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &ring.buffer);
+	}
+	ring.buffer = 0;
+	ring.mapped = nullptr;
+}
+
+void* uniform_ring_begin_frame(uniform_ring_t& ring)
+{
+	GLsync& fence = ring.fences[ring.current_slice];
+	if (fence != nullptr)
+	{
+		// the common case: this slice was last used slice_count frames ago and is long done.
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			ring.stall_count += 1;
+			do
+			{
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, uniform_ring_wait_timeout_ns);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	return ring.mapped + ring.current_slice * ring.slice_size;
+}
+
+void uniform_ring_bind(const uniform_ring_t& ring, uint32_t binding)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.buffer, ring.current_slice * ring.slice_size, ring.slice_size);
+}
+
+void uniform_ring_end_frame(uniform_ring_t& ring)
+{
+	ring.fences[ring.current_slice] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring.current_slice = (ring.current_slice + 1) % ring.slice_count;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// persistently mapped uniform buffer, split into one slice per frame in flight.
+// Every frame the cpu writes that frame's constants straight into its own slice and binds it with
+// glBindBufferRange; a fence after the frame's commands tells us when the gpu is done with it.
+// With a few slices in flight the fence has long been signalled by the time we come around again,
+// so an update is a memcpy into mapped memory: no glMapBufferRange, no orphaning, no driver sync.
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+const uint32_t uniform_ring_max_slices = 4;
+const uint32_t uniform_ring_default_slices = 3;
+
+struct uniform_ring_t
+{
+	uint32_t buffer;
+	uint8_t* mapped;
+	// size of one slice, rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+	size_t slice_size;
+	uint32_t slice_count;
+	uint32_t current_slice;
+	std::array<GLsync, uniform_ring_max_slices> fences;
+	// frames where we actually had to wait for the gpu. Should stay at 0.
+	uint64_t stall_count;
+};
+
+// size is the size of the per-frame constants. Returns false if the buffer could not be mapped.
+bool uniform_ring_init(uniform_ring_t& ring, size_t size, uint32_t slice_count = uniform_ring_default_slices);
+void uniform_ring_shutdown(uniform_ring_t& ring);
+
+// returns this frame's slice, after waiting for the gpu to be done with it.
+// the memory is write-combined: write it in one go and never read from it.
+void* uniform_ring_begin_frame(uniform_ring_t& ring);
+// binds this frame's slice to a GL_UNIFORM_BUFFER binding point.
+void uniform_ring_bind(const uniform_ring_t& ring, uint32_t binding);
+// fences everything submitted with this frame's slice and moves on to the next one.
+void uniform_ring_end_frame(uniform_ring_t& ring);
@@ -0,0 +1,820 @@
+#include "vk_allocator.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm> // std::min, std::max
+#include <bit> // std::countl_zero, std::countr_zero, std::popcount
+#include <cassert>
+
+const uint32_t no_node = UINT32_MAX;
+const uint32_t no_block = UINT32_MAX;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//
+// tlsf
+//
+
+// the list a free range of this size goes into.
+static void tlsf_mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+	fl = 63 - static_cast<uint32_t>(std::countl_zero(size));
+	sl = static_cast<uint32_t>(size >> (fl - vk_tlsf_sl_bits)) & (vk_tlsf_sl_count - 1);
+}
+
+static uint32_t tlsf_new_node(vk_tlsf_t& tlsf)
+{
+	if (!tlsf.unused_nodes.empty())
+	{
+		uint32_t node = tlsf.unused_nodes.back();
+		tlsf.unused_nodes.pop_back();
+		return node;
+	}
+	tlsf.nodes.push_back({});
+	return static_cast<uint32_t>(tlsf.nodes.size() - 1);
+}
+
+static void tlsf_insert_free(vk_tlsf_t& tlsf, uint32_t node_idx)
+{
+	vk_tlsf_node_t& node = tlsf.nodes[node_idx];
+	uint32_t fl, sl;
+	tlsf_mapping(node.size, fl, sl);
+	uint32_t& head = tlsf.free_heads[fl * vk_tlsf_sl_count + sl];
+
+	node.free = true;
+	node.prev_free = no_node;
+	node.next_free = head;
+	if (head != no_node) tlsf.nodes[head].prev_free = node_idx;
+	head = node_idx;
+
+	tlsf.fl_bitmap |= 1ull << fl;
+	tlsf.sl_bitmap[fl] |= 1u << sl;
+}
+
+static void tlsf_remove_free(vk_tlsf_t& tlsf, uint32_t node_idx)
+{
+	vk_tlsf_node_t& node = tlsf.nodes[node_idx];
+	uint32_t fl, sl;
+	tlsf_mapping(node.size, fl, sl);
+	uint32_t& head = tlsf.free_heads[fl * vk_tlsf_sl_count + sl];
+
+	if (node.prev_free != no_node) tlsf.nodes[node.prev_free].next_free = node.next_free;
+	else head = node.next_free;
+	if (node.next_free != no_node) tlsf.nodes[node.next_free].prev_free = node.prev_free;
+
+	if (head == no_node)
+	{
+		tlsf.sl_bitmap[fl] &= ~(1u << sl);
+		if (tlsf.sl_bitmap[fl] == 0) tlsf.fl_bitmap &= ~(1ull << fl);
+	}
+	node.free = false;
+}
+
+// a free range of at least size bytes, or no_node.
+static uint32_t tlsf_find_free(const vk_tlsf_t& tlsf, VkDeviceSize size)
+{
+	// round up to the next list, so that anything in the list we find is large enough.
+	uint32_t fl, sl;
+	tlsf_mapping(size, fl, sl);
+	size += (VkDeviceSize{1} << (fl - vk_tlsf_sl_bits)) - 1;
+	tlsf_mapping(size, fl, sl);
+	if (fl >= vk_tlsf_fl_count) return no_node;
+
+	uint32_t sl_map = tlsf.sl_bitmap[fl] & (~0u << sl);
+	if (sl_map == 0)
+	{
+		const uint64_t fl_map = fl + 1 < 64 ? tlsf.fl_bitmap & (~0ull << (fl + 1)) : 0;
+		if (fl_map == 0) return no_node;
+		fl = static_cast<uint32_t>(std::countr_zero(fl_map));
+		sl_map = tlsf.sl_bitmap[fl];
+	}
+	sl = static_cast<uint32_t>(std::countr_zero(sl_map));
+	return tlsf.free_heads[fl * vk_tlsf_sl_count + sl];
+}
+
+static void tlsf_init(vk_tlsf_t& tlsf, VkDeviceSize size)
+{
+	tlsf = {};
+	tlsf.size = size;
+	tlsf.free_heads.fill(no_node);
+
+	uint32_t node_idx = tlsf_new_node(tlsf);
+	vk_tlsf_node_t& node = tlsf.nodes[node_idx];
+	node.offset = 0;
+	node.size = size;
+	node.prev_physical = no_node;
+	node.next_physical = no_node;
+	tlsf_insert_free(tlsf, node_idx);
+}
+
+// splits the range [node.offset + size, end) off into a new free node.
+static void tlsf_split(vk_tlsf_t& tlsf, uint32_t node_idx, VkDeviceSize size)
+{
+	uint32_t rest_idx = tlsf_new_node(tlsf);
+	vk_tlsf_node_t& node = tlsf.nodes[node_idx];
+	vk_tlsf_node_t& rest = tlsf.nodes[rest_idx];
+	rest = {};
+	rest.offset = node.offset + size;
+	rest.size = node.size - size;
+	rest.prev_physical = node_idx;
+	rest.next_physical = node.next_physical;
+	if (node.next_physical != no_node) tlsf.nodes[node.next_physical].prev_physical = rest_idx;
+	node.next_physical = rest_idx;
+	node.size = size;
+	tlsf_insert_free(tlsf, rest_idx);
+}
+
+static uint32_t tlsf_allocate(vk_tlsf_t& tlsf, VkDeviceSize size, VkDeviceSize alignment, bool movable, uint64_t user_data)
+{
+	size = align_up(std::max(size, vk_allocator_granularity), vk_allocator_granularity);
+	alignment = std::max(alignment, vk_allocator_granularity);
+	// every offset is a multiple of the granularity, so larger alignments need at most this much padding.
+	const VkDeviceSize padding = alignment - vk_allocator_granularity;
+
+	uint32_t node_idx = tlsf_find_free(tlsf, size + padding);
+	if (node_idx == no_node) return no_node;
+	tlsf_remove_free(tlsf, node_idx);
+
+	const VkDeviceSize front = align_up(tlsf.nodes[node_idx].offset, alignment) - tlsf.nodes[node_idx].offset;
+	if (front != 0)
+	{
+		// keep the padding in front as a free node of its own, and continue with the rest.
+		tlsf_split(tlsf, node_idx, front);
+		const uint32_t aligned_idx = tlsf.nodes[node_idx].next_physical;
+		tlsf_remove_free(tlsf, aligned_idx);
+		tlsf_insert_free(tlsf, node_idx);
+		node_idx = aligned_idx;
+	}
+	if (tlsf.nodes[node_idx].size - size >= vk_allocator_granularity)
+	{
+		tlsf_split(tlsf, node_idx, size);
+	}
+
+	vk_tlsf_node_t& node = tlsf.nodes[node_idx];
+	node.free = false;
+	node.alignment = alignment;
+	node.movable = movable;
+	node.user_data = user_data;
+	tlsf.used += node.size;
+	tlsf.allocation_count += 1;
+	return node_idx;
+}
+
+static void tlsf_free(vk_tlsf_t& tlsf, uint32_t node_idx)
+{
+	assert(!tlsf.nodes[node_idx].free);
+	tlsf.used -= tlsf.nodes[node_idx].size;
+	tlsf.allocation_count -= 1;
+
+	// merge with the free neighbours, so there are never two free nodes next to each other.
+	const uint32_t next_idx = tlsf.nodes[node_idx].next_physical;
+	if (next_idx != no_node && tlsf.nodes[next_idx].free)
+	{
+		tlsf_remove_free(tlsf, next_idx);
+		vk_tlsf_node_t& next = tlsf.nodes[next_idx];
+		tlsf.nodes[node_idx].size += next.size;
+		tlsf.nodes[node_idx].next_physical = next.next_physical;
+		if (next.next_physical != no_node) tlsf.nodes[next.next_physical].prev_physical = node_idx;
+		next.size = 0;
+		tlsf.unused_nodes.push_back(next_idx);
+	}
+
+	const uint32_t prev_idx = tlsf.nodes[node_idx].prev_physical;
+	if (prev_idx != no_node && tlsf.nodes[prev_idx].free)
+	{
+		tlsf_remove_free(tlsf, prev_idx);
+		vk_tlsf_node_t& node = tlsf.nodes[node_idx];
+		tlsf.nodes[prev_idx].size += node.size;
+		tlsf.nodes[prev_idx].next_physical = node.next_physical;
+		if (node.next_physical != no_node) tlsf.nodes[node.next_physical].prev_physical = prev_idx;
+		node.size = 0;
+		tlsf.unused_nodes.push_back(node_idx);
+		node_idx = prev_idx;
+	}
+
+	tlsf_insert_free(tlsf, node_idx);
+}
+
+//
+// allocator
+//
+
+static bool is_host_coherent(const vk_allocator_t& allocator, uint32_t memory_type)
+{
+	return allocator.memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+static uint32_t heap_of(const vk_allocator_t& allocator, uint32_t memory_type)
+{
+	return allocator.memory_properties.memoryTypes[memory_type].heapIndex;
+}
+
+static VkDeviceSize heap_usage(const vk_allocator_t& allocator, uint32_t heap)
+{
+	// what the driver told us at the last update, plus what we allocated since.
+	return allocator.heap_usage_at_update[heap] + allocator.heap_allocated[heap] - allocator.heap_allocated_at_update[heap];
+}
+
+static bool over_budget(const vk_allocator_t& allocator, uint32_t heap, VkDeviceSize size)
+{
+	return heap_usage(allocator, heap) + size > allocator.heap_budget[heap];
+}
+
+// 1/8th of the heap, so a small heap is not used up by a handful of half empty blocks.
+static VkDeviceSize preferred_block_size(const vk_allocator_t& allocator, uint32_t memory_type)
+{
+	const VkDeviceSize heap_size = allocator.memory_properties.memoryHeaps[heap_of(allocator, memory_type)].size;
+	return std::clamp(std::bit_floor(heap_size / 8), vk_allocator_min_block_size, vk_allocator_max_block_size);
+}
+
+static VkDeviceMemory allocate_device_memory(vk_allocator_t& allocator, VkDeviceSize size, uint32_t memory_type, const void* next, uint8_t*& mapped)
+{
+	mapped = nullptr;
+	if (allocator.allocation_count >= allocator.max_allocation_count) return VK_NULL_HANDLE;
+
+	VkMemoryAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.pNext = next;
+	allocate_info.allocationSize = size;
+	allocate_info.memoryTypeIndex = memory_type;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (vkAllocateMemory(allocator.device, &allocate_info, nullptr, &memory) != VK_SUCCESS) return VK_NULL_HANDLE;
+
+	// host visible memory stays mapped for its whole life.
+	if (allocator.memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		void* data = nullptr;
+		if (vkMapMemory(allocator.device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+		{
+			vkFreeMemory(allocator.device, memory, nullptr);
+			return VK_NULL_HANDLE;
+		}
+		mapped = static_cast<uint8_t*>(data);
+	}
+
+	allocator.allocation_count += 1;
+	allocator.heap_allocated[heap_of(allocator, memory_type)] += size;
+	return memory;
+}
+
+static void free_device_memory(vk_allocator_t& allocator, VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type)
+{
+	vkFreeMemory(allocator.device, memory, nullptr);
+	allocator.allocation_count -= 1;
+	allocator.heap_allocated[heap_of(allocator, memory_type)] -= size;
+}
+
+static uint32_t create_block(vk_allocator_t& allocator, uint32_t memory_type, bool image, VkDeviceSize min_size)
+{
+	const uint32_t heap = heap_of(allocator, memory_type);
+	VkDeviceSize size = preferred_block_size(allocator, memory_type);
+	// close to the budget: rather more small blocks than one large block we do not fill.
+	while (size / 2 >= min_size && size / 2 >= vk_allocator_min_block_size && over_budget(allocator, heap, size)) size /= 2;
+
+	uint8_t* mapped = nullptr;
+	VkDeviceMemory memory = allocate_device_memory(allocator, size, memory_type, nullptr, mapped);
+	if (memory == VK_NULL_HANDLE) return no_block;
+
+	uint32_t block_idx = 0;
+	while (block_idx != allocator.blocks.size() && allocator.blocks[block_idx].memory != VK_NULL_HANDLE) ++block_idx;
+	if (block_idx == allocator.blocks.size()) allocator.blocks.emplace_back();
+
+	vk_memory_block_t& block = allocator.blocks[block_idx];
+	block.memory = memory;
+	block.mapped = mapped;
+	block.memory_type = memory_type;
+	block.image = image;
+	tlsf_init(block.tlsf, size);
+	return block_idx;
+}
+
+static void destroy_block(vk_allocator_t& allocator, uint32_t block_idx)
+{
+	vk_memory_block_t& block = allocator.blocks[block_idx];
+	free_device_memory(allocator, block.memory, block.tlsf.size, block.memory_type);
+	block = {};
+}
+
+static void fill_allocation(const vk_allocator_t& allocator, uint32_t block_idx, uint32_t node_idx, vk_allocation_t& allocation)
+{
+	const vk_memory_block_t& block = allocator.blocks[block_idx];
+	const vk_tlsf_node_t& node = block.tlsf.nodes[node_idx];
+	allocation.memory = block.memory;
+	allocation.offset = node.offset;
+	allocation.size = node.size;
+	allocation.mapped = block.mapped ? block.mapped + node.offset : nullptr;
+	allocation.memory_type = block.memory_type;
+	allocation.block = block_idx;
+	allocation.node = node_idx;
+}
+
+// sub-allocates from the existing blocks of this memory type. Skips skip_block.
+static bool allocate_from_blocks(vk_allocator_t& allocator, const VkMemoryRequirements& requirements, uint32_t memory_type, bool image, bool movable, uint64_t user_data, uint32_t skip_block, vk_allocation_t& allocation)
+{
+	for (uint32_t block_idx = 0; block_idx != allocator.blocks.size(); ++block_idx)
+	{
+		vk_memory_block_t& block = allocator.blocks[block_idx];
+		if (block.memory == VK_NULL_HANDLE || block.memory_type != memory_type || block.image != image || block_idx == skip_block) continue;
+		if (block.tlsf.size - block.tlsf.used < requirements.size) continue;
+
+		uint32_t node_idx = tlsf_allocate(block.tlsf, requirements.size, requirements.alignment, movable, user_data);
+		if (node_idx == no_node) continue;
+		fill_allocation(allocator, block_idx, node_idx, allocation);
+		return true;
+	}
+	return false;
+}
+
+static bool allocate_dedicated(vk_allocator_t& allocator, const VkMemoryRequirements& requirements, uint32_t memory_type, const void* next, vk_allocation_t& allocation)
+{
+	uint8_t* mapped = nullptr;
+	VkDeviceMemory memory = allocate_device_memory(allocator, requirements.size, memory_type, next, mapped);
+	if (memory == VK_NULL_HANDLE) return false;
+
+	allocation = {};
+	allocation.memory = memory;
+	allocation.size = requirements.size;
+	allocation.mapped = mapped;
+	allocation.memory_type = memory_type;
+	allocation.block = vk_allocation_dedicated;
+	allocator.dedicated_count += 1;
+	return true;
+}
+
+// dedicated_next is the VkMemoryDedicatedAllocateInfo for the resource, if there is one.
+static bool allocate(vk_allocator_t& allocator, const VkMemoryRequirements& requirements, vk_memory_usage_t usage, bool image, bool dedicated, const void* dedicated_next, bool movable, uint64_t user_data, vk_allocation_t& allocation)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+
+	// try the best memory type first, and the next best ones if that heap is full.
+	uint32_t type_bits = requirements.memoryTypeBits;
+	while (true)
+	{
+		const uint32_t memory_type = vk_allocator_find_memory_type(allocator, type_bits, usage);
+		if (memory_type == UINT32_MAX) return false;
+		type_bits &= ~(1u << memory_type);
+
+		const bool use_dedicated = dedicated || requirements.size > preferred_block_size(allocator, memory_type) / 2;
+		if (use_dedicated)
+		{
+			if (allocate_dedicated(allocator, requirements, memory_type, dedicated_next, allocation)) return true;
+			continue;
+		}
+
+		if (allocate_from_blocks(allocator, requirements, memory_type, image, movable, user_data, no_block, allocation)) return true;
+
+		const uint32_t block_idx = create_block(allocator, memory_type, image, requirements.size + requirements.alignment);
+		if (block_idx != no_block)
+		{
+			uint32_t node_idx = tlsf_allocate(allocator.blocks[block_idx].tlsf, requirements.size, requirements.alignment, movable, user_data);
+			assert(node_idx != no_node);
+			fill_allocation(allocator, block_idx, node_idx, allocation);
+			return true;
+		}
+		// out of device allocations or memory: a dedicated allocation of exactly the right size may still fit.
+		if (allocate_dedicated(allocator, requirements, memory_type, dedicated_next, allocation)) return true;
+	}
+}
+
+static void free_locked(vk_allocator_t& allocator, vk_allocation_t& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE || allocation.block == vk_allocation_linear) return;
+
+	if (allocation.block == vk_allocation_dedicated)
+	{
+		free_device_memory(allocator, allocation.memory, allocation.size, allocation.memory_type);
+		allocator.dedicated_count -= 1;
+		allocation = {};
+		return;
+	}
+
+	vk_memory_block_t& block = allocator.blocks[allocation.block];
+	tlsf_free(block.tlsf, allocation.node);
+
+	// give empty blocks back, but keep one around so that a single resource that is created and
+	// destroyed every frame does not allocate device memory every frame.
+	if (block.tlsf.allocation_count == 0 && allocation.block != allocator.defrag_source)
+	{
+		for (uint32_t block_idx = 0; block_idx != allocator.blocks.size(); ++block_idx)
+		{
+			const vk_memory_block_t& other = allocator.blocks[block_idx];
+			if (block_idx != allocation.block && other.memory != VK_NULL_HANDLE && other.memory_type == block.memory_type && other.image == block.image)
+			{
+				destroy_block(allocator, allocation.block);
+				break;
+			}
+		}
+	}
+	allocation = {};
+}
+
+bool vk_allocator_init(vk_allocator_t& allocator, VkPhysicalDevice physical_device, VkDevice device, uint32_t api_version, bool has_memory_budget)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	allocator.physical_device = physical_device;
+	allocator.device = device;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator.memory_properties);
+	allocator.non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+	allocator.max_allocation_count = properties.limits.maxMemoryAllocationCount;
+	allocator.has_dedicated_allocation = api_version >= VK_API_VERSION_1_1 && properties.apiVersion >= VK_API_VERSION_1_1;
+	allocator.has_memory_budget = has_memory_budget && allocator.has_dedicated_allocation;
+	allocator.blocks.clear();
+	allocator.heap_allocated = {};
+	allocator.heap_allocated_at_update = {};
+	allocator.heap_usage_at_update = {};
+	allocator.heap_budget = {};
+	allocator.allocation_count = 0;
+	allocator.dedicated_count = 0;
+	allocator.defrag_source = no_block;
+
+	vk_allocator_update_budget(allocator);
+	fmt::print("[vk] allocator: {} memory types, {} heaps, memory budget {}.\n",
+		allocator.memory_properties.memoryTypeCount,
+		allocator.memory_properties.memoryHeapCount,
+		allocator.has_memory_budget ? "from VK_EXT_memory_budget" : "estimated");
+	return true;
+}
+
+void vk_allocator_destroy(vk_allocator_t& allocator)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	for (uint32_t block_idx = 0; block_idx != allocator.blocks.size(); ++block_idx)
+	{
+		vk_memory_block_t& block = allocator.blocks[block_idx];
+		if (block.memory == VK_NULL_HANDLE) continue;
+		if (block.tlsf.allocation_count != 0) fmt::print("[vk] allocator: block {} still has {} allocations.\n", block_idx, block.tlsf.allocation_count);
+		destroy_block(allocator, block_idx);
+	}
+	if (allocator.dedicated_count != 0) fmt::print("[vk] allocator: {} dedicated allocations were not freed.\n", allocator.dedicated_count);
+	allocator.blocks.clear();
+}
+
+uint32_t vk_allocator_find_memory_type(const vk_allocator_t& allocator, uint32_t type_bits, vk_memory_usage_t usage)
+{
+	VkMemoryPropertyFlags required = 0;
+	VkMemoryPropertyFlags preferred = 0;
+	VkMemoryPropertyFlags avoided = 0;
+	switch (usage)
+	{
+		case vk_memory_usage_t::gpu_only:
+			preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			break;
+		case vk_memory_usage_t::upload:
+			// write combined (uncached) is what we want for memory the cpu only writes.
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+		case vk_memory_usage_t::readback:
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			break;
+		case vk_memory_usage_t::transient:
+			preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			break;
+	}
+	// never hand out protected memory, it can not be used without a protected queue.
+	avoided |= VK_MEMORY_PROPERTY_PROTECTED_BIT;
+
+	uint32_t best_type = UINT32_MAX;
+	int best_score = 0;
+	for (uint32_t idx = 0; idx != allocator.memory_properties.memoryTypeCount; ++idx)
+	{
+		const VkMemoryPropertyFlags flags = allocator.memory_properties.memoryTypes[idx].propertyFlags;
+		if (!(type_bits & (1u << idx)) || (flags & required) != required) continue;
+		if (flags & VK_MEMORY_PROPERTY_PROTECTED_BIT) continue;
+
+		int score = 2 * std::popcount(flags & preferred) - std::popcount(flags & avoided);
+		// a type whose heap is already over its budget is only picked when nothing else will do.
+		if (over_budget(allocator, heap_of(allocator, idx), 0)) score -= 16;
+		if (best_type == UINT32_MAX || score > best_score)
+		{
+			best_type = idx;
+			best_score = score;
+		}
+	}
+	return best_type;
+}
+
+bool vk_allocator_allocate(
+	vk_allocator_t& allocator,
+	const VkMemoryRequirements& requirements,
+	vk_memory_usage_t usage,
+	bool image,
+	bool dedicated,
+	vk_allocation_t& allocation,
+	bool movable,
+	uint64_t user_data)
+{
+	return allocate(allocator, requirements, usage, image, dedicated, nullptr, movable, user_data, allocation);
+}
+
+void vk_allocator_free(vk_allocator_t& allocator, vk_allocation_t& allocation)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	free_locked(allocator, allocation);
+}
+
+bool vk_allocator_create_buffer(vk_allocator_t& allocator, const VkBufferCreateInfo& create_info, vk_memory_usage_t usage, VkBuffer& buffer, vk_allocation_t& allocation, bool movable, uint64_t user_data)
+{
+	allocation = {};
+	if (vkCreateBuffer(allocator.device, &create_info, nullptr, &buffer) != VK_SUCCESS) return false;
+
+	VkMemoryRequirements requirements{};
+	VkMemoryDedicatedAllocateInfo dedicated_info{};
+	bool dedicated = false;
+	if (allocator.has_dedicated_allocation)
+	{
+		VkMemoryDedicatedRequirements dedicated_requirements{};
+		dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements2{};
+		requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements2.pNext = &dedicated_requirements;
+		VkBufferMemoryRequirementsInfo2 requirements_info{};
+		requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		requirements_info.buffer = buffer;
+		vkGetBufferMemoryRequirements2(allocator.device, &requirements_info, &requirements2);
+
+		requirements = requirements2.memoryRequirements;
+		dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+		dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicated_info.buffer = buffer;
+	}
+	else
+	{
+		vkGetBufferMemoryRequirements(allocator.device, buffer, &requirements);
+	}
+
+	if (!allocate(allocator, requirements, usage, false, dedicated, allocator.has_dedicated_allocation ? &dedicated_info : nullptr, movable, user_data, allocation) ||
+		vkBindBufferMemory(allocator.device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		vk_allocator_destroy_buffer(allocator, buffer, allocation);
+		return false;
+	}
+	return true;
+}
+
+bool vk_allocator_create_image(vk_allocator_t& allocator, const VkImageCreateInfo& create_info, vk_memory_usage_t usage, VkImage& image, vk_allocation_t& allocation)
+{
+	allocation = {};
+	if (vkCreateImage(allocator.device, &create_info, nullptr, &image) != VK_SUCCESS) return false;
+
+	VkMemoryRequirements requirements{};
+	VkMemoryDedicatedAllocateInfo dedicated_info{};
+	bool dedicated = false;
+	if (allocator.has_dedicated_allocation)
+	{
+		VkMemoryDedicatedRequirements dedicated_requirements{};
+		dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements2{};
+		requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements2.pNext = &dedicated_requirements;
+		VkImageMemoryRequirementsInfo2 requirements_info{};
+		requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		requirements_info.image = image;
+		vkGetImageMemoryRequirements2(allocator.device, &requirements_info, &requirements2);
+
+		requirements = requirements2.memoryRequirements;
+		dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+		dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicated_info.image = image;
+	}
+	else
+	{
+		vkGetImageMemoryRequirements(allocator.device, image, &requirements);
+	}
+
+	if (!allocate(allocator, requirements, usage, true, dedicated, allocator.has_dedicated_allocation ? &dedicated_info : nullptr, false, 0, allocation) ||
+		vkBindImageMemory(allocator.device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		vk_allocator_destroy_image(allocator, image, allocation);
+		return false;
+	}
+	return true;
+}
+
+void vk_allocator_destroy_buffer(vk_allocator_t& allocator, VkBuffer& buffer, vk_allocation_t& allocation)
+{
+	if (buffer != VK_NULL_HANDLE) vkDestroyBuffer(allocator.device, buffer, nullptr);
+	buffer = VK_NULL_HANDLE;
+	vk_allocator_free(allocator, allocation);
+}
+
+void vk_allocator_destroy_image(vk_allocator_t& allocator, VkImage& image, vk_allocation_t& allocation)
+{
+	if (image != VK_NULL_HANDLE) vkDestroyImage(allocator.device, image, nullptr);
+	image = VK_NULL_HANDLE;
+	vk_allocator_free(allocator, allocation);
+}
+
+static VkMappedMemoryRange mapped_range(const vk_allocator_t& allocator, const vk_allocation_t& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	// the range has to be aligned to nonCoherentAtomSize, and may not run past the memory. Blocks
+	// and linear pools are a multiple of the atom size (at most 256), but a dedicated allocation
+	// is as big as the resource asked for: a range that reaches its end goes to VK_WHOLE_SIZE.
+	const VkDeviceSize atom = allocator.non_coherent_atom_size;
+	const VkDeviceSize begin = allocation.offset + offset;
+	const VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = begin / atom * atom;
+	const bool past_end = allocation.block == vk_allocation_dedicated && align_up(end, atom) > allocation.size;
+	range.size = past_end ? VK_WHOLE_SIZE : align_up(end, atom) - range.offset;
+	return range;
+}
+
+void vk_allocator_flush(const vk_allocator_t& allocator, const vk_allocation_t& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (allocation.mapped == nullptr || is_host_coherent(allocator, allocation.memory_type)) return;
+	VkMappedMemoryRange range = mapped_range(allocator, allocation, offset, size);
+	vkFlushMappedMemoryRanges(allocator.device, 1, &range);
+}
+
+void vk_allocator_invalidate(const vk_allocator_t& allocator, const vk_allocation_t& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (allocation.mapped == nullptr || is_host_coherent(allocator, allocation.memory_type)) return;
+	VkMappedMemoryRange range = mapped_range(allocator, allocation, offset, size);
+	vkInvalidateMappedMemoryRanges(allocator.device, 1, &range);
+}
+
+void vk_allocator_update_budget(vk_allocator_t& allocator)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	const uint32_t heap_count = allocator.memory_properties.memoryHeapCount;
+
+	if (allocator.has_memory_budget)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+		budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memory_properties{};
+		memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memory_properties.pNext = &budget_properties;
+		vkGetPhysicalDeviceMemoryProperties2(allocator.physical_device, &memory_properties);
+
+		for (uint32_t heap = 0; heap != heap_count; ++heap)
+		{
+			allocator.heap_usage_at_update[heap] = budget_properties.heapUsage[heap];
+			allocator.heap_budget[heap] = budget_properties.heapBudget[heap];
+			allocator.heap_allocated_at_update[heap] = allocator.heap_allocated[heap];
+		}
+		return;
+	}
+
+	// without the extension all we know is our own usage. Leave some room for everything else.
+	for (uint32_t heap = 0; heap != heap_count; ++heap)
+	{
+		allocator.heap_usage_at_update[heap] = allocator.heap_allocated[heap];
+		allocator.heap_allocated_at_update[heap] = allocator.heap_allocated[heap];
+		allocator.heap_budget[heap] = allocator.memory_properties.memoryHeaps[heap].size / 10 * 8;
+	}
+}
+
+vk_heap_budget_t vk_allocator_heap_budget(vk_allocator_t& allocator, uint32_t heap)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	return {heap_usage(allocator, heap), allocator.heap_budget[heap], allocator.heap_allocated[heap]};
+}
+
+void vk_allocator_report(vk_allocator_t& allocator)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	fmt::print("[vk] allocator: {} device allocations of {} ({} dedicated)\n", allocator.allocation_count, allocator.max_allocation_count, allocator.dedicated_count);
+
+	for (uint32_t heap = 0; heap != allocator.memory_properties.memoryHeapCount; ++heap)
+	{
+		uint32_t block_count = 0;
+		VkDeviceSize block_bytes = 0;
+		VkDeviceSize used_bytes = 0;
+		for (const auto& block: allocator.blocks)
+		{
+			if (block.memory == VK_NULL_HANDLE || heap_of(allocator, block.memory_type) != heap) continue;
+			block_count += 1;
+			block_bytes += block.tlsf.size;
+			used_bytes += block.tlsf.used;
+		}
+		fmt::print("[vk]   heap {}: {} blocks, {:.1f} of {:.1f} MB used, {:.1f} MB allocated, usage {:.1f} of {:.1f} MB budget\n",
+			heap,
+			block_count,
+			used_bytes / 1e6,
+			block_bytes / 1e6,
+			allocator.heap_allocated[heap] / 1e6,
+			heap_usage(allocator, heap) / 1e6,
+			allocator.heap_budget[heap] / 1e6);
+	}
+}
+
+uint32_t vk_allocator_defrag_begin(vk_allocator_t& allocator, VkDeviceSize max_bytes, std::vector<vk_defrag_move_t>& moves)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	moves.clear();
+
+	// the emptiest block that shares its memory type with another block.
+	uint32_t source_idx = no_block;
+	double source_occupancy = 1.0;
+	for (uint32_t block_idx = 0; block_idx != allocator.blocks.size(); ++block_idx)
+	{
+		const vk_memory_block_t& block = allocator.blocks[block_idx];
+		if (block.memory == VK_NULL_HANDLE || block.tlsf.allocation_count == 0) continue;
+
+		bool has_sibling = false;
+		for (uint32_t other_idx = 0; other_idx != allocator.blocks.size() && !has_sibling; ++other_idx)
+		{
+			const vk_memory_block_t& other = allocator.blocks[other_idx];
+			has_sibling = other_idx != block_idx && other.memory != VK_NULL_HANDLE && other.memory_type == block.memory_type && other.image == block.image;
+		}
+		const double occupancy = static_cast<double>(block.tlsf.used) / static_cast<double>(block.tlsf.size);
+		if (has_sibling && occupancy < source_occupancy)
+		{
+			source_idx = block_idx;
+			source_occupancy = occupancy;
+		}
+	}
+	if (source_idx == no_block) return 0;
+
+	allocator.defrag_source = source_idx;
+	VkDeviceSize moved_bytes = 0;
+	for (uint32_t node_idx = 0; node_idx != allocator.blocks[source_idx].tlsf.nodes.size() && moved_bytes < max_bytes; ++node_idx)
+	{
+		// a copy: allocate_from_blocks may grow the blocks vector.
+		const vk_tlsf_node_t node = allocator.blocks[source_idx].tlsf.nodes[node_idx];
+		// unused nodes have size 0.
+		if (node.free || !node.movable || node.size == 0) continue;
+
+		const vk_memory_block_t& source = allocator.blocks[source_idx];
+		const VkMemoryRequirements requirements{node.size, node.alignment, 1u << source.memory_type};
+		vk_defrag_move_t move{};
+		move.user_data = node.user_data;
+		fill_allocation(allocator, source_idx, node_idx, move.source);
+		// only into space that is already there: creating a block to empty another one gains nothing.
+		if (!allocate_from_blocks(allocator, requirements, source.memory_type, source.image, true, node.user_data, source_idx, move.destination)) break;
+
+		moves.push_back(move);
+		moved_bytes += node.size;
+	}
+
+	if (moves.empty()) allocator.defrag_source = no_block;
+	return static_cast<uint32_t>(moves.size());
+}
+
+void vk_allocator_defrag_end(vk_allocator_t& allocator, std::vector<vk_defrag_move_t>& moves)
+{
+	std::lock_guard<std::mutex> lock(allocator.mutex);
+	allocator.defrag_source = no_block;
+	for (auto& move: moves)
+	{
+		free_locked(allocator, move.source);
+	}
+	moves.clear();
+}
+
+bool vk_linear_pool_init(vk_allocator_t& allocator, vk_linear_pool_t& pool, VkDeviceSize size, uint32_t type_bits, vk_memory_usage_t usage)
+{
+	pool = {};
+	// a multiple of the granularity, so flushes of the last allocation never need to run past the end.
+	const VkMemoryRequirements requirements{align_up(size, vk_allocator_granularity), vk_allocator_granularity, type_bits};
+	if (!vk_allocator_allocate(allocator, requirements, usage, false, true, pool.allocation)) return false;
+	return true;
+}
+
+bool vk_linear_pool_allocate(vk_linear_pool_t& pool, const VkMemoryRequirements& requirements, vk_allocation_t& allocation)
+{
+	assert(requirements.memoryTypeBits & (1u << pool.allocation.memory_type));
+
+	const VkDeviceSize offset = align_up(pool.head, requirements.alignment);
+	if (offset + requirements.size > pool.allocation.size) return false;
+
+	allocation = {};
+	allocation.memory = pool.allocation.memory;
+	allocation.offset = pool.allocation.offset + offset;
+	allocation.size = requirements.size;
+	allocation.mapped = pool.allocation.mapped ? pool.allocation.mapped + offset : nullptr;
+	allocation.memory_type = pool.allocation.memory_type;
+	allocation.block = vk_allocation_linear;
+	allocation.node = 0;
+
+	pool.head = offset + requirements.size;
+	pool.high_water = std::max(pool.high_water, pool.head);
+	return true;
+}
+
+void vk_linear_pool_reset(vk_linear_pool_t& pool)
+{
+	pool.head = 0;
+}
+
+void vk_linear_pool_destroy(vk_allocator_t& allocator, vk_linear_pool_t& pool)
+{
+	vk_allocator_free(allocator, pool.allocation);
+	pool = {};
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+// device memory allocator. vkAllocateMemory is slow, and there are only maxMemoryAllocationCount
+// (4096 on most desktop drivers) allocations, so buffers and images are sub-allocated from large
+// blocks instead:
+//
+// - the memory type is picked by what the memory is used for (vk_memory_usage_t), not by flags.
+// - every memory type has its own list of blocks (buffers and images in separate blocks, so we
+//   never have to care about bufferImageGranularity). Blocks are sub-allocated with TLSF: a two
+//   level segregated fit allocator that finds a free range and merges freed neighbours in O(1).
+// - allocations that are larger than half a block, or that the driver wants to have to
+//   themselves (VkMemoryDedicatedRequirements), get their own VkDeviceMemory.
+// - linear pools are bump allocators for transient data, reset in one go (once per frame).
+// - heap usage and budget come from VK_EXT_memory_budget when it is there. New blocks are made
+//   smaller when a heap gets close to its budget.
+// - the defragmenter moves allocations out of the emptiest block a few at a time, so that block
+//   can be freed. The caller does the copies, since only it knows what lives in the memory.
+//
+// everything but the linear pools is thread safe.
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+enum class vk_memory_usage_t
+{
+	// only ever touched by the gpu.
+	gpu_only,
+	// written by the cpu, read by the gpu: staging buffers, uniforms.
+	upload,
+	// written by the gpu, read by the cpu.
+	readback,
+	// attachments that never leave the gpu (lazily allocated memory on tilers).
+	transient
+};
+
+const VkDeviceSize vk_allocator_min_block_size = 4ull << 20;
+const VkDeviceSize vk_allocator_max_block_size = 256ull << 20;
+// every sub-allocation is a multiple of this.
+const VkDeviceSize vk_allocator_granularity = 256;
+
+const uint32_t vk_allocation_dedicated = UINT32_MAX;
+const uint32_t vk_allocation_linear = UINT32_MAX - 1;
+
+struct vk_allocation_t
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	// nullptr unless the memory is host visible. Points at offset already.
+	uint8_t* mapped;
+	uint32_t memory_type;
+	// vk_allocation_dedicated, vk_allocation_linear or the block the allocation was made from.
+	uint32_t block;
+	uint32_t node;
+};
+
+// TLSF bookkeeping for one block. The nodes live on the cpu, never in the device memory itself.
+const uint32_t vk_tlsf_sl_bits = 4;
+const uint32_t vk_tlsf_sl_count = 1u << vk_tlsf_sl_bits;
+const uint32_t vk_tlsf_fl_count = 48;
+
+struct vk_tlsf_node_t
+{
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	VkDeviceSize alignment;
+	uint32_t prev_physical;
+	uint32_t next_physical;
+	uint32_t prev_free;
+	uint32_t next_free;
+	// given to vk_allocator_allocate, handed back by the defragmenter.
+	uint64_t user_data;
+	bool free;
+	bool movable;
+};
+
+struct vk_tlsf_t
+{
+	VkDeviceSize size;
+	VkDeviceSize used;
+	uint32_t allocation_count;
+	uint64_t fl_bitmap;
+	std::array<uint32_t, vk_tlsf_fl_count> sl_bitmap;
+	std::array<uint32_t, vk_tlsf_fl_count * vk_tlsf_sl_count> free_heads;
+	std::vector<vk_tlsf_node_t> nodes;
+	std::vector<uint32_t> unused_nodes;
+};
+
+struct vk_memory_block_t
+{
+	// VK_NULL_HANDLE if the slot is unused.
+	VkDeviceMemory memory;
+	uint8_t* mapped;
+	uint32_t memory_type;
+	bool image;
+	vk_tlsf_t tlsf;
+};
+
+struct vk_allocator_t
+{
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkDeviceSize non_coherent_atom_size;
+	uint32_t max_allocation_count;
+	// vulkan 1.1 (or VK_KHR_dedicated_allocation): ask the driver whether it wants dedicated allocations.
+	bool has_dedicated_allocation;
+	bool has_memory_budget;
+
+	std::mutex mutex;
+	std::vector<vk_memory_block_t> blocks;
+	// per heap: what we allocated, and what VK_EXT_memory_budget said at the last update.
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_allocated;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_allocated_at_update;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_usage_at_update;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_budget;
+	uint32_t allocation_count;
+	uint32_t dedicated_count;
+	// the defragmenter does not move anything into this block.
+	uint32_t defrag_source;
+};
+
+struct vk_heap_budget_t
+{
+	// everything this process (and with VK_EXT_memory_budget, the rest of the system) uses.
+	VkDeviceSize usage;
+	VkDeviceSize budget;
+	VkDeviceSize allocated;
+};
+
+// api_version is the version the instance was created with (dedicated allocations need 1.1).
+bool vk_allocator_init(vk_allocator_t& allocator, VkPhysicalDevice physical_device, VkDevice device, uint32_t api_version, bool has_memory_budget);
+void vk_allocator_destroy(vk_allocator_t& allocator);
+
+// UINT32_MAX if none of the types in type_bits will do.
+uint32_t vk_allocator_find_memory_type(const vk_allocator_t& allocator, uint32_t type_bits, vk_memory_usage_t usage);
+
+// movable allocations may be moved by the defragmenter; user_data is how the caller recognizes
+// them in the moves it gets back.
+bool vk_allocator_allocate(
+	vk_allocator_t& allocator,
+	const VkMemoryRequirements& requirements,
+	vk_memory_usage_t usage,
+	bool image,
+	bool dedicated,
+	vk_allocation_t& allocation,
+	bool movable = false,
+	uint64_t user_data = 0);
+void vk_allocator_free(vk_allocator_t& allocator, vk_allocation_t& allocation);
+
+bool vk_allocator_create_buffer(vk_allocator_t& allocator, const VkBufferCreateInfo& create_info, vk_memory_usage_t usage, VkBuffer& buffer, vk_allocation_t& allocation, bool movable = false, uint64_t user_data = 0);
+bool vk_allocator_create_image(vk_allocator_t& allocator, const VkImageCreateInfo& create_info, vk_memory_usage_t usage, VkImage& image, vk_allocation_t& allocation);
+void vk_allocator_destroy_buffer(vk_allocator_t& allocator, VkBuffer& buffer, vk_allocation_t& allocation);
+void vk_allocator_destroy_image(vk_allocator_t& allocator, VkImage& image, vk_allocation_t& allocation);
+
+// only do something for memory that is not host coherent.
+void vk_allocator_flush(const vk_allocator_t& allocator, const vk_allocation_t& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+void vk_allocator_invalidate(const vk_allocator_t& allocator, const vk_allocation_t& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+// queries VK_EXT_memory_budget. Once per frame is plenty.
+void vk_allocator_update_budget(vk_allocator_t& allocator);
+vk_heap_budget_t vk_allocator_heap_budget(vk_allocator_t& allocator, uint32_t heap);
+void vk_allocator_report(vk_allocator_t& allocator);
+
+// incremental defragmentation. begin picks the emptiest block of a memory type that has more
+// than one, and plans to move up to max_bytes of its movable allocations into the other blocks.
+// The caller copies every move.source to move.destination (on the gpu), points its resources at
+// move.destination, and once the copies are done calls end, which frees the sources (and the
+// source block when it is empty). Call it again next frame to continue.
+struct vk_defrag_move_t
+{
+	uint64_t user_data;
+	vk_allocation_t source;
+	vk_allocation_t destination;
+};
+uint32_t vk_allocator_defrag_begin(vk_allocator_t& allocator, VkDeviceSize max_bytes, std::vector<vk_defrag_move_t>& moves);
+void vk_allocator_defrag_end(vk_allocator_t& allocator, std::vector<vk_defrag_move_t>& moves);
+
+// bump allocator over one dedicated allocation, for transient data. Everything allocated from it
+// is released by vk_linear_pool_reset. Not thread safe: one pool per thread (and per frame).
+struct vk_linear_pool_t
+{
+	vk_allocation_t allocation;
+	VkDeviceSize head;
+	VkDeviceSize high_water;
+};
+
+bool vk_linear_pool_init(vk_allocator_t& allocator, vk_linear_pool_t& pool, VkDeviceSize size, uint32_t type_bits, vk_memory_usage_t usage);
+// the memory requirements have to allow pool.allocation.memory_type.
+bool vk_linear_pool_allocate(vk_linear_pool_t& pool, const VkMemoryRequirements& requirements, vk_allocation_t& allocation);
+void vk_linear_pool_reset(vk_linear_pool_t& pool);
+void vk_linear_pool_destroy(vk_allocator_t& allocator, vk_linear_pool_t& pool);
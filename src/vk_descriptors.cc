@@ -0,0 +1,128 @@
+#include "vk_descriptors.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm>
+
+static uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+	// fnv-1a, a word at a time.
+	hash ^= value;
+	return hash * 0x100000001b3ull;
+}
+
+static uint64_t hash_layout(const vk_descriptor_layout_entry_t& entry)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hash_combine(hash, entry.flags);
+	for (size_t idx = 0; idx != entry.bindings.size(); ++idx)
+	{
+		const VkDescriptorSetLayoutBinding& binding = entry.bindings[idx];
+		hash = hash_combine(hash, binding.binding);
+		hash = hash_combine(hash, binding.descriptorType);
+		hash = hash_combine(hash, binding.descriptorCount);
+		hash = hash_combine(hash, binding.stageFlags);
+		hash = hash_combine(hash, entry.binding_flags[idx]);
+	}
+	return hash;
+}
+
+static bool same_layout(const vk_descriptor_layout_entry_t& lhs, const vk_descriptor_layout_entry_t& rhs)
+{
+	if (lhs.flags != rhs.flags || lhs.bindings.size() != rhs.bindings.size()) return false;
+	for (size_t idx = 0; idx != lhs.bindings.size(); ++idx)
+	{
+		const VkDescriptorSetLayoutBinding& a = lhs.bindings[idx];
+		const VkDescriptorSetLayoutBinding& b = rhs.bindings[idx];
+		if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags) return false;
+		if (lhs.binding_flags[idx] != rhs.binding_flags[idx]) return false;
+	}
+	return true;
+}
+
+void vk_descriptor_layout_cache_init(vk_descriptor_layout_cache_t& cache, VkDevice device)
+{
+	cache.device = device;
+	cache.layouts.clear();
+	cache.hit_count = 0;
+	cache.miss_count = 0;
+}
+
+void vk_descriptor_layout_cache_destroy(vk_descriptor_layout_cache_t& cache)
+{
+	size_t layout_count = 0;
+	for (auto& [hash, entries]: cache.layouts)
+	{
+		for (auto& entry: entries) vkDestroyDescriptorSetLayout(cache.device, entry.layout, nullptr);
+		layout_count += entries.size();
+	}
+	if (layout_count != 0)
+	{
+		fmt::print("[vk] descriptor layout cache: {} layouts, {} lookups hit.\n", layout_count, cache.hit_count);
+	}
+	cache.layouts.clear();
+}
+
+VkDescriptorSetLayout vk_descriptor_layout_get(
+	vk_descriptor_layout_cache_t& cache,
+	const VkDescriptorSetLayoutBinding* bindings,
+	uint32_t binding_count,
+	VkDescriptorSetLayoutCreateFlags flags,
+	const VkDescriptorBindingFlags* binding_flags)
+{
+	vk_descriptor_layout_entry_t entry{};
+	entry.flags = flags;
+	entry.bindings.assign(bindings, bindings + binding_count);
+	entry.binding_flags.resize(binding_count, 0);
+	if (binding_flags != nullptr) entry.binding_flags.assign(binding_flags, binding_flags + binding_count);
+
+	// sort the bindings (and their flags along with them).
+	std::vector<uint32_t> order(binding_count);
+	for (uint32_t idx = 0; idx != binding_count; ++idx) order[idx] = idx;
+	std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return entry.bindings[lhs].binding < entry.bindings[rhs].binding; });
+	vk_descriptor_layout_entry_t sorted{};
+	sorted.flags = flags;
+	for (uint32_t idx: order)
+	{
+		sorted.bindings.push_back(entry.bindings[idx]);
+		sorted.binding_flags.push_back(entry.binding_flags[idx]);
+	}
+	for (auto& binding: sorted.bindings)
+	{
+		if (binding.pImmutableSamplers != nullptr) fmt::print("[vk] the descriptor layout cache ignores immutable samplers.\n");
+		binding.pImmutableSamplers = nullptr;
+	}
+
+	const uint64_t hash = hash_layout(sorted);
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	auto& entries = cache.layouts[hash];
+	for (const auto& existing: entries)
+	{
+		if (same_layout(existing, sorted))
+		{
+			cache.hit_count += 1;
+			return existing.layout;
+		}
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info{};
+	binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	binding_flags_create_info.bindingCount = binding_count;
+	binding_flags_create_info.pBindingFlags = sorted.binding_flags.data();
+
+	VkDescriptorSetLayoutCreateInfo set_layout_create_info{};
+	set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_create_info.pNext = binding_flags != nullptr ? &binding_flags_create_info : nullptr;
+	set_layout_create_info.flags = flags;
+	set_layout_create_info.bindingCount = binding_count;
+	set_layout_create_info.pBindings = sorted.bindings.data();
+	if (vkCreateDescriptorSetLayout(cache.device, &set_layout_create_info, nullptr, &sorted.layout) != VK_SUCCESS)
+	{
+		fmt::print("[vk] failed to create a descriptor set layout with {} bindings.\n", binding_count);
+		return VK_NULL_HANDLE;
+	}
+	cache.miss_count += 1;
+	entries.push_back(std::move(sorted));
+	return entries.back().layout;
+}
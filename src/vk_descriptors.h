@@ -0,0 +1,43 @@
+#pragma once
+
+// the descriptor set layout cache: every VkDescriptorSetLayout is made once, keyed by a hash of
+// its bindings (and flags), and shared by everyone who asks for the same bindings. Layouts live as
+// long as the cache.
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct vk_descriptor_layout_entry_t
+{
+	// sorted by binding, so the order they were given in does not matter.
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+	std::vector<VkDescriptorBindingFlags> binding_flags;
+	VkDescriptorSetLayoutCreateFlags flags;
+	VkDescriptorSetLayout layout;
+};
+
+// thread safe.
+struct vk_descriptor_layout_cache_t
+{
+	VkDevice device;
+	std::mutex mutex;
+	std::unordered_map<uint64_t, std::vector<vk_descriptor_layout_entry_t>> layouts;
+	uint64_t hit_count;
+	uint64_t miss_count;
+};
+
+void vk_descriptor_layout_cache_init(vk_descriptor_layout_cache_t& cache, VkDevice device);
+void vk_descriptor_layout_cache_destroy(vk_descriptor_layout_cache_t& cache);
+
+// the layout for these bindings: made on the first call, looked up after that. binding_flags is
+// either null or one per binding. VK_NULL_HANDLE on failure. Immutable samplers are not supported.
+VkDescriptorSetLayout vk_descriptor_layout_get(
+	vk_descriptor_layout_cache_t& cache,
+	const VkDescriptorSetLayoutBinding* bindings,
+	uint32_t binding_count,
+	VkDescriptorSetLayoutCreateFlags flags = 0,
+	const VkDescriptorBindingFlags* binding_flags = nullptr);
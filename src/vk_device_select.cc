@@ -0,0 +1,204 @@
+#include "vk_device_select.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <cctype>
+#include <cstring>
+#include <string>
+
+// device type dominates everything else: even a lot of memory does not turn an integrated gpu
+// into a discrete one.
+static int64_t device_type_score(VkPhysicalDeviceType type)
+{
+	switch (type)
+	{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 100000;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 50000;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 20000;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1000;
+		default: return 0;
+	}
+}
+
+static const char* device_type_name(VkPhysicalDeviceType type)
+{
+	switch (type)
+	{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+		default: return "other";
+	}
+}
+
+static std::string uuid_string(const uint8_t (&uuid)[VK_UUID_SIZE])
+{
+	std::string result;
+	for (uint32_t idx = 0; idx != VK_UUID_SIZE; ++idx)
+	{
+		if (idx == 4 || idx == 6 || idx == 8 || idx == 10) result += '-';
+		result += fmt::format("{:02x}", static_cast<unsigned>(uuid[idx]));
+	}
+	return result;
+}
+
+// the uuid with or without dashes, or a substring of the name. Case does not matter for either.
+static bool matches_override(const vk_device_candidate_t& candidate, const char* device_override)
+{
+	auto lower = [](std::string text)
+	{
+		std::string result;
+		for (char c: text)
+		{
+			if (c != '-') result += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+		}
+		return result;
+	};
+	const std::string wanted = lower(device_override);
+	if (wanted.empty()) return false;
+	if (wanted == lower(uuid_string(candidate.uuid))) return true;
+	return lower(candidate.properties.deviceName).find(wanted) != std::string::npos;
+}
+
+static void evaluate(vk_device_candidate_t& candidate, VkSurfaceKHR surface, const std::vector<const char*>& required_extensions)
+{
+	VkPhysicalDevice device = candidate.physical_device;
+	vkGetPhysicalDeviceProperties(device, &candidate.properties);
+
+	// uuid and subgroup size are vulkan 1.1 properties.
+	if (candidate.properties.apiVersion >= VK_API_VERSION_1_1)
+	{
+		VkPhysicalDeviceSubgroupProperties subgroup_properties{};
+		subgroup_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+		VkPhysicalDeviceIDProperties id_properties{};
+		id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+		id_properties.pNext = &subgroup_properties;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &id_properties;
+		vkGetPhysicalDeviceProperties2(device, &properties2);
+		memcpy(candidate.uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+		candidate.subgroup_size = subgroup_properties.subgroupSize;
+	}
+
+	VkPhysicalDeviceMemoryProperties memory_properties{};
+	vkGetPhysicalDeviceMemoryProperties(device, &memory_properties);
+	for (uint32_t idx = 0; idx != memory_properties.memoryHeapCount; ++idx)
+	{
+		const VkMemoryHeap& heap = memory_properties.memoryHeaps[idx];
+		if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > candidate.device_local_bytes) candidate.device_local_bytes = heap.size;
+	}
+
+	// the same queue family rules as the device setup in main.cc.
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families.data());
+	bool has_graphics = false;
+	bool can_present = surface == VK_NULL_HANDLE;
+	for (uint32_t idx = 0; idx != queue_family_count; ++idx)
+	{
+		const VkQueueFlags flags = queue_families[idx].queueFlags;
+		VkBool32 present_support = false;
+		if (surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(device, idx, surface, &present_support);
+
+		if (flags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			has_graphics = true;
+			if (present_support) candidate.graphics_can_present = true;
+		}
+		if (present_support) can_present = true;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) candidate.has_async_compute = true;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) candidate.has_transfer_queue = true;
+	}
+
+	uint32_t extension_count{};
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> available_extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+	auto has_extension = [&available_extensions](const char* name)
+	{
+		for (const auto& extension: available_extensions)
+		{
+			if (strcmp(extension.extensionName, name) == 0) return true;
+		}
+		return false;
+	};
+	bool has_required_extensions = true;
+	for (const char* name: required_extensions) has_required_extensions = has_required_extensions && has_extension(name);
+	candidate.has_memory_budget = has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	// timeline semaphores are core in 1.2, but the driver still has to expose them.
+	VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features{};
+	timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	VkPhysicalDeviceFeatures2 device_features2{};
+	device_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	device_features2.pNext = &timeline_features;
+	if (candidate.properties.apiVersion >= VK_API_VERSION_1_2) vkGetPhysicalDeviceFeatures2(device, &device_features2);
+
+	if (!has_required_extensions) candidate.unsuitable_reason = "missing required extensions";
+	else if (timeline_features.timelineSemaphore != VK_TRUE) candidate.unsuitable_reason = "no timeline semaphores";
+	else if (!has_graphics) candidate.unsuitable_reason = "no graphics queue";
+	else if (!can_present) candidate.unsuitable_reason = "cannot present to the window";
+
+	int64_t score = device_type_score(candidate.properties.deviceType);
+	// a point per 64 MiB: 16 GiB is worth 256.
+	score += static_cast<int64_t>(candidate.device_local_bytes >> 26);
+	if (candidate.has_async_compute) score += 500;
+	if (candidate.has_transfer_queue) score += 250;
+	if (candidate.graphics_can_present) score += 100;
+	if (candidate.has_memory_budget) score += 50;
+	// wider subgroups do more per instruction in the particle shader.
+	score += candidate.subgroup_size;
+	candidate.score = score;
+}
+
+VkPhysicalDevice vk_device_select(
+	VkInstance instance,
+	VkSurfaceKHR surface,
+	const std::vector<const char*>& required_extensions,
+	const char* device_override)
+{
+	uint32_t device_count = 0;
+	vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+	std::vector<VkPhysicalDevice> devices(device_count);
+	vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+	std::vector<vk_device_candidate_t> candidates(device_count);
+	const vk_device_candidate_t* best = nullptr;
+	const vk_device_candidate_t* overridden = nullptr;
+	for (uint32_t idx = 0; idx != device_count; ++idx)
+	{
+		vk_device_candidate_t& candidate = candidates[idx];
+		candidate.physical_device = devices[idx];
+		evaluate(candidate, surface, required_extensions);
+
+		fmt::print("[vk] device {}: {} ({}, {} MiB, {}{}subgroup {}, uuid {}): ",
+			idx, candidate.properties.deviceName, device_type_name(candidate.properties.deviceType),
+			candidate.device_local_bytes >> 20,
+			candidate.has_async_compute ? "async compute, " : "",
+			candidate.has_transfer_queue ? "transfer queue, " : "",
+			candidate.subgroup_size, uuid_string(candidate.uuid));
+		if (candidate.unsuitable_reason != nullptr)
+		{
+			fmt::print("unsuitable, {}.\n", candidate.unsuitable_reason);
+			continue;
+		}
+		fmt::print("score {}.\n", candidate.score);
+
+		if (best == nullptr || candidate.score > best->score) best = &candidate;
+		if (device_override != nullptr && overridden == nullptr && matches_override(candidate, device_override)) overridden = &candidate;
+	}
+
+	if (device_override != nullptr && overridden == nullptr)
+	{
+		fmt::print("[vk] no suitable device matches \"{}\", picking by score.\n", device_override);
+	}
+	const vk_device_candidate_t* picked = overridden != nullptr ? overridden : best;
+	if (picked == nullptr) return VK_NULL_HANDLE;
+
+	fmt::print("[vk] picked {}{}.\n", picked->properties.deviceName, overridden != nullptr ? " (override)" : "");
+	return picked->physical_device;
+}
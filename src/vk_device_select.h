@@ -0,0 +1,46 @@
+#pragma once
+
+// picks the physical device. Every device that can run us at all (required extensions, timeline
+// semaphores, a graphics queue, and present support when there is a surface) gets a score, and
+// the highest one wins:
+//
+// - device type first: discrete > integrated > virtual > cpu. A cpu device (lavapipe,
+//   swiftshader) only wins when it is all there is, which on a headless test box it is.
+// - then how much device local memory it has,
+// - queue topology: an async compute family and a transfer only family (vk_particles,
+//   vk_transfer use them),
+// - whether the graphics family can present (no separate present queue), subgroup size and
+//   optional extensions, as tie breakers.
+//
+// an override (--device) picks a device by name (a case insensitive substring) or by the
+// deviceUUID printed in the list, as long as that device is suitable.
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+struct vk_device_candidate_t
+{
+	VkPhysicalDevice physical_device;
+	VkPhysicalDeviceProperties properties;
+	uint8_t uuid[VK_UUID_SIZE];
+	// the largest device local heap.
+	VkDeviceSize device_local_bytes;
+	uint32_t subgroup_size;
+	bool has_async_compute;
+	bool has_transfer_queue;
+	bool graphics_can_present;
+	bool has_memory_budget;
+
+	// nullptr when suitable.
+	const char* unsuitable_reason;
+	int64_t score;
+};
+
+// surface is VK_NULL_HANDLE when headless. Returns VK_NULL_HANDLE when no device is suitable.
+VkPhysicalDevice vk_device_select(
+	VkInstance instance,
+	VkSurfaceKHR surface,
+	const std::vector<const char*>& required_extensions,
+	const char* device_override);
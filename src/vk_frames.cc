@@ -0,0 +1,114 @@
+#include "vk_frames.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <chrono>
+
+static double now_seconds()
+{
+	using clock = std::chrono::steady_clock;
+	return std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+}
+
+bool vk_frames_init(vk_frames_t& frames, vk_scheduler_t& scheduler, uint32_t frame_count)
+{
+	frames = {};
+	frames.scheduler = &scheduler;
+	VkDevice device = scheduler.device;
+	if (frame_count == 0 || frame_count > vk_max_frames_in_flight)
+	{
+		fmt::print("[vk] {} frames in flight is not supported (1 to {}).\n", frame_count, vk_max_frames_in_flight);
+		return false;
+	}
+
+	frames.frames.resize(frame_count);
+	for (uint32_t slot = 0; slot != frame_count; ++slot)
+	{
+		vk_frame_t& frame = frames.frames[slot];
+		frame.slot = slot;
+		frame.submitted = {vk_queue_kind_t::graphics, 0};
+
+		// transient: everything recorded from it is thrown away after one frame.
+		VkCommandPoolCreateInfo command_pool_create_info{};
+		command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		command_pool_create_info.queueFamilyIndex = vk_scheduler_family(scheduler, vk_queue_kind_t::graphics);
+		if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &frame.command_pool) != VK_SUCCESS) return false;
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+		command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		command_buffer_allocate_info.commandPool = frame.command_pool;
+		command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		command_buffer_allocate_info.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &frame.command_buffer) != VK_SUCCESS) return false;
+
+		VkSemaphoreCreateInfo semaphore_create_info{};
+		semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &frame.image_acquired) != VK_SUCCESS) return false;
+	}
+
+	fmt::print("[vk] {} frames in flight.\n", frame_count);
+	return true;
+}
+
+vk_frame_t& vk_frames_begin(vk_frames_t& frames)
+{
+	vk_scheduler_t& scheduler = *frames.scheduler;
+	vk_frame_t& frame = frames.frames[frames.frame_index % frames.frames.size()];
+
+	if (!vk_scheduler_is_complete(scheduler, frame.submitted))
+	{
+		const double wait_start = now_seconds();
+		vk_scheduler_wait(scheduler, frame.submitted);
+		frames.wait_count += 1;
+		frames.wait_time += now_seconds() - wait_start;
+	}
+
+	// a frame that is begun but never submitted (the swapchain was out of date) keeps the point of
+	// the submit before it, which is reached already.
+	vkResetCommandPool(scheduler.device, frame.command_pool, 0);
+	frame.frame_index = frames.frame_index;
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(frame.command_buffer, &begin_info);
+	return frame;
+}
+
+bool vk_frames_submit(vk_frames_t& frames, vk_frame_t& frame, vk_submit_t& submit)
+{
+	vkEndCommandBuffer(frame.command_buffer);
+	vk_submit_add_command_buffer(submit, frame.command_buffer);
+
+	vk_timeline_point_t point = vk_scheduler_submit(*frames.scheduler, vk_queue_kind_t::graphics, submit);
+	frames.frame_index += 1;
+	if (point.value == 0)
+	{
+		fmt::print("[vk] failed to submit frame {}.\n", frame.frame_index);
+		return false;
+	}
+	frame.submitted = point;
+	return true;
+}
+
+void vk_frames_wait_idle(vk_frames_t& frames)
+{
+	for (const auto& frame: frames.frames)
+	{
+		vk_scheduler_wait(*frames.scheduler, frame.submitted);
+	}
+}
+
+void vk_frames_destroy(vk_frames_t& frames)
+{
+	VkDevice device = frames.scheduler->device;
+	for (auto& frame: frames.frames)
+	{
+		if (frame.image_acquired) vkDestroySemaphore(device, frame.image_acquired, nullptr);
+		// frees the command buffer as well.
+		if (frame.command_pool) vkDestroyCommandPool(device, frame.command_pool, nullptr);
+	}
+	frames = {};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// the frames in flight. Every frame slot has its own command pool, command buffer and image
+// acquired semaphore, all created once and recycled: beginning a frame resets the slot's
+// command pool in one go instead of freeing and allocating command buffers.
+//
+// the cpu only waits for the gpu in vk_frames_begin, and only when the frame that used the slot
+// before is still running, which means all frame_count frames are in flight. A frame is done when
+// the graphics timeline (vk_scheduler_t) reaches the point its submit signaled; there are no fences.
+
+#include <vulkan/vulkan.h>
+
+#include "vk_scheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+const uint32_t vk_default_frames_in_flight = 2;
+const uint32_t vk_max_frames_in_flight = 8;
+
+struct vk_frame_t
+{
+	uint32_t slot;
+	// the frame that is (or was last) recorded in this slot.
+	uint64_t frame_index;
+
+	VkCommandPool command_pool;
+	VkCommandBuffer command_buffer;
+	// reached when the last submit from this slot is done.
+	vk_timeline_point_t submitted;
+	VkSemaphore image_acquired;
+};
+
+struct vk_frames_t
+{
+	vk_scheduler_t* scheduler;
+	std::vector<vk_frame_t> frames;
+	uint64_t frame_index;
+
+	// how often, and for how long, vk_frames_begin had to wait for the gpu.
+	uint64_t wait_count;
+	double wait_time;
+};
+
+// frames are recorded for, and submitted to, the scheduler's graphics queue.
+bool vk_frames_init(vk_frames_t& frames, vk_scheduler_t& scheduler, uint32_t frame_count);
+
+// waits until the slot is free, resets its command pool and begins its command buffer.
+vk_frame_t& vk_frames_begin(vk_frames_t& frames);
+
+// ends the command buffer and submits it after whatever is in submit already (waits, signals, and
+// command buffers that go before the frame's own). Moves on to the next slot.
+bool vk_frames_submit(vk_frames_t& frames, vk_frame_t& frame, vk_submit_t& submit);
+
+// waits for every frame in flight.
+void vk_frames_wait_idle(vk_frames_t& frames);
+void vk_frames_destroy(vk_frames_t& frames);
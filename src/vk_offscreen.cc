@@ -0,0 +1,228 @@
+#include "vk_offscreen.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm> // std::sort
+#include <cstdio>
+#include <cstring> // memcpy
+
+const uint64_t no_frame = UINT64_MAX;
+
+static bool create_render_pass(vk_offscreen_t& offscreen, VkDevice device)
+{
+	VkAttachmentDescription color_attachment{};
+	color_attachment.format = vk_offscreen_format;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	// the render graph moves the target in and out of this layout, and waits for the frame before.
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference color_reference{};
+	color_reference.attachment = 0;
+	color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_reference;
+
+	VkRenderPassCreateInfo render_pass_create_info{};
+	render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_create_info.attachmentCount = 1;
+	render_pass_create_info.pAttachments = &color_attachment;
+	render_pass_create_info.subpassCount = 1;
+	render_pass_create_info.pSubpasses = &subpass;
+
+	return vkCreateRenderPass(device, &render_pass_create_info, nullptr, &offscreen.render_pass) == VK_SUCCESS;
+}
+
+static bool create_target(vk_offscreen_t& offscreen, vk_offscreen_target_t& target)
+{
+	vk_allocator_t& allocator = *offscreen.allocator;
+	VkDevice device = allocator.device;
+
+	VkImageCreateInfo image_create_info{};
+	image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_create_info.imageType = VK_IMAGE_TYPE_2D;
+	image_create_info.format = vk_offscreen_format;
+	image_create_info.extent = {offscreen.extent.width, offscreen.extent.height, 1};
+	image_create_info.mipLevels = 1;
+	image_create_info.arrayLayers = 1;
+	image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (!vk_allocator_create_image(allocator, image_create_info, vk_memory_usage_t::gpu_only, target.image, target.image_allocation)) return false;
+
+	VkImageViewCreateInfo view_create_info{};
+	view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_create_info.image = target.image;
+	view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_create_info.format = vk_offscreen_format;
+	view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	if (vkCreateImageView(device, &view_create_info, nullptr, &target.view) != VK_SUCCESS) return false;
+
+	VkFramebufferCreateInfo framebuffer_create_info{};
+	framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebuffer_create_info.renderPass = offscreen.render_pass;
+	framebuffer_create_info.attachmentCount = 1;
+	framebuffer_create_info.pAttachments = &target.view;
+	framebuffer_create_info.width = offscreen.extent.width;
+	framebuffer_create_info.height = offscreen.extent.height;
+	framebuffer_create_info.layers = 1;
+	if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &target.framebuffer) != VK_SUCCESS) return false;
+
+	if (offscreen.readback)
+	{
+		VkBufferCreateInfo buffer_create_info{};
+		buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size = VkDeviceSize{offscreen.extent.width} * offscreen.extent.height * vk_offscreen_bytes_per_pixel;
+		buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (!vk_allocator_create_buffer(allocator, buffer_create_info, vk_memory_usage_t::readback, target.readback_buffer, target.readback_allocation)) return false;
+	}
+
+	target.frame_index = no_frame;
+	return true;
+}
+
+// the gpu has to be done with the target.
+static void collect_readback(vk_offscreen_t& offscreen, vk_offscreen_target_t& target)
+{
+	if (!offscreen.readback || target.frame_index == no_frame) return;
+
+	const size_t size = offscreen.last_readback.size();
+	vk_allocator_invalidate(*offscreen.allocator, target.readback_allocation, 0, size);
+	memcpy(offscreen.last_readback.data(), target.readback_allocation.mapped, size);
+	offscreen.last_readback_frame = target.frame_index;
+	offscreen.readback_bytes += size;
+	target.frame_index = no_frame;
+}
+
+bool vk_offscreen_init(
+	vk_offscreen_t& offscreen,
+	vk_allocator_t& allocator,
+	VkExtent2D extent,
+	uint32_t target_count,
+	bool readback)
+{
+	VkDevice device = allocator.device;
+	offscreen = {};
+	offscreen.allocator = &allocator;
+	offscreen.extent = extent;
+	offscreen.readback = readback;
+	offscreen.last_readback_frame = no_frame;
+	if (readback) offscreen.last_readback.resize(size_t{extent.width} * extent.height * vk_offscreen_bytes_per_pixel);
+
+	if (!create_render_pass(offscreen, device))
+	{
+		fmt::print("[vk] failed to create the offscreen render pass.\n");
+		return false;
+	}
+
+	offscreen.targets.resize(target_count);
+	for (auto& target: offscreen.targets)
+	{
+		if (!create_target(offscreen, target))
+		{
+			fmt::print("[vk] failed to create a {}x{} offscreen target.\n", extent.width, extent.height);
+			return false;
+		}
+	}
+
+	fmt::print("[vk] created {} offscreen targets of {}x{}{}.\n", target_count, extent.width, extent.height, readback ? " with readback" : "");
+	return true;
+}
+
+void vk_offscreen_begin_frame(vk_offscreen_t& offscreen, VkCommandBuffer command_buffer, uint32_t target_index, uint64_t frame_index, const VkClearColorValue& clear_color, VkSubpassContents contents)
+{
+	vk_offscreen_target_t& target = offscreen.targets[target_index];
+	collect_readback(offscreen, target);
+	target.frame_index = frame_index;
+
+	VkClearValue clear_value{};
+	clear_value.color = clear_color;
+
+	VkRenderPassBeginInfo render_pass_begin_info{};
+	render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_begin_info.renderPass = offscreen.render_pass;
+	render_pass_begin_info.framebuffer = target.framebuffer;
+	render_pass_begin_info.renderArea = {{0, 0}, offscreen.extent};
+	render_pass_begin_info.clearValueCount = 1;
+	render_pass_begin_info.pClearValues = &clear_value;
+	vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, contents);
+}
+
+void vk_offscreen_end_frame(vk_offscreen_t&, VkCommandBuffer command_buffer, uint32_t)
+{
+	vkCmdEndRenderPass(command_buffer);
+}
+
+void vk_offscreen_copy_readback(vk_offscreen_t& offscreen, VkCommandBuffer command_buffer, uint32_t target_index)
+{
+	vk_offscreen_target_t& target = offscreen.targets[target_index];
+	VkBufferImageCopy region{};
+	region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+	region.imageExtent = {offscreen.extent.width, offscreen.extent.height, 1};
+	vkCmdCopyImageToBuffer(command_buffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.readback_buffer, 1, &region);
+}
+
+void vk_offscreen_finish(vk_offscreen_t& offscreen)
+{
+	// oldest first, so last_readback ends up holding the last frame.
+	std::vector<vk_offscreen_target_t*> pending;
+	for (auto& target: offscreen.targets)
+	{
+		if (target.frame_index != no_frame) pending.push_back(&target);
+	}
+	std::sort(pending.begin(), pending.end(), [](const vk_offscreen_target_t* lhs, const vk_offscreen_target_t* rhs) { return lhs->frame_index < rhs->frame_index; });
+	for (auto target: pending) collect_readback(offscreen, *target);
+}
+
+bool vk_offscreen_write_ppm(const vk_offscreen_t& offscreen, const char* path)
+{
+	if (offscreen.last_readback_frame == no_frame) return false;
+
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) return false;
+
+	const uint32_t width = offscreen.extent.width;
+	const uint32_t height = offscreen.extent.height;
+	fmt::print(file, "P6\n{} {}\n255\n", width, height);
+
+	// rgba -> rgb, one row at a time.
+	std::vector<uint8_t> row(size_t{width} * 3);
+	bool ok = true;
+	for (uint32_t y = 0; y != height && ok; ++y)
+	{
+		const uint8_t* src = offscreen.last_readback.data() + size_t{y} * width * vk_offscreen_bytes_per_pixel;
+		for (uint32_t x = 0; x != width; ++x)
+		{
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+void vk_offscreen_destroy(vk_offscreen_t& offscreen, VkDevice device)
+{
+	for (auto& target: offscreen.targets)
+	{
+		if (target.framebuffer) vkDestroyFramebuffer(device, target.framebuffer, nullptr);
+		if (target.view) vkDestroyImageView(device, target.view, nullptr);
+		vk_allocator_destroy_buffer(*offscreen.allocator, target.readback_buffer, target.readback_allocation);
+		vk_allocator_destroy_image(*offscreen.allocator, target.image, target.image_allocation);
+	}
+	if (offscreen.render_pass) vkDestroyRenderPass(device, offscreen.render_pass, nullptr);
+	offscreen = {};
+}
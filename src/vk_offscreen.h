@@ -0,0 +1,72 @@
+#pragma once
+
+// offscreen render targets for the headless mode: no window, no surface, no swapchain.
+// There is one target per frame in flight (vk_frames_t), and frames are recorded into the frame's
+// command buffer, so the cpu records frame n while the gpu is still busy with the frames before
+// it. With readback on, each frame is copied into a host visible buffer that belongs to the same
+// target, and is read one round trip later (when the frame slot comes up again) instead of
+// waiting for the gpu right after the submit.
+
+#include <vulkan/vulkan.h>
+
+#include "vk_allocator.h"
+
+#include <cstdint>
+#include <vector>
+
+const VkFormat vk_offscreen_format = VK_FORMAT_R8G8B8A8_UNORM;
+const uint32_t vk_offscreen_bytes_per_pixel = 4;
+
+struct vk_offscreen_target_t
+{
+	VkImage image;
+	vk_allocation_t image_allocation;
+	VkImageView view;
+	VkFramebuffer framebuffer;
+
+	// only with readback.
+	VkBuffer readback_buffer;
+	vk_allocation_t readback_allocation;
+
+	// the frame that was last recorded into this target, or UINT64_MAX.
+	uint64_t frame_index;
+};
+
+struct vk_offscreen_t
+{
+	vk_allocator_t* allocator;
+	VkExtent2D extent;
+	bool readback;
+	VkRenderPass render_pass;
+	std::vector<vk_offscreen_target_t> targets;
+
+	// a copy of the last frame that was read back.
+	std::vector<uint8_t> last_readback;
+	uint64_t last_readback_frame;
+	uint64_t readback_bytes;
+};
+
+bool vk_offscreen_init(
+	vk_offscreen_t& offscreen,
+	vk_allocator_t& allocator,
+	VkExtent2D extent,
+	uint32_t target_count,
+	bool readback);
+
+// the gpu has to be done with the target (its frame slot came around again). Collects the
+// target's readback, then begins a render pass that clears it to clear_color. The target has to
+// be in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL already (the render graph sees to that, and to
+// the barriers around the render pass).
+void vk_offscreen_begin_frame(vk_offscreen_t& offscreen, VkCommandBuffer command_buffer, uint32_t target_index, uint64_t frame_index, const VkClearColorValue& clear_color, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+void vk_offscreen_end_frame(vk_offscreen_t& offscreen, VkCommandBuffer command_buffer, uint32_t target_index);
+// with readback: copies the target (in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) into its readback
+// buffer. The copy has to be made visible to the host after it.
+void vk_offscreen_copy_readback(vk_offscreen_t& offscreen, VkCommandBuffer command_buffer, uint32_t target_index);
+
+// collects the readbacks of the frames in flight. The gpu has to be done with all of them.
+void vk_offscreen_finish(vk_offscreen_t& offscreen);
+
+// writes the last frame that was read back as a binary ppm.
+bool vk_offscreen_write_ppm(const vk_offscreen_t& offscreen, const char* path);
+
+void vk_offscreen_destroy(vk_offscreen_t& offscreen, VkDevice device);
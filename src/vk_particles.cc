@@ -0,0 +1,657 @@
+#include "vk_particles.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include "particle_init.h"
+#include "vk_shader.h"
+
+#include <algorithm>
+
+const char* particle_sim_shader_path = "shaders/particle_sim.comp.spv";
+const char* particle_bh_shader_path = "shaders/particle_bh.comp.spv";
+const char* particle_draw_vertex_shader_path = "shaders/particle_draw.vert.spv";
+const char* particle_draw_fragment_shader_path = "shaders/particle_draw.frag.spv";
+
+const uint32_t particle_storage_binding_count = 4;
+// particle_bh.comp also has the tree nodes and the attractors.
+const uint32_t particle_barnes_hut_binding_count = 6;
+
+static const char* sim_shader_path(const vk_particles_t& particles)
+{
+	return particles.barnes_hut ? particle_bh_shader_path : particle_sim_shader_path;
+}
+
+static uint32_t sim_binding_count(const vk_particles_t& particles)
+{
+	return particles.barnes_hut ? particle_barnes_hut_binding_count : particle_storage_binding_count;
+}
+
+static uint32_t sim_push_constant_size(const vk_particles_t& particles)
+{
+	return sizeof(vk_particle_step_constants_t) + (particles.barnes_hut ? sizeof(vk_particle_barnes_hut_constants_t) : 0);
+}
+
+static bool create_buffer(vk_particles_t& particles, VkDeviceSize size, VkBufferUsageFlags usage, vk_memory_usage_t memory_usage, VkBuffer& buffer, vk_allocation_t& allocation)
+{
+	VkBufferCreateInfo buffer_create_info{};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = size;
+	buffer_create_info.usage = usage;
+	// exclusive: the render buffers move between the queues with ownership transfers.
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	return vk_allocator_create_buffer(*particles.allocator, buffer_create_info, memory_usage, buffer, allocation);
+}
+
+static VkBufferMemoryBarrier buffer_barrier(VkBuffer buffer, VkAccessFlags src_access, VkAccessFlags dst_access, uint32_t src_family, uint32_t dst_family)
+{
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	barrier.srcQueueFamilyIndex = src_family;
+	barrier.dstQueueFamilyIndex = dst_family;
+	barrier.buffer = buffer;
+	barrier.size = VK_WHOLE_SIZE;
+	return barrier;
+}
+
+// streams the initial state into the simulation buffers through the transfer ring, a chunk at a
+// time: init_particles writes every chunk straight into the ring. Nothing waits for the copies,
+// the first step does that on the gpu. The barnes-hut tree goes the same way.
+static void upload_initial_state(vk_particles_t& particles, vk_transfer_t& transfer, job_system_t& job_system, uint64_t seed, const barnes_hut_tree_t* tree)
+{
+	const size_t chunk_count = vk_transfer_max_allocation_size(transfer) / sizeof(glm::vec4);
+	for (size_t first = 0; first < particles.count; first += chunk_count)
+	{
+		const size_t count = std::min<size_t>(chunk_count, particles.count - first);
+		const VkDeviceSize vec4_offset = first * sizeof(glm::vec4);
+		const VkDeviceSize vec4_size = count * sizeof(glm::vec4);
+
+		// one buffer at a time: an allocation has to be copied before the next one is made.
+		vk_transfer_allocation_t staging = vk_transfer_allocate(transfer, vec4_size);
+		init_particles(job_system, count, seed, reinterpret_cast<glm::vec4*>(staging.mapped), nullptr, nullptr, first);
+		vk_transfer_copy(transfer, staging, 0, particles.positions, vec4_offset, vec4_size);
+
+		staging = vk_transfer_allocate(transfer, vec4_size);
+		init_particles(job_system, count, seed, nullptr, reinterpret_cast<glm::vec4*>(staging.mapped), nullptr, first);
+		vk_transfer_copy(transfer, staging, 0, particles.velocities, vec4_offset, vec4_size);
+
+		staging = vk_transfer_allocate(transfer, count * sizeof(float));
+		init_particles(job_system, count, seed, nullptr, nullptr, reinterpret_cast<float*>(staging.mapped), first);
+		vk_transfer_copy(transfer, staging, 0, particles.lifes, first * sizeof(float), count * sizeof(float));
+	}
+
+	vk_transfer_release(transfer, particles.positions, particles.compute_family);
+	vk_transfer_release(transfer, particles.velocities, particles.compute_family);
+	vk_transfer_release(transfer, particles.lifes, particles.compute_family);
+
+	if (particles.barnes_hut)
+	{
+		vk_transfer_upload(transfer, particles.tree_nodes, 0, tree->nodes.data(), tree->nodes.size() * sizeof(barnes_hut_node_t));
+		vk_transfer_upload(transfer, particles.tree_attractors, 0, tree->attractors.data(), tree->attractors.size() * sizeof(glm::vec4));
+		vk_transfer_release(transfer, particles.tree_nodes, particles.compute_family);
+		vk_transfer_release(transfer, particles.tree_attractors, particles.compute_family);
+	}
+	particles.uploaded = vk_transfer_flush(transfer);
+}
+
+// the pipeline layouts below are written for the shaders as they are; the reflection catches a
+// shader that was changed without them. A shader may use fewer bindings or push constants than
+// the layout has, but not more.
+static bool check_reflection(const char* path, const shader_reflection_t& reflection, VkShaderStageFlagBits stage, uint32_t push_constant_size, uint32_t storage_binding_count)
+{
+	const char* mismatch = nullptr;
+	if (reflection.stage != stage) mismatch = "the stage";
+	else if (reflection.push_constant_size > push_constant_size) mismatch = "the push constants";
+	for (const shader_binding_t& binding: reflection.bindings)
+	{
+		const bool expected = binding.set == 0 && binding.binding < storage_binding_count && binding.count == 1 && binding.descriptor_type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		if (!expected && mismatch == nullptr) mismatch = "the descriptor bindings";
+	}
+	if (mismatch != nullptr)
+	{
+		fmt::print("[vk] {} does not match its pipeline layout: {} changed.\n", path, mismatch);
+		return false;
+	}
+	return true;
+}
+
+// the simulation shader (particle_sim.comp, or particle_bh.comp in barnes-hut mode), and its
+// workgroup size.
+static bool load_sim_shader(const vk_particles_t& particles, VkShaderModule& shader_module, uint32_t& group_size)
+{
+	VkDevice device = particles.allocator->device;
+	const char* path = sim_shader_path(particles);
+	shader_reflection_t reflection;
+	if (!vk_shader_load(device, path, shader_module, &reflection)) return false;
+	bool ok = check_reflection(path, reflection, VK_SHADER_STAGE_COMPUTE_BIT, sim_push_constant_size(particles), sim_binding_count(particles));
+	if (ok && (reflection.local_size[1] != 1 || reflection.local_size[2] != 1))
+	{
+		fmt::print("[vk] {} has to have a 1d workgroup.\n", path);
+		ok = false;
+	}
+	if (!ok)
+	{
+		vkDestroyShaderModule(device, shader_module, nullptr);
+		shader_module = VK_NULL_HANDLE;
+		return false;
+	}
+	group_size = reflection.local_size[0];
+	return true;
+}
+
+// only reads what init made, so it is safe on the reload thread.
+static bool create_sim_pipeline(const vk_particles_t& particles, VkPipelineCache pipeline_cache, VkShaderModule shader_module, VkPipeline& pipeline)
+{
+	VkComputePipelineCreateInfo pipeline_create_info{};
+	pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_create_info.stage.module = shader_module;
+	pipeline_create_info.stage.pName = "main";
+	pipeline_create_info.layout = particles.compute_pipeline_layout;
+	return vkCreateComputePipelines(particles.allocator->device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline) == VK_SUCCESS;
+}
+
+static bool create_compute_pipeline(vk_particles_t& particles, vk_descriptor_layout_cache_t& layout_cache, VkPipelineCache pipeline_cache, VkShaderModule shader_module)
+{
+	VkDevice device = particles.allocator->device;
+
+	const uint32_t binding_count = sim_binding_count(particles);
+	VkDescriptorSetLayoutBinding bindings[particle_barnes_hut_binding_count]{};
+	for (uint32_t idx = 0; idx != binding_count; ++idx)
+	{
+		bindings[idx].binding = idx;
+		bindings[idx].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[idx].descriptorCount = 1;
+		bindings[idx].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	// owned by the layout cache.
+	particles.descriptor_set_layout = vk_descriptor_layout_get(layout_cache, bindings, binding_count);
+	if (particles.descriptor_set_layout == VK_NULL_HANDLE) return false;
+
+	// the sets are written once and live as long as the particles, so they get a pool of their own
+	// rather than coming from the per frame allocator.
+	VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, binding_count * vk_particles_render_buffer_count};
+	VkDescriptorPoolCreateInfo pool_create_info{};
+	pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_create_info.maxSets = vk_particles_render_buffer_count;
+	pool_create_info.poolSizeCount = 1;
+	pool_create_info.pPoolSizes = &pool_size;
+	if (vkCreateDescriptorPool(device, &pool_create_info, nullptr, &particles.descriptor_pool) != VK_SUCCESS) return false;
+
+	std::array<VkDescriptorSetLayout, vk_particles_render_buffer_count> set_layouts;
+	set_layouts.fill(particles.descriptor_set_layout);
+	VkDescriptorSetAllocateInfo set_allocate_info{};
+	set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_allocate_info.descriptorPool = particles.descriptor_pool;
+	set_allocate_info.descriptorSetCount = vk_particles_render_buffer_count;
+	set_allocate_info.pSetLayouts = set_layouts.data();
+	if (vkAllocateDescriptorSets(device, &set_allocate_info, particles.descriptor_sets.data()) != VK_SUCCESS) return false;
+
+	// the sets only differ in the render buffer they write to.
+	for (uint32_t set = 0; set != vk_particles_render_buffer_count; ++set)
+	{
+		const VkBuffer buffers[particle_barnes_hut_binding_count] = {particles.positions, particles.velocities, particles.lifes, particles.render_buffers[set], particles.tree_nodes, particles.tree_attractors};
+		VkDescriptorBufferInfo buffer_infos[particle_barnes_hut_binding_count]{};
+		VkWriteDescriptorSet writes[particle_barnes_hut_binding_count]{};
+		for (uint32_t idx = 0; idx != binding_count; ++idx)
+		{
+			buffer_infos[idx] = {buffers[idx], 0, VK_WHOLE_SIZE};
+			writes[idx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[idx].dstSet = particles.descriptor_sets[set];
+			writes[idx].dstBinding = idx;
+			writes[idx].descriptorCount = 1;
+			writes[idx].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[idx].pBufferInfo = &buffer_infos[idx];
+		}
+		vkUpdateDescriptorSets(device, binding_count, writes, 0, nullptr);
+	}
+
+	VkPushConstantRange push_constant_range{VK_SHADER_STAGE_COMPUTE_BIT, 0, sim_push_constant_size(particles)};
+	VkPipelineLayoutCreateInfo layout_create_info{};
+	layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_create_info.setLayoutCount = 1;
+	layout_create_info.pSetLayouts = &particles.descriptor_set_layout;
+	layout_create_info.pushConstantRangeCount = 1;
+	layout_create_info.pPushConstantRanges = &push_constant_range;
+	if (vkCreatePipelineLayout(device, &layout_create_info, nullptr, &particles.compute_pipeline_layout) != VK_SUCCESS) return false;
+
+	return create_sim_pipeline(particles, pipeline_cache, shader_module, particles.compute_pipeline);
+}
+
+bool vk_particles_init(
+	vk_particles_t& particles,
+	vk_allocator_t& allocator,
+	vk_scheduler_t& scheduler,
+	vk_transfer_t& transfer,
+	vk_descriptor_layout_cache_t& layout_cache,
+	VkPipelineCache pipeline_cache,
+	job_system_t& job_system,
+	uint32_t count,
+	uint32_t frames_in_flight,
+	uint64_t seed,
+	const barnes_hut_tree_t* tree,
+	float theta)
+{
+	VkDevice device = allocator.device;
+	particles = {};
+	particles.allocator = &allocator;
+	particles.scheduler = &scheduler;
+	particles.transfer = &transfer;
+	particles.count = count;
+	particles.compute_family = vk_scheduler_family(scheduler, vk_queue_kind_t::compute);
+	particles.graphics_family = vk_scheduler_family(scheduler, vk_queue_kind_t::graphics);
+	particles.async = particles.compute_family != particles.graphics_family;
+	for (auto& point: particles.render_drawn) point = {vk_queue_kind_t::graphics, 0};
+	for (auto& point: particles.render_written) point = {vk_queue_kind_t::compute, 0};
+	particles.uploaded = {vk_queue_kind_t::transfer, 0};
+	particles.barnes_hut = tree != nullptr;
+	particles.barnes_hut_constants = {theta, barnes_hut_default_softening};
+	if (particles.barnes_hut && tree->nodes.empty())
+	{
+		fmt::print("[vk] barnes-hut mode needs at least one attractor.\n");
+		return false;
+	}
+
+	// before anything is allocated: without the shaders there is nothing to do.
+	VkShaderModule shader_module{};
+	if (!load_sim_shader(particles, shader_module, particles.group_size)) return false;
+
+	bool ok = true;
+	const VkDeviceSize vec4_size = VkDeviceSize{count} * sizeof(glm::vec4);
+	const VkBufferUsageFlags state_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	ok = ok && create_buffer(particles, vec4_size, state_usage, vk_memory_usage_t::gpu_only, particles.positions, particles.positions_allocation);
+	ok = ok && create_buffer(particles, vec4_size, state_usage, vk_memory_usage_t::gpu_only, particles.velocities, particles.velocities_allocation);
+	ok = ok && create_buffer(particles, VkDeviceSize{count} * sizeof(float), state_usage, vk_memory_usage_t::gpu_only, particles.lifes, particles.lifes_allocation);
+	for (uint32_t idx = 0; idx != vk_particles_render_buffer_count && ok; ++idx)
+	{
+		ok = create_buffer(particles, vec4_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vk_memory_usage_t::gpu_only, particles.render_buffers[idx], particles.render_allocations[idx]);
+	}
+	if (particles.barnes_hut)
+	{
+		ok = ok && create_buffer(particles, tree->nodes.size() * sizeof(barnes_hut_node_t), state_usage, vk_memory_usage_t::gpu_only, particles.tree_nodes, particles.tree_nodes_allocation);
+		ok = ok && create_buffer(particles, tree->attractors.size() * sizeof(glm::vec4), state_usage, vk_memory_usage_t::gpu_only, particles.tree_attractors, particles.tree_attractors_allocation);
+	}
+
+	particles.compute_slots.resize(frames_in_flight);
+	for (auto& slot: particles.compute_slots)
+	{
+		slot.submitted = {vk_queue_kind_t::compute, 0};
+		if (!ok) break;
+
+		VkCommandPoolCreateInfo command_pool_create_info{};
+		command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		command_pool_create_info.queueFamilyIndex = particles.compute_family;
+		ok = vkCreateCommandPool(device, &command_pool_create_info, nullptr, &slot.command_pool) == VK_SUCCESS;
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+		command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		command_buffer_allocate_info.commandPool = slot.command_pool;
+		command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		command_buffer_allocate_info.commandBufferCount = 1;
+		ok = ok && vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &slot.command_buffer) == VK_SUCCESS;
+	}
+
+	if (ok) upload_initial_state(particles, transfer, job_system, seed, tree);
+	ok = ok && create_compute_pipeline(particles, layout_cache, pipeline_cache, shader_module);
+	vkDestroyShaderModule(device, shader_module, nullptr);
+
+	if (!ok)
+	{
+		fmt::print("[vk] failed to set up {} gpu particles.\n", count);
+		vk_particles_destroy(particles);
+		return false;
+	}
+
+	fmt::print("[vk] {} gpu particles, compute on queue family {} ({}).\n", count, particles.compute_family, particles.async ? "async" : "shared with graphics");
+	if (particles.barnes_hut)
+	{
+		fmt::print("[vk] barnes-hut mode: {} attractors in {} nodes, theta {}.\n", tree->attractors.size(), tree->nodes.size(), theta);
+	}
+	return true;
+}
+
+// loads both shaders every time, so it picks up new ones. Only reads what init made, so it is safe
+// on the reload thread.
+static bool create_draw_pipeline(const vk_particles_t& particles, VkPipelineCache pipeline_cache, VkRenderPass render_pass, VkPipeline& pipeline)
+{
+	VkDevice device = particles.allocator->device;
+
+	VkShaderModule vertex_module{};
+	VkShaderModule fragment_module{};
+	shader_reflection_t vertex_reflection;
+	shader_reflection_t fragment_reflection;
+	bool ok = vk_shader_load(device, particle_draw_vertex_shader_path, vertex_module, &vertex_reflection);
+	ok = ok && vk_shader_load(device, particle_draw_fragment_shader_path, fragment_module, &fragment_reflection);
+	ok = ok && check_reflection(particle_draw_vertex_shader_path, vertex_reflection, VK_SHADER_STAGE_VERTEX_BIT, sizeof(vk_particle_draw_constants_t), 0);
+	ok = ok && check_reflection(particle_draw_fragment_shader_path, fragment_reflection, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 0);
+
+	if (ok)
+	{
+		VkPipelineShaderStageCreateInfo stages[2]{};
+		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stages[0].module = vertex_module;
+		stages[0].pName = "main";
+		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[1].module = fragment_module;
+		stages[1].pName = "main";
+
+		// one vec4 per particle: position and life.
+		VkVertexInputBindingDescription vertex_binding{0, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX};
+		VkVertexInputAttributeDescription vertex_attribute{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0};
+		VkPipelineVertexInputStateCreateInfo vertex_input{};
+		vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertex_input.vertexBindingDescriptionCount = 1;
+		vertex_input.pVertexBindingDescriptions = &vertex_binding;
+		vertex_input.vertexAttributeDescriptionCount = 1;
+		vertex_input.pVertexAttributeDescriptions = &vertex_attribute;
+
+		VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+		// viewport and scissor are dynamic, so the pipeline survives a resize.
+		VkPipelineViewportStateCreateInfo viewport_state{};
+		viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewport_state.viewportCount = 1;
+		viewport_state.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterization{};
+		rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterization.cullMode = VK_CULL_MODE_NONE;
+		rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterization.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisample{};
+		multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState blend_attachment{};
+		blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo color_blend{};
+		color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		color_blend.attachmentCount = 1;
+		color_blend.pAttachments = &blend_attachment;
+
+		const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		VkPipelineDynamicStateCreateInfo dynamic_state{};
+		dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamic_state.dynamicStateCount = 2;
+		dynamic_state.pDynamicStates = dynamic_states;
+
+		VkGraphicsPipelineCreateInfo pipeline_create_info{};
+		pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipeline_create_info.stageCount = 2;
+		pipeline_create_info.pStages = stages;
+		pipeline_create_info.pVertexInputState = &vertex_input;
+		pipeline_create_info.pInputAssemblyState = &input_assembly;
+		pipeline_create_info.pViewportState = &viewport_state;
+		pipeline_create_info.pRasterizationState = &rasterization;
+		pipeline_create_info.pMultisampleState = &multisample;
+		pipeline_create_info.pColorBlendState = &color_blend;
+		pipeline_create_info.pDynamicState = &dynamic_state;
+		pipeline_create_info.layout = particles.draw_pipeline_layout;
+		pipeline_create_info.renderPass = render_pass;
+		pipeline_create_info.subpass = 0;
+		ok = vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline) == VK_SUCCESS;
+	}
+
+	if (vertex_module) vkDestroyShaderModule(device, vertex_module, nullptr);
+	if (fragment_module) vkDestroyShaderModule(device, fragment_module, nullptr);
+	return ok;
+}
+
+bool vk_particles_create_draw_pipeline(vk_particles_t& particles, VkPipelineCache pipeline_cache, VkRenderPass render_pass)
+{
+	VkDevice device = particles.allocator->device;
+
+	bool ok = true;
+	if (particles.draw_pipeline_layout == VK_NULL_HANDLE)
+	{
+		VkPushConstantRange push_constant_range{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(vk_particle_draw_constants_t)};
+		VkPipelineLayoutCreateInfo layout_create_info{};
+		layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layout_create_info.pushConstantRangeCount = 1;
+		layout_create_info.pPushConstantRanges = &push_constant_range;
+		ok = vkCreatePipelineLayout(device, &layout_create_info, nullptr, &particles.draw_pipeline_layout) == VK_SUCCESS;
+	}
+
+	ok = ok && create_draw_pipeline(particles, pipeline_cache, render_pass, particles.draw_pipeline);
+	if (!ok) fmt::print("[vk] failed to create the particle draw pipeline.\n");
+	particles.draw_render_pass = render_pass;
+	return ok;
+}
+
+bool vk_particles_rebuild_compute_pipeline(vk_particles_t& particles, VkPipelineCache pipeline_cache)
+{
+	VkDevice device = particles.allocator->device;
+	VkShaderModule shader_module{};
+	uint32_t group_size = 0;
+	if (!load_sim_shader(particles, shader_module, group_size)) return false;
+
+	VkPipeline pipeline{};
+	const bool ok = create_sim_pipeline(particles, pipeline_cache, shader_module, pipeline);
+	vkDestroyShaderModule(device, shader_module, nullptr);
+	if (!ok) return false;
+	particles.pending_compute_pipeline = pipeline;
+	particles.pending_group_size = group_size;
+	return true;
+}
+
+bool vk_particles_rebuild_draw_pipeline(vk_particles_t& particles, VkPipelineCache pipeline_cache)
+{
+	VkPipeline pipeline{};
+	if (!create_draw_pipeline(particles, pipeline_cache, particles.draw_render_pass, pipeline)) return false;
+	particles.pending_draw_pipeline = pipeline;
+	return true;
+}
+
+// the old pipelines may still be in use by everything that was submitted so far.
+void vk_particles_swap_compute_pipeline(vk_particles_t& particles)
+{
+	if (particles.pending_compute_pipeline == VK_NULL_HANDLE) return;
+	particles.retired_pipelines.push_back({particles.compute_pipeline, vk_scheduler_last_submitted(*particles.scheduler, vk_queue_kind_t::compute)});
+	particles.compute_pipeline = particles.pending_compute_pipeline;
+	particles.group_size = particles.pending_group_size;
+	particles.pending_compute_pipeline = VK_NULL_HANDLE;
+}
+
+void vk_particles_swap_draw_pipeline(vk_particles_t& particles)
+{
+	if (particles.pending_draw_pipeline == VK_NULL_HANDLE) return;
+	particles.retired_pipelines.push_back({particles.draw_pipeline, vk_scheduler_last_submitted(*particles.scheduler, vk_queue_kind_t::graphics)});
+	particles.draw_pipeline = particles.pending_draw_pipeline;
+	particles.pending_draw_pipeline = VK_NULL_HANDLE;
+}
+
+void vk_particles_collect_pipelines(vk_particles_t& particles)
+{
+	vk_scheduler_t& scheduler = *particles.scheduler;
+	VkDevice device = particles.allocator->device;
+	auto done = [&](const vk_retired_pipeline_t& retired)
+	{
+		if (!vk_scheduler_is_complete(scheduler, retired.point)) return false;
+		vkDestroyPipeline(device, retired.pipeline, nullptr);
+		return true;
+	};
+	particles.retired_pipelines.erase(std::remove_if(particles.retired_pipelines.begin(), particles.retired_pipelines.end(), done), particles.retired_pipelines.end());
+}
+
+uint64_t vk_particles_simulate(vk_particles_t& particles, vk_particle_step_constants_t constants, vk_profiler_t* profiler)
+{
+	vk_scheduler_t& scheduler = *particles.scheduler;
+	const uint64_t step = particles.step_index++;
+	const uint32_t buffer = static_cast<uint32_t>(step % vk_particles_render_buffer_count);
+	VkBuffer render_buffer = particles.render_buffers[buffer];
+
+	// only blocks when the compute queue is frames_in_flight steps behind.
+	vk_particle_compute_slot_t& slot = particles.compute_slots[step % particles.compute_slots.size()];
+	vk_scheduler_wait(scheduler, slot.submitted);
+	vkResetCommandPool(scheduler.device, slot.command_pool, 0);
+
+	VkCommandBuffer command_buffer = slot.command_buffer;
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	if (step == 0)
+	{
+		// the initial upload wrote the simulation state, on the transfer queue.
+		const VkAccessFlags access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vk_transfer_acquire(*particles.transfer, command_buffer, particles.positions, particles.compute_family, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, access);
+		vk_transfer_acquire(*particles.transfer, command_buffer, particles.velocities, particles.compute_family, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, access);
+		vk_transfer_acquire(*particles.transfer, command_buffer, particles.lifes, particles.compute_family, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, access);
+		if (particles.barnes_hut)
+		{
+			vk_transfer_acquire(*particles.transfer, command_buffer, particles.tree_nodes, particles.compute_family, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			vk_transfer_acquire(*particles.transfer, command_buffer, particles.tree_attractors, particles.compute_family, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+	}
+	else
+	{
+		// the previous step wrote the simulation state.
+		VkMemoryBarrier state_barrier{};
+		state_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		state_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		state_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &state_barrier, 0, nullptr, 0, nullptr);
+	}
+
+	// the render buffer was drawn two steps ago: take it back from graphics.
+	if (step >= vk_particles_render_buffer_count)
+	{
+		if (particles.async)
+		{
+			VkBufferMemoryBarrier acquire = buffer_barrier(render_buffer, 0, VK_ACCESS_SHADER_WRITE_BIT, particles.graphics_family, particles.compute_family);
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &acquire, 0, nullptr);
+		}
+		else
+		{
+			// write after read: an execution dependency is enough.
+			vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	constants.count = particles.count;
+	if (profiler != nullptr) vk_profiler_begin(*profiler, command_buffer, vk_queue_kind_t::compute, "particles.simulate");
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles.compute_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles.compute_pipeline_layout, 0, 1, &particles.descriptor_sets[buffer], 0, nullptr);
+	vkCmdPushConstants(command_buffer, particles.compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	if (particles.barnes_hut)
+	{
+		vkCmdPushConstants(command_buffer, particles.compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(constants), sizeof(particles.barnes_hut_constants), &particles.barnes_hut_constants);
+	}
+	vkCmdDispatch(command_buffer, (particles.count + particles.group_size - 1) / particles.group_size, 1, 1);
+	if (profiler != nullptr) vk_profiler_end(*profiler, command_buffer, vk_queue_kind_t::compute);
+
+	if (particles.async)
+	{
+		VkBufferMemoryBarrier release = buffer_barrier(render_buffer, VK_ACCESS_SHADER_WRITE_BIT, 0, particles.compute_family, particles.graphics_family);
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+	}
+	vkEndCommandBuffer(command_buffer);
+
+	vk_submit_t submit{};
+	vk_submit_add_command_buffer(submit, command_buffer);
+	// the graphics release of this buffer has to run before our acquire.
+	vk_submit_wait(submit, scheduler, particles.render_drawn[buffer], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	if (step == 0) vk_submit_wait(submit, scheduler, particles.uploaded, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	vk_timeline_point_t point = vk_scheduler_submit(scheduler, vk_queue_kind_t::compute, submit);
+
+	slot.submitted = point;
+	particles.render_written[buffer] = point;
+	return step;
+}
+
+vk_timeline_point_t vk_particles_step_point(const vk_particles_t& particles, uint64_t step)
+{
+	return particles.render_written[step % vk_particles_render_buffer_count];
+}
+
+void vk_particles_acquire(vk_particles_t& particles, VkCommandBuffer command_buffer, uint64_t step)
+{
+	VkBuffer render_buffer = particles.render_buffers[step % vk_particles_render_buffer_count];
+	if (particles.async)
+	{
+		VkBufferMemoryBarrier acquire = buffer_barrier(render_buffer, 0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, particles.compute_family, particles.graphics_family);
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &acquire, 0, nullptr);
+	}
+	else
+	{
+		VkBufferMemoryBarrier barrier = buffer_barrier(render_buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+}
+
+void vk_particles_draw(vk_particles_t& particles, VkCommandBuffer command_buffer, uint64_t step, VkExtent2D extent, const glm::mat4& view_projection_matrix, uint32_t first, uint32_t count)
+{
+	if (first >= particles.count) return;
+	count = std::min(count, particles.count - first);
+
+	VkViewport viewport{0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+	VkRect2D scissor{{0, 0}, extent};
+	vk_particle_draw_constants_t constants{view_projection_matrix};
+	VkDeviceSize offset = 0;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particles.draw_pipeline);
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+	vkCmdPushConstants(command_buffer, particles.draw_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, &particles.render_buffers[step % vk_particles_render_buffer_count], &offset);
+	vkCmdDraw(command_buffer, count, 1, first, 0);
+}
+
+void vk_particles_release(vk_particles_t& particles, VkCommandBuffer command_buffer, uint64_t step)
+{
+	if (!particles.async) return;
+
+	VkBufferMemoryBarrier release = buffer_barrier(particles.render_buffers[step % vk_particles_render_buffer_count], 0, 0, particles.graphics_family, particles.compute_family);
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+}
+
+void vk_particles_drawn(vk_particles_t& particles, uint64_t step, vk_timeline_point_t point)
+{
+	particles.render_drawn[step % vk_particles_render_buffer_count] = point;
+}
+
+void vk_particles_destroy(vk_particles_t& particles)
+{
+	if (particles.allocator == nullptr) return;
+	vk_allocator_t& allocator = *particles.allocator;
+	VkDevice device = allocator.device;
+
+	// the initial upload may still be copying into the buffers (when the pipeline failed).
+	vk_scheduler_wait(*particles.scheduler, particles.uploaded);
+	// everything is idle by now, the retired pipelines included.
+	for (auto& retired: particles.retired_pipelines) vkDestroyPipeline(device, retired.pipeline, nullptr);
+	if (particles.pending_compute_pipeline) vkDestroyPipeline(device, particles.pending_compute_pipeline, nullptr);
+	if (particles.pending_draw_pipeline) vkDestroyPipeline(device, particles.pending_draw_pipeline, nullptr);
+	if (particles.draw_pipeline) vkDestroyPipeline(device, particles.draw_pipeline, nullptr);
+	if (particles.draw_pipeline_layout) vkDestroyPipelineLayout(device, particles.draw_pipeline_layout, nullptr);
+	if (particles.compute_pipeline) vkDestroyPipeline(device, particles.compute_pipeline, nullptr);
+	if (particles.compute_pipeline_layout) vkDestroyPipelineLayout(device, particles.compute_pipeline_layout, nullptr);
+	// frees the sets as well.
+	if (particles.descriptor_pool) vkDestroyDescriptorPool(device, particles.descriptor_pool, nullptr);
+	for (auto& slot: particles.compute_slots)
+	{
+		if (slot.command_pool) vkDestroyCommandPool(device, slot.command_pool, nullptr);
+	}
+	for (uint32_t idx = 0; idx != vk_particles_render_buffer_count; ++idx)
+	{
+		vk_allocator_destroy_buffer(allocator, particles.render_buffers[idx], particles.render_allocations[idx]);
+	}
+	vk_allocator_destroy_buffer(allocator, particles.tree_attractors, particles.tree_attractors_allocation);
+	vk_allocator_destroy_buffer(allocator, particles.tree_nodes, particles.tree_nodes_allocation);
+	vk_allocator_destroy_buffer(allocator, particles.lifes, particles.lifes_allocation);
+	vk_allocator_destroy_buffer(allocator, particles.velocities, particles.velocities_allocation);
+	vk_allocator_destroy_buffer(allocator, particles.positions, particles.positions_allocation);
+	particles = {};
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+// the particle simulation on the gpu (shaders/particle_sim.comp), on the async compute queue.
+//
+// the simulation state (positions, velocities, lifes) only ever lives on the compute queue. Every
+// step also writes what is drawn (position and life) into one of two render buffers, so the step
+// for frame n + 1 runs on the compute queue while graphics draws frame n from the other buffer:
+//
+//   compute: step n + 1 -> render_buffers[(n + 1) % 2]
+//   graphics:              draw render_buffers[n % 2]
+//
+// with a dedicated compute family the render buffers change owner twice per step: released by
+// compute after the step and acquired by graphics before the draw, then released by graphics after
+// the draw and acquired by compute two steps later. The timeline points of the scheduler order
+// the release/acquire pairs. Without a dedicated compute family everything runs on the graphics
+// queue and plain barriers do.
+//
+// barnes-hut mode (vk_particles_init with a tree): shaders/particle_bh.comp runs instead of
+// particle_sim.comp and pulls the particles towards thousands of attractors through the octree of
+// barnes_hut.h. The tree is built once on the cpu and uploaded with the initial state.
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+#include "barnes_hut.h"
+#include "job_system.h"
+#include "vk_allocator.h"
+#include "vk_descriptors.h"
+#include "vk_profiler.h"
+#include "vk_scheduler.h"
+#include "vk_transfer.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+const uint32_t vk_particles_render_buffer_count = 2;
+
+// the push constants of particle_sim.comp.
+struct vk_particle_step_constants_t
+{
+	glm::vec3 force_point;
+	float dt;
+	uint32_t frame_index;
+	uint32_t count;
+	glm::uvec2 seed;
+};
+static_assert(sizeof(vk_particle_step_constants_t) == 32, "vk_particle_step_constants_t has to match particle_sim.comp.");
+
+// the push constants particle_bh.comp has after vk_particle_step_constants_t.
+struct vk_particle_barnes_hut_constants_t
+{
+	float theta;
+	float softening;
+};
+
+// the push constants of particle_draw.vert.
+struct vk_particle_draw_constants_t
+{
+	glm::mat4 view_projection_matrix;
+};
+
+struct vk_particle_compute_slot_t
+{
+	VkCommandPool command_pool;
+	VkCommandBuffer command_buffer;
+	vk_timeline_point_t submitted;
+};
+
+struct vk_retired_pipeline_t
+{
+	VkPipeline pipeline;
+	// destroyed once this is done.
+	vk_timeline_point_t point;
+};
+
+struct vk_particles_t
+{
+	vk_allocator_t* allocator;
+	vk_scheduler_t* scheduler;
+	vk_transfer_t* transfer;
+	uint32_t count;
+	// local_size_x of particle_sim.comp, from its reflection.
+	uint32_t group_size;
+	// compute runs on its own queue family: the render buffers need ownership transfers.
+	bool async;
+	uint32_t compute_family;
+	uint32_t graphics_family;
+
+	VkBuffer positions;
+	VkBuffer velocities;
+	VkBuffer lifes;
+	vk_allocation_t positions_allocation;
+	vk_allocation_t velocities_allocation;
+	vk_allocation_t lifes_allocation;
+	// the transfer flush with the initial state: the first step waits for it.
+	vk_timeline_point_t uploaded;
+
+	std::array<VkBuffer, vk_particles_render_buffer_count> render_buffers;
+	std::array<vk_allocation_t, vk_particles_render_buffer_count> render_allocations;
+	// the point of the graphics submit that last drew the buffer, and of the step that last wrote it.
+	std::array<vk_timeline_point_t, vk_particles_render_buffer_count> render_drawn;
+	std::array<vk_timeline_point_t, vk_particles_render_buffer_count> render_written;
+
+	// barnes-hut mode: the tree, read by particle_bh.comp.
+	bool barnes_hut;
+	vk_particle_barnes_hut_constants_t barnes_hut_constants;
+	VkBuffer tree_nodes;
+	VkBuffer tree_attractors;
+	vk_allocation_t tree_nodes_allocation;
+	vk_allocation_t tree_attractors_allocation;
+
+	// from the layout cache.
+	VkDescriptorSetLayout descriptor_set_layout;
+	VkDescriptorPool descriptor_pool;
+	// one per render buffer.
+	std::array<VkDescriptorSet, vk_particles_render_buffer_count> descriptor_sets;
+	VkPipelineLayout compute_pipeline_layout;
+	VkPipeline compute_pipeline;
+	VkPipelineLayout draw_pipeline_layout;
+	VkPipeline draw_pipeline;
+	VkRenderPass draw_render_pass;
+
+	// rebuilt by the shader reload thread, waiting for their swap.
+	VkPipeline pending_compute_pipeline;
+	uint32_t pending_group_size;
+	VkPipeline pending_draw_pipeline;
+	// swapped out, possibly still in use by the gpu.
+	std::vector<vk_retired_pipeline_t> retired_pipelines;
+
+	// command pools and buffers for the compute queue, one per frame in flight.
+	std::vector<vk_particle_compute_slot_t> compute_slots;
+	// the next step to simulate.
+	uint64_t step_index;
+};
+
+// streams the initial particles (init_particles, generated on all cores straight into the staging
+// ring) to the gpu and creates the compute pipeline. Fails (without leaking) when the shaders are
+// missing. With a tree, the particles are simulated in barnes-hut mode with opening angle theta;
+// the tree is uploaded right away and not needed after this.
+bool vk_particles_init(
+	vk_particles_t& particles,
+	vk_allocator_t& allocator,
+	vk_scheduler_t& scheduler,
+	vk_transfer_t& transfer,
+	vk_descriptor_layout_cache_t& layout_cache,
+	VkPipelineCache pipeline_cache,
+	job_system_t& job_system,
+	uint32_t count,
+	uint32_t frames_in_flight,
+	uint64_t seed,
+	const barnes_hut_tree_t* tree = nullptr,
+	float theta = barnes_hut_default_theta);
+
+// the draw pipeline for a render pass with one color attachment. Viewport and scissor are dynamic.
+bool vk_particles_create_draw_pipeline(vk_particles_t& particles, VkPipelineCache pipeline_cache, VkRenderPass render_pass);
+
+// shader hot reload (shader_reload.h). The rebuild functions load the shaders again and make a new
+// pipeline with the same layout, without touching anything the frame loop uses, so they can run on
+// the reload thread (the draw one only once vk_particles_create_draw_pipeline worked). The new
+// pipeline waits for its swap, which the frame loop calls from the program's swap callback, so
+// never while the rebuild runs. The old one is destroyed by vk_particles_collect_pipelines once the
+// gpu is done with it: call that once per frame.
+bool vk_particles_rebuild_compute_pipeline(vk_particles_t& particles, VkPipelineCache pipeline_cache);
+bool vk_particles_rebuild_draw_pipeline(vk_particles_t& particles, VkPipelineCache pipeline_cache);
+void vk_particles_swap_compute_pipeline(vk_particles_t& particles);
+void vk_particles_swap_draw_pipeline(vk_particles_t& particles);
+void vk_particles_collect_pipelines(vk_particles_t& particles);
+
+// records and submits the next step on the compute queue, and returns the step that was
+// simulated. constants.count is filled in. With a profiler, the dispatch is timed.
+uint64_t vk_particles_simulate(vk_particles_t& particles, vk_particle_step_constants_t constants, vk_profiler_t* profiler = nullptr);
+
+// the timeline point graphics has to wait for (at vertex input) before drawing step.
+vk_timeline_point_t vk_particles_step_point(const vk_particles_t& particles, uint64_t step);
+
+// in the graphics command buffer: acquire before the render pass, draw inside it, release after it.
+// The draw can be split into ranges of particles, recorded into separate (secondary) command buffers.
+void vk_particles_acquire(vk_particles_t& particles, VkCommandBuffer command_buffer, uint64_t step);
+void vk_particles_draw(vk_particles_t& particles, VkCommandBuffer command_buffer, uint64_t step, VkExtent2D extent, const glm::mat4& view_projection_matrix, uint32_t first = 0, uint32_t count = UINT32_MAX);
+void vk_particles_release(vk_particles_t& particles, VkCommandBuffer command_buffer, uint64_t step);
+// the graphics submit that drew step: the next step into the same buffer waits for it.
+void vk_particles_drawn(vk_particles_t& particles, uint64_t step, vk_timeline_point_t point);
+
+void vk_particles_destroy(vk_particles_t& particles);
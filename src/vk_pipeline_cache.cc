@@ -0,0 +1,232 @@
+#include "vk_pipeline_cache.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <cstdio>
+#include <cstring> // memcmp, memcpy
+#include <filesystem>
+
+const uint32_t cache_file_magic = 0x43504b56; // "VKPC"
+const uint32_t cache_file_version = 1;
+
+struct cache_file_header_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint32_t driver_version;
+	uint8_t uuid[VK_UUID_SIZE];
+	uint64_t data_size;
+	uint64_t data_hash;
+};
+
+// the header the driver puts in front of its own data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE).
+struct driver_cache_header_t
+{
+	uint32_t header_size;
+	uint32_t header_version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint8_t uuid[VK_UUID_SIZE];
+};
+
+// fnv-1a.
+static uint64_t hash_bytes(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t idx = 0; idx != size; ++idx)
+	{
+		hash ^= data[idx];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+	std::vector<uint8_t> bytes;
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr) return bytes;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size > 0)
+	{
+		bytes.resize(static_cast<size_t>(size));
+		if (fread(bytes.data(), 1, bytes.size(), file) != bytes.size()) bytes.clear();
+	}
+	fclose(file);
+	return bytes;
+}
+
+// returns why the file can not be used, or nullptr if it can.
+static const char* validate(const vk_pipeline_cache_t& cache, const std::vector<uint8_t>& bytes)
+{
+	cache_file_header_t header{};
+	if (bytes.size() < sizeof(header)) return "file is truncated";
+	memcpy(&header, bytes.data(), sizeof(header));
+
+	if (header.magic != cache_file_magic || header.version != cache_file_version) return "unknown file format";
+	if (header.vendor_id != cache.vendor_id || header.device_id != cache.device_id) return "written for another device";
+	if (header.driver_version != cache.driver_version) return "written by another driver version";
+	if (memcmp(header.uuid, cache.uuid, VK_UUID_SIZE) != 0) return "pipeline cache uuid changed";
+	if (header.data_size != bytes.size() - sizeof(header)) return "file is truncated";
+
+	const uint8_t* data = bytes.data() + sizeof(header);
+	if (hash_bytes(data, header.data_size) != header.data_hash) return "file is corrupt";
+
+	driver_cache_header_t driver_header{};
+	if (header.data_size < sizeof(driver_header)) return "driver data is truncated";
+	memcpy(&driver_header, data, sizeof(driver_header));
+	if (driver_header.header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		driver_header.header_size < sizeof(driver_header) ||
+		driver_header.vendor_id != cache.vendor_id ||
+		driver_header.device_id != cache.device_id ||
+		memcmp(driver_header.uuid, cache.uuid, VK_UUID_SIZE) != 0) return "driver data does not match the device";
+
+	return nullptr;
+}
+
+static bool create_cache(VkDevice device, const void* data, size_t size, VkPipelineCache& pipeline_cache)
+{
+	VkPipelineCacheCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	create_info.initialDataSize = size;
+	create_info.pInitialData = data;
+	return vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache) == VK_SUCCESS;
+}
+
+bool vk_pipeline_cache_init(vk_pipeline_cache_t& cache, VkPhysicalDevice physical_device, VkDevice device, const char* directory)
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	cache.cache = VK_NULL_HANDLE;
+	cache.vendor_id = properties.vendorID;
+	cache.device_id = properties.deviceID;
+	cache.driver_version = properties.driverVersion;
+	memcpy(cache.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	cache.loaded_size = 0;
+	cache.path = directory != nullptr ? fmt::format("{}/pipeline_cache_{:04x}_{:04x}.bin", directory, cache.vendor_id, cache.device_id) : std::string{};
+
+	if (!cache.path.empty())
+	{
+		std::vector<uint8_t> bytes = read_file(cache.path);
+		if (!bytes.empty())
+		{
+			const char* reason = validate(cache, bytes);
+			if (reason == nullptr)
+			{
+				const size_t data_size = bytes.size() - sizeof(cache_file_header_t);
+				if (create_cache(device, bytes.data() + sizeof(cache_file_header_t), data_size, cache.cache))
+				{
+					cache.loaded_size = data_size;
+				}
+				else
+				{
+					fmt::print("[vk] pipeline cache {} was rejected by the driver.\n", cache.path);
+				}
+			}
+			else
+			{
+				fmt::print("[vk] ignoring pipeline cache {}: {}.\n", cache.path, reason);
+			}
+		}
+	}
+
+	if (cache.cache == VK_NULL_HANDLE && !create_cache(device, nullptr, 0, cache.cache))
+	{
+		fmt::print("[vk] failed to create a pipeline cache.\n");
+		return false;
+	}
+
+	fmt::print("[vk] pipeline cache: {}\n", cache.loaded_size != 0 ? fmt::format("loaded {} bytes from {}", cache.loaded_size, cache.path) : std::string{"starting empty"});
+	return true;
+}
+
+VkPipelineCache vk_pipeline_cache_create_worker(vk_pipeline_cache_t& cache, VkDevice device)
+{
+	VkPipelineCache worker_cache = VK_NULL_HANDLE;
+	if (!create_cache(device, nullptr, 0, worker_cache)) return VK_NULL_HANDLE;
+
+	std::lock_guard<std::mutex> lock(cache.worker_mutex);
+	cache.worker_caches.push_back(worker_cache);
+	return worker_cache;
+}
+
+void vk_pipeline_cache_merge_workers(vk_pipeline_cache_t& cache, VkDevice device)
+{
+	std::lock_guard<std::mutex> lock(cache.worker_mutex);
+	if (cache.worker_caches.empty()) return;
+
+	VkResult result = vkMergePipelineCaches(device, cache.cache, static_cast<uint32_t>(cache.worker_caches.size()), cache.worker_caches.data());
+	if (result != VK_SUCCESS) fmt::print("[vk] failed to merge {} worker pipeline caches.\n", cache.worker_caches.size());
+
+	for (VkPipelineCache worker_cache: cache.worker_caches)
+	{
+		vkDestroyPipelineCache(device, worker_cache, nullptr);
+	}
+	cache.worker_caches.clear();
+}
+
+bool vk_pipeline_cache_save(vk_pipeline_cache_t& cache, VkDevice device)
+{
+	vk_pipeline_cache_merge_workers(cache, device);
+	if (cache.path.empty()) return true;
+
+	size_t data_size = 0;
+	if (vkGetPipelineCacheData(device, cache.cache, &data_size, nullptr) != VK_SUCCESS) return false;
+	std::vector<uint8_t> bytes(sizeof(cache_file_header_t) + data_size);
+	if (vkGetPipelineCacheData(device, cache.cache, &data_size, bytes.data() + sizeof(cache_file_header_t)) != VK_SUCCESS) return false;
+	bytes.resize(sizeof(cache_file_header_t) + data_size);
+
+	cache_file_header_t header{};
+	header.magic = cache_file_magic;
+	header.version = cache_file_version;
+	header.vendor_id = cache.vendor_id;
+	header.device_id = cache.device_id;
+	header.driver_version = cache.driver_version;
+	memcpy(header.uuid, cache.uuid, VK_UUID_SIZE);
+	header.data_size = data_size;
+	header.data_hash = hash_bytes(bytes.data() + sizeof(header), data_size);
+	memcpy(bytes.data(), &header, sizeof(header));
+
+	std::error_code error;
+	const std::filesystem::path path(cache.path);
+	if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), error);
+
+	const std::string temp_path = cache.path + ".tmp";
+	FILE* file = fopen(temp_path.c_str(), "wb");
+	if (file == nullptr)
+	{
+		fmt::print("[vk] failed to open {} for writing.\n", temp_path);
+		return false;
+	}
+	const bool write_ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	if (fclose(file) != 0 || !write_ok)
+	{
+		fmt::print("[vk] failed to write {}.\n", temp_path);
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	std::filesystem::rename(temp_path, path, error);
+	if (error)
+	{
+		fmt::print("[vk] failed to replace {}: {}\n", cache.path, error.message());
+		return false;
+	}
+
+	fmt::print("[vk] saved {} bytes of pipeline cache to {}\n", data_size, cache.path);
+	return true;
+}
+
+void vk_pipeline_cache_destroy(vk_pipeline_cache_t& cache, VkDevice device)
+{
+	vk_pipeline_cache_merge_workers(cache, device);
+	if (cache.cache != VK_NULL_HANDLE) vkDestroyPipelineCache(device, cache.cache, nullptr);
+	cache.cache = VK_NULL_HANDLE;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// VkPipelineCache that survives restarts. The driver blob is stored behind a header of our own:
+//
+//     magic, header version, vendor id, device id, driver version, pipelineCacheUUID, blob size, blob hash
+//
+// and is only handed to the driver when all of it matches the device we are running on (drivers
+// are supposed to reject foreign blobs themselves, but not all of them do so gracefully). The
+// file name contains the vendor and device id, so machines with more than one gpu keep one cache
+// per device. A driver update changes the driver version and pipelineCacheUUID, which throws the
+// old cache away.
+//
+// threads that build pipelines in parallel should each use a worker cache (a VkPipelineCache is
+// internally synchronized, so sharing one serializes the compiles), which are merged back into
+// the main cache before it is saved.
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct vk_pipeline_cache_t
+{
+	VkPipelineCache cache;
+	std::string path;
+
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint32_t driver_version;
+	uint8_t uuid[VK_UUID_SIZE];
+
+	// the size of the blob that was loaded from disk (0 if we started empty).
+	size_t loaded_size;
+
+	std::mutex worker_mutex;
+	std::vector<VkPipelineCache> worker_caches;
+};
+
+// loads the cache for physical_device from directory, or starts an empty one if there is no
+// usable file. directory == nullptr disables loading and saving.
+bool vk_pipeline_cache_init(vk_pipeline_cache_t& cache, VkPhysicalDevice physical_device, VkDevice device, const char* directory);
+
+// an empty cache for a single thread to build pipelines with. Thread safe.
+VkPipelineCache vk_pipeline_cache_create_worker(vk_pipeline_cache_t& cache, VkDevice device);
+// merges every worker cache into the main cache and destroys them. No worker may be in use.
+void vk_pipeline_cache_merge_workers(vk_pipeline_cache_t& cache, VkDevice device);
+
+// merges the workers and writes the cache to disk (through a temporary file, so a crash halfway
+// never leaves a truncated cache behind).
+bool vk_pipeline_cache_save(vk_pipeline_cache_t& cache, VkDevice device);
+void vk_pipeline_cache_destroy(vk_pipeline_cache_t& cache, VkDevice device);
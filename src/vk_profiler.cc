@@ -0,0 +1,320 @@
+#include "vk_profiler.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> // QueryPerformanceFrequency
+#endif
+
+// how often the gpu clock is sampled against the cpu clock again, to follow drift.
+const int64_t recalibrate_interval_ns = 1000000000;
+
+static const char* track_names[] = {"gpu graphics", "gpu compute", "gpu transfer", "host", "cpu"};
+
+static int64_t now_ns()
+{
+	using clock = std::chrono::steady_clock;
+	return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count());
+}
+
+// the host time domain steady_clock counts in, and how to turn its values into steady_clock
+// nanoseconds. Only the platforms where we know what steady_clock uses.
+static bool host_time_domain(VkTimeDomainEXT& domain)
+{
+#if defined(_WIN32)
+	domain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+	return true;
+#elif defined(__linux__)
+	domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static int64_t host_ticks_to_ns(uint64_t ticks)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	// split, so ticks * 1e9 does not overflow.
+	const uint64_t per_second = static_cast<uint64_t>(frequency.QuadPart);
+	return static_cast<int64_t>((ticks / per_second) * 1000000000ull + (ticks % per_second) * 1000000000ull / per_second);
+#else
+	return static_cast<int64_t>(ticks);
+#endif
+}
+
+static void calibrate(vk_profiler_t& profiler)
+{
+	VkTimeDomainEXT host_domain{};
+	if (profiler.get_calibrated_timestamps == nullptr || !host_time_domain(host_domain)) return;
+
+	VkCalibratedTimestampInfoEXT infos[2]{};
+	infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[1].timeDomain = host_domain;
+	uint64_t timestamps[2]{};
+	uint64_t max_deviation = 0;
+	if (profiler.get_calibrated_timestamps(profiler.device, 2, infos, timestamps, &max_deviation) != VK_SUCCESS) return;
+
+	const int64_t device_ns = static_cast<int64_t>(static_cast<double>(timestamps[0]) * profiler.timestamp_period);
+	profiler.gpu_to_cpu_offset_ns = host_ticks_to_ns(timestamps[1]) - device_ns;
+	profiler.has_offset = true;
+	profiler.calibrated_at_ns = now_ns();
+	profiler.max_deviation_ns = max_deviation;
+}
+
+static void add_event(vk_profiler_t& profiler, const vk_profiler_event_t& event)
+{
+	vk_profiler_stat_t& stat = profiler.stats[fmt::format("{}: {}", track_names[event.track], event.name)];
+	const double ms = static_cast<double>(event.end_ns - event.begin_ns) * 1e-6;
+	stat.total_ms += ms;
+	stat.max_ms = std::max(stat.max_ms, ms);
+	stat.count += 1;
+	if (profiler.keep_events && profiler.events.size() != vk_profiler_max_events) profiler.events.push_back(event);
+}
+
+// false when some query is not written yet: the pool is still in use and must not be reset.
+static bool collect(vk_profiler_t& profiler, vk_profiler_frame_t& frame)
+{
+	if (frame.query_count == 0) return true;
+
+	// (value, availability) per query.
+	std::vector<uint64_t> results(size_t{frame.query_count} * 2);
+	const VkResult result = vkGetQueryPoolResults(profiler.device, frame.query_pool, 0, frame.query_count,
+		results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY) return false;
+	for (uint32_t query = 0; query != frame.query_count; ++query)
+	{
+		if (results[2 * query + 1] == 0) return false;
+	}
+
+	// without calibration, the last gpu timestamp of the first frame we see is taken to be now.
+	if (!profiler.has_offset)
+	{
+		uint64_t last_ticks = 0;
+		for (const auto& scope: frame.scopes) last_ticks = std::max(last_ticks, results[2 * scope.end_query] & profiler.valid_mask[static_cast<size_t>(scope.kind)]);
+		profiler.gpu_to_cpu_offset_ns = now_ns() - static_cast<int64_t>(static_cast<double>(last_ticks) * profiler.timestamp_period);
+		profiler.has_offset = true;
+	}
+
+	for (const auto& scope: frame.scopes)
+	{
+		const uint64_t mask = profiler.valid_mask[static_cast<size_t>(scope.kind)];
+		const uint64_t begin_ticks = results[2 * scope.begin_query] & mask;
+		// the counter may wrap when it has fewer than 64 valid bits.
+		const uint64_t ticks = (results[2 * scope.end_query] - begin_ticks) & mask;
+		const int64_t begin_ns = static_cast<int64_t>(static_cast<double>(begin_ticks) * profiler.timestamp_period) + profiler.gpu_to_cpu_offset_ns;
+		const int64_t end_ns = begin_ns + static_cast<int64_t>(static_cast<double>(ticks) * profiler.timestamp_period);
+		add_event(profiler, {scope.name, static_cast<uint32_t>(scope.kind), scope.depth, begin_ns, end_ns});
+	}
+	return true;
+}
+
+bool vk_profiler_supported(VkPhysicalDevice physical_device, VkPhysicalDeviceHostQueryResetFeatures& enabled_features)
+{
+	enabled_features = {};
+	enabled_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2 || properties.limits.timestampPeriod == 0.0f) return false;
+
+	VkPhysicalDeviceHostQueryResetFeatures features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
+	VkPhysicalDeviceFeatures2 device_features2{};
+	device_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	device_features2.pNext = &features;
+	vkGetPhysicalDeviceFeatures2(physical_device, &device_features2);
+	if (!features.hostQueryReset) return false;
+
+	enabled_features.hostQueryReset = VK_TRUE;
+	return true;
+}
+
+bool vk_profiler_init(
+	vk_profiler_t& profiler,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	vk_scheduler_t& scheduler,
+	uint32_t frames_in_flight,
+	bool calibrated,
+	bool keep_events)
+{
+	profiler.device = device;
+	profiler.scheduler = &scheduler;
+	profiler.keep_events = keep_events;
+	profiler.start_ns = now_ns();
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	profiler.timestamp_period = properties.limits.timestampPeriod;
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+	profiler.valid_mask.fill(0);
+	for (vk_queue_kind_t kind: {vk_queue_kind_t::graphics, vk_queue_kind_t::compute, vk_queue_kind_t::transfer})
+	{
+		const uint32_t valid_bits = queue_families[vk_scheduler_family(scheduler, kind)].timestampValidBits;
+		profiler.valid_mask[static_cast<size_t>(kind)] = valid_bits >= 64 ? ~uint64_t{0} : (uint64_t{1} << valid_bits) - 1;
+	}
+
+	// one more than frames in flight, see the top of vk_profiler.h.
+	profiler.frames.resize(frames_in_flight + 1);
+	for (auto& frame: profiler.frames)
+	{
+		VkQueryPoolCreateInfo query_pool_create_info{};
+		query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		query_pool_create_info.queryCount = vk_profiler_max_queries;
+		if (vkCreateQueryPool(device, &query_pool_create_info, nullptr, &frame.query_pool) != VK_SUCCESS)
+		{
+			fmt::print("[vk] failed to create the profiler query pools.\n");
+			vk_profiler_destroy(profiler);
+			return false;
+		}
+		// queries start out undefined.
+		vkResetQueryPool(device, frame.query_pool, 0, vk_profiler_max_queries);
+	}
+	profiler.frame = static_cast<uint32_t>(profiler.frames.size() - 1);
+
+	if (calibrated)
+	{
+		profiler.get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT"));
+		calibrate(profiler);
+	}
+	fmt::print("[vk] profiler: {} query pools, {:.2f} ns per tick, {}.\n", profiler.frames.size(), profiler.timestamp_period,
+		profiler.has_offset ? fmt::format("calibrated to within {} ns", profiler.max_deviation_ns) : std::string("not calibrated"));
+	return true;
+}
+
+void vk_profiler_destroy(vk_profiler_t& profiler)
+{
+	for (auto& frame: profiler.frames)
+	{
+		if (frame.query_pool) vkDestroyQueryPool(profiler.device, frame.query_pool, nullptr);
+	}
+	profiler.frames.clear();
+	profiler.events.clear();
+	profiler.recording = false;
+}
+
+void vk_profiler_begin_frame(vk_profiler_t& profiler)
+{
+	if (profiler.frames.empty()) return;
+	profiler.frame = (profiler.frame + 1) % static_cast<uint32_t>(profiler.frames.size());
+	for (auto& open: profiler.open_scopes) open.clear();
+
+	if (profiler.get_calibrated_timestamps != nullptr && now_ns() - profiler.calibrated_at_ns > recalibrate_interval_ns) calibrate(profiler);
+
+	vk_profiler_frame_t& frame = profiler.frames[profiler.frame];
+	profiler.recording = collect(profiler, frame);
+	if (!profiler.recording)
+	{
+		// try again when the pool comes around next time.
+		profiler.dropped_frames += 1;
+		return;
+	}
+	if (frame.query_count != 0) vkResetQueryPool(profiler.device, frame.query_pool, 0, frame.query_count);
+	frame.query_count = 0;
+	frame.scopes.clear();
+}
+
+void vk_profiler_begin(vk_profiler_t& profiler, VkCommandBuffer command_buffer, vk_queue_kind_t kind, const char* name)
+{
+	std::vector<uint32_t>& open = profiler.open_scopes[static_cast<size_t>(kind)];
+	// the scope is still pushed when it is not timed, so the end that goes with it matches up.
+	const bool timed = profiler.recording && profiler.valid_mask[static_cast<size_t>(kind)] != 0 &&
+		profiler.frames[profiler.frame].query_count + 2 <= vk_profiler_max_queries;
+	if (!timed)
+	{
+		open.push_back(UINT32_MAX);
+		return;
+	}
+	vk_profiler_frame_t& frame = profiler.frames[profiler.frame];
+
+	vk_profiler_scope_t scope{};
+	scope.name = name;
+	scope.kind = kind;
+	scope.depth = static_cast<uint32_t>(open.size());
+	scope.begin_query = frame.query_count++;
+	// the end query is taken now as well; nested scopes get the ones after it.
+	scope.end_query = frame.query_count++;
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.query_pool, scope.begin_query);
+	open.push_back(static_cast<uint32_t>(frame.scopes.size()));
+	frame.scopes.push_back(scope);
+}
+
+void vk_profiler_end(vk_profiler_t& profiler, VkCommandBuffer command_buffer, vk_queue_kind_t kind)
+{
+	std::vector<uint32_t>& open = profiler.open_scopes[static_cast<size_t>(kind)];
+	if (open.empty()) return;
+	const uint32_t scope_index = open.back();
+	open.pop_back();
+	if (scope_index == UINT32_MAX) return;
+
+	vk_profiler_frame_t& frame = profiler.frames[profiler.frame];
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.query_pool, frame.scopes[scope_index].end_query);
+}
+
+void vk_profiler_cpu_begin(vk_profiler_t& profiler, const char* name)
+{
+	profiler.open_cpu_scopes.push_back({name, now_ns()});
+}
+
+void vk_profiler_cpu_end(vk_profiler_t& profiler)
+{
+	if (profiler.open_cpu_scopes.empty()) return;
+	const vk_profiler_open_cpu_scope_t scope = profiler.open_cpu_scopes.back();
+	profiler.open_cpu_scopes.pop_back();
+	add_event(profiler, {scope.name, vk_profiler_cpu_track, static_cast<uint32_t>(profiler.open_cpu_scopes.size()), scope.begin_ns, now_ns()});
+}
+
+bool vk_profiler_write_trace(const vk_profiler_t& profiler, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) return false;
+
+	// a thread name per track, then complete ("X") events in microseconds since the profiler
+	// started. Scope names are string literals: nothing to escape.
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (uint32_t track = 0; track != std::size(track_names); ++track)
+	{
+		json += fmt::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}", track == 0 ? "" : ",\n", track, track_names[track]);
+	}
+	for (const vk_profiler_event_t& event: profiler.events)
+	{
+		json += fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"depth\":{}}}}}",
+			event.name, event.track == vk_profiler_cpu_track ? "cpu" : "gpu", event.track,
+			static_cast<double>(event.begin_ns - profiler.start_ns) * 1e-3, static_cast<double>(event.end_ns - event.begin_ns) * 1e-3, event.depth);
+	}
+	json += "\n]}\n";
+
+	bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
+
+void vk_profiler_report(const vk_profiler_t& profiler)
+{
+	std::vector<const std::pair<const std::string, vk_profiler_stat_t>*> sorted;
+	for (const auto& entry: profiler.stats) sorted.push_back(&entry);
+	std::sort(sorted.begin(), sorted.end(), [](auto lhs, auto rhs) { return lhs->first < rhs->first; });
+	for (const auto* entry: sorted)
+	{
+		const vk_profiler_stat_t& stat = entry->second;
+		fmt::print("[profiler] {}: mean {:.3f} ms, max {:.3f} ms over {}.\n", entry->first, stat.total_ms / stat.count, stat.max_ms, stat.count);
+	}
+	if (profiler.dropped_frames != 0) fmt::print("[profiler] {} frames were dropped (queries not ready).\n", profiler.dropped_frames);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+// gpu profiler: named, nested scopes timed with vkCmdWriteTimestamp, plus cpu scopes on the same
+// timeline, exportable as a chrome trace (chrome://tracing, or ui.perfetto.dev).
+//
+// every profiler frame has its own timestamp query pool, in a ring of frames_in_flight + 1: by the
+// time a pool comes around again, the graphics frame that used it is done (vk_frames_begin waited
+// for it), and so is the compute step it timed (the next graphics frame waited for that one). Its
+// results are read without waiting and the pool is reset from the host (hostQueryReset, core in
+// vulkan 1.2). If a query is still not available the frame is dropped instead of waited for.
+//
+// gpu timestamps are in device ticks. With VK_EXT_calibrated_timestamps the profiler samples the
+// device clock and the host clock (the one std::chrono::steady_clock uses) together, about once a
+// second, and maps every gpu time onto the cpu timeline. Without it the two are lined up once, at
+// the first frame that is read back, which is only good to within a frame or so.
+//
+// only one thread (the one recording the frame's primary command buffers) uses the profiler.
+
+#include <vulkan/vulkan.h>
+
+#include "vk_scheduler.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t vk_profiler_max_queries = 256;
+// beyond this the trace stops growing (the summary keeps counting).
+const size_t vk_profiler_max_events = 1 << 20;
+
+// the trace has one track for the cpu and one per queue kind.
+const uint32_t vk_profiler_cpu_track = static_cast<uint32_t>(vk_queue_kind_t::count);
+
+struct vk_profiler_scope_t
+{
+	const char* name;
+	vk_queue_kind_t kind;
+	uint32_t depth;
+	uint32_t begin_query;
+	uint32_t end_query;
+};
+
+struct vk_profiler_frame_t
+{
+	VkQueryPool query_pool;
+	uint32_t query_count;
+	// in the order they were begun.
+	std::vector<vk_profiler_scope_t> scopes;
+};
+
+// a finished scope, on the cpu timeline.
+struct vk_profiler_event_t
+{
+	const char* name;
+	uint32_t track;
+	uint32_t depth;
+	// steady_clock nanoseconds.
+	int64_t begin_ns;
+	int64_t end_ns;
+};
+
+struct vk_profiler_stat_t
+{
+	double total_ms;
+	double max_ms;
+	uint64_t count;
+};
+
+struct vk_profiler_open_cpu_scope_t
+{
+	const char* name;
+	int64_t begin_ns;
+};
+
+struct vk_profiler_t
+{
+	VkDevice device;
+	vk_scheduler_t* scheduler;
+	// nanoseconds per tick.
+	double timestamp_period;
+	// per queue kind; 0 when the family has no timestamps.
+	std::array<uint64_t, static_cast<size_t>(vk_queue_kind_t::count)> valid_mask;
+
+	std::vector<vk_profiler_frame_t> frames;
+	uint32_t frame;
+	// false outside begin_frame (or when the frame's pool could not be reset): scopes do nothing.
+	bool recording;
+	// the scopes that are open, per queue kind, as indices into the frame's scopes.
+	std::array<std::vector<uint32_t>, static_cast<size_t>(vk_queue_kind_t::count)> open_scopes;
+	std::vector<vk_profiler_open_cpu_scope_t> open_cpu_scopes;
+
+	// gpu nanoseconds + offset = cpu nanoseconds.
+	PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps;
+	bool has_offset;
+	int64_t gpu_to_cpu_offset_ns;
+	int64_t calibrated_at_ns;
+	// the deviation vkGetCalibratedTimestampsEXT reported last time.
+	uint64_t max_deviation_ns;
+
+	// kept only when a trace is wanted.
+	bool keep_events;
+	std::vector<vk_profiler_event_t> events;
+	// keyed by track and name.
+	std::unordered_map<std::string, vk_profiler_stat_t> stats;
+	int64_t start_ns;
+	uint64_t dropped_frames;
+};
+
+// true when the device can reset queries from the host. Fills in the features to enable at device
+// creation (chain it into VkDeviceCreateInfo::pNext).
+bool vk_profiler_supported(VkPhysicalDevice physical_device, VkPhysicalDeviceHostQueryResetFeatures& enabled_features);
+
+// calibrated: VK_EXT_calibrated_timestamps is enabled on the device. keep_events: for
+// vk_profiler_write_trace, otherwise only the summary is kept.
+bool vk_profiler_init(
+	vk_profiler_t& profiler,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	vk_scheduler_t& scheduler,
+	uint32_t frames_in_flight,
+	bool calibrated,
+	bool keep_events);
+void vk_profiler_destroy(vk_profiler_t& profiler);
+
+// once per frame, before anything is recorded: collects the results of the frame that used the
+// pool last and resets it.
+void vk_profiler_begin_frame(vk_profiler_t& profiler);
+
+// gpu scopes, in a command buffer for a queue of the given kind. They nest per kind; the name has
+// to outlive the profiler (a string literal).
+void vk_profiler_begin(vk_profiler_t& profiler, VkCommandBuffer command_buffer, vk_queue_kind_t kind, const char* name);
+void vk_profiler_end(vk_profiler_t& profiler, VkCommandBuffer command_buffer, vk_queue_kind_t kind);
+
+// cpu scopes, on the same timeline.
+void vk_profiler_cpu_begin(vk_profiler_t& profiler, const char* name);
+void vk_profiler_cpu_end(vk_profiler_t& profiler);
+
+// every gpu and cpu scope that was collected, as chrome trace event json.
+bool vk_profiler_write_trace(const vk_profiler_t& profiler, const char* path);
+// the mean and max time of every scope.
+void vk_profiler_report(const vk_profiler_t& profiler);
@@ -0,0 +1,114 @@
+#include "vk_recorder.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+// a secondary command buffer from the pool of the thread we are running on.
+static VkCommandBuffer next_command_buffer(vk_recorder_t& recorder)
+{
+	vk_thread_commands_t& thread = recorder.threads[recorder.slot * recorder.thread_count + job_thread_index()];
+	if (thread.used == thread.command_buffers.size())
+	{
+		VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+		command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		command_buffer_allocate_info.commandPool = thread.command_pool;
+		command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		command_buffer_allocate_info.commandBufferCount = 1;
+		VkCommandBuffer command_buffer{};
+		if (vkAllocateCommandBuffers(recorder.device, &command_buffer_allocate_info, &command_buffer) != VK_SUCCESS) return VK_NULL_HANDLE;
+		thread.command_buffers.push_back(command_buffer);
+	}
+	return thread.command_buffers[thread.used++];
+}
+
+bool vk_recorder_init(vk_recorder_t& recorder, VkDevice device, job_system_t& job_system, uint32_t queue_family, uint32_t frame_count)
+{
+	recorder = {};
+	recorder.device = device;
+	recorder.job_system = &job_system;
+	recorder.thread_count = static_cast<uint32_t>(job_system.thread_count);
+	recorder.threads.resize(size_t{frame_count} * recorder.thread_count);
+
+	for (auto& thread: recorder.threads)
+	{
+		// transient: everything recorded from it is thrown away after one frame.
+		VkCommandPoolCreateInfo command_pool_create_info{};
+		command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		command_pool_create_info.queueFamilyIndex = queue_family;
+		if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &thread.command_pool) != VK_SUCCESS)
+		{
+			fmt::print("[vk] failed to create the recording command pools.\n");
+			vk_recorder_destroy(recorder);
+			return false;
+		}
+	}
+
+	fmt::print("[vk] recording on {} threads, {} command pools.\n", recorder.thread_count, recorder.threads.size());
+	return true;
+}
+
+void vk_recorder_destroy(vk_recorder_t& recorder)
+{
+	// frees the command buffers as well.
+	for (auto& thread: recorder.threads)
+	{
+		if (thread.command_pool) vkDestroyCommandPool(recorder.device, thread.command_pool, nullptr);
+	}
+	recorder = {};
+}
+
+void vk_recorder_begin_frame(vk_recorder_t& recorder, uint32_t slot)
+{
+	recorder.slot = slot;
+	for (uint32_t thread_idx = 0; thread_idx != recorder.thread_count; ++thread_idx)
+	{
+		vk_thread_commands_t& thread = recorder.threads[slot * recorder.thread_count + thread_idx];
+		if (thread.used == 0) continue;
+		vkResetCommandPool(recorder.device, thread.command_pool, 0);
+		thread.used = 0;
+	}
+}
+
+void vk_recorder_record(
+	vk_recorder_t& recorder,
+	VkCommandBuffer primary,
+	VkRenderPass render_pass,
+	VkFramebuffer framebuffer,
+	size_t count,
+	size_t chunk_size,
+	const vk_record_fn_t& fn)
+{
+	if (count == 0) return;
+	const size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+	recorder.chunk_command_buffers.assign(chunk_count, VK_NULL_HANDLE);
+
+	VkCommandBufferInheritanceInfo inheritance_info{};
+	inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance_info.renderPass = render_pass;
+	inheritance_info.subpass = 0;
+	inheritance_info.framebuffer = framebuffer;
+
+	parallel_for(*recorder.job_system, count, chunk_size, [&](size_t chunk_index, size_t begin, size_t end)
+	{
+		VkCommandBuffer command_buffer = next_command_buffer(recorder);
+		if (command_buffer == VK_NULL_HANDLE) return;
+
+		VkCommandBufferBeginInfo begin_info{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		begin_info.pInheritanceInfo = &inheritance_info;
+		vkBeginCommandBuffer(command_buffer, &begin_info);
+		fn(command_buffer, begin, end);
+		vkEndCommandBuffer(command_buffer);
+		recorder.chunk_command_buffers[chunk_index] = command_buffer;
+	});
+
+	// a chunk that could not get a command buffer is left out rather than executed half recorded.
+	uint32_t recorded = 0;
+	for (VkCommandBuffer command_buffer: recorder.chunk_command_buffers)
+	{
+		if (command_buffer != VK_NULL_HANDLE) recorder.chunk_command_buffers[recorded++] = command_buffer;
+	}
+	if (recorded != 0) vkCmdExecuteCommands(primary, recorded, recorder.chunk_command_buffers.data());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// records a render pass's draws on all cores, into secondary command buffers.
+//
+// every (frame slot, job thread) pair has its own command pool, so recording never takes a lock:
+// a pool is only ever touched by its own thread, and only while its frame slot is being recorded.
+// The secondary command buffers are allocated once and kept; beginning a frame resets the slot's
+// pools in one go (vkResetCommandPool), which is much cheaper than freeing buffers one by one.
+//
+// vk_recorder_record splits the draws into chunks with parallel_for, records every chunk into its
+// own secondary command buffer (on whichever thread runs it), and executes them from the primary
+// command buffer in chunk order, so the result does not depend on the thread count.
+
+#include <vulkan/vulkan.h>
+
+#include "job_system.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// fn(command_buffer, begin, end): records draws [begin, end) into a secondary command buffer that
+// continues the render pass.
+using vk_record_fn_t = std::function<void(VkCommandBuffer, size_t, size_t)>;
+
+struct vk_thread_commands_t
+{
+	VkCommandPool command_pool;
+	std::vector<VkCommandBuffer> command_buffers;
+	// handed out since the last reset.
+	uint32_t used;
+};
+
+struct vk_recorder_t
+{
+	VkDevice device;
+	job_system_t* job_system;
+	uint32_t thread_count;
+	// [slot * thread_count + thread].
+	std::vector<vk_thread_commands_t> threads;
+	// the slot that is being recorded.
+	uint32_t slot;
+	// the secondary command buffer of every chunk, in chunk order. Only used by the recording thread.
+	std::vector<VkCommandBuffer> chunk_command_buffers;
+};
+
+// the command pools are made for queue_family; one per job system thread per frame slot.
+bool vk_recorder_init(vk_recorder_t& recorder, VkDevice device, job_system_t& job_system, uint32_t queue_family, uint32_t frame_count);
+void vk_recorder_destroy(vk_recorder_t& recorder);
+
+// resets the slot's command pools. The frame that recorded the slot before has to be done
+// (vk_frames_begin makes sure of that).
+void vk_recorder_begin_frame(vk_recorder_t& recorder, uint32_t slot);
+
+// inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: records [0, count)
+// in chunks of chunk_size in parallel, and executes them from primary. framebuffer may be
+// VK_NULL_HANDLE (it only helps the driver).
+void vk_recorder_record(
+	vk_recorder_t& recorder,
+	VkCommandBuffer primary,
+	VkRenderPass render_pass,
+	VkFramebuffer framebuffer,
+	size_t count,
+	size_t chunk_size,
+	const vk_record_fn_t& fn);
@@ -0,0 +1,572 @@
+#include "vk_render_graph.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm>
+
+struct usage_info_t
+{
+	VkPipelineStageFlags stage;
+	VkAccessFlags access;
+	// only for images.
+	VkImageLayout layout;
+	bool write;
+	// what a transient image has to be created with.
+	VkImageUsageFlags image_usage;
+};
+
+// indexed by vk_render_graph_usage_t.
+static const usage_info_t usage_infos[] = {
+	{0, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, 0},
+	{VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0},
+	{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, VK_IMAGE_USAGE_STORAGE_BIT},
+	{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true, VK_IMAGE_USAGE_STORAGE_BIT},
+	{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT},
+	{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT},
+	{VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT},
+	{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT},
+	{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT},
+	{VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, 0},
+	{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false, 0},
+};
+
+const VkAccessFlags write_access_mask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+static const usage_info_t& usage_info(vk_render_graph_usage_t usage)
+{
+	return usage_infos[static_cast<size_t>(usage)];
+}
+
+// where a resource is, while the barriers are planned.
+struct resource_state_t
+{
+	VkImageLayout layout;
+	// the last write, and the stages that read since.
+	VkPipelineStageFlags write_stage;
+	VkAccessFlags write_access;
+	VkPipelineStageFlags read_stages;
+	// what the last write is visible to already.
+	VkPipelineStageFlags visible_stages;
+	VkAccessFlags visible_access;
+};
+
+static void add_dependency(vk_render_graph_barrier_t& barrier, VkPipelineStageFlags src_stage, VkAccessFlags src_access, const usage_info_t& info)
+{
+	barrier.src_stage |= src_stage;
+	barrier.dst_stage |= info.stage;
+	barrier.src_access |= src_access;
+	barrier.dst_access |= info.access;
+}
+
+// adds what the use needs to the barrier before it, and moves the resource along.
+static void use_resource(const vk_render_graph_resource_t& resource, uint32_t resource_idx, resource_state_t& state, const usage_info_t& info, vk_render_graph_barrier_t& barrier)
+{
+	if (resource.is_image && info.layout != state.layout)
+	{
+		// waits for the readers and the writer, whatever the use is: the transition writes.
+		VkImageMemoryBarrier image_barrier{};
+		image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		image_barrier.srcAccessMask = state.write_access;
+		image_barrier.dstAccessMask = info.access;
+		image_barrier.oldLayout = state.layout;
+		image_barrier.newLayout = info.layout;
+		image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.subresourceRange = {resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+		barrier.image_barriers.push_back(image_barrier);
+		barrier.image_resources.push_back(resource_idx);
+		barrier.src_stage |= state.write_stage | state.read_stages;
+		barrier.dst_stage |= info.stage;
+
+		state.layout = info.layout;
+		state.write_stage = info.stage;
+		state.write_access = info.write ? (info.access & write_access_mask) : 0;
+		state.read_stages = info.write ? 0 : info.stage;
+		state.visible_stages = info.write ? 0 : info.stage;
+		state.visible_access = info.write ? 0 : info.access;
+	}
+	else if (info.write)
+	{
+		// write after write, or after read: only the readers' stages are waited for.
+		if ((state.write_stage | state.read_stages) != 0) add_dependency(barrier, state.write_stage | state.read_stages, state.write_access, info);
+		state.write_stage = info.stage;
+		state.write_access = info.access & write_access_mask;
+		state.read_stages = 0;
+		state.visible_stages = 0;
+		state.visible_access = 0;
+	}
+	else
+	{
+		// read after write, unless an earlier barrier made the write visible to this read already.
+		const bool visible = (info.stage & ~state.visible_stages) == 0 && (info.access & ~state.visible_access) == 0;
+		if (state.write_stage != 0 && !visible)
+		{
+			add_dependency(barrier, state.write_stage, state.write_access, info);
+			state.visible_stages |= info.stage;
+			state.visible_access |= info.access;
+		}
+		state.read_stages |= info.stage;
+	}
+}
+
+static resource_state_t state_after(const usage_info_t& info, bool discard)
+{
+	resource_state_t state{};
+	state.layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : info.layout;
+	if (info.write)
+	{
+		state.write_stage = info.stage;
+		state.write_access = info.access & write_access_mask;
+	}
+	else
+	{
+		state.read_stages = info.stage;
+	}
+	return state;
+}
+
+static bool memory_overlaps(const vk_render_graph_resource_t& lhs, const vk_render_graph_resource_t& rhs)
+{
+	return lhs.offset < rhs.offset + rhs.size && rhs.offset < lhs.offset + lhs.size;
+}
+
+static bool lifetime_overlaps(const vk_render_graph_resource_t& lhs, const vk_render_graph_resource_t& rhs)
+{
+	return lhs.first_pass <= rhs.last_pass && rhs.first_pass <= lhs.last_pass;
+}
+
+static bool is_live_transient(const vk_render_graph_resource_t& resource)
+{
+	return resource.transient && resource.first_pass != UINT32_MAX;
+}
+
+// the barriers of the live passes, from the given states at the start of the frame. Leaves the
+// states at the end of the frame.
+static void plan_barriers(vk_render_graph_t& graph, std::vector<resource_state_t>& states)
+{
+	for (auto& pass: graph.passes)
+	{
+		pass.barrier = {};
+		if (pass.culled) continue;
+		for (const auto& use: pass.uses)
+		{
+			use_resource(graph.resources[use.resource], use.resource, states[use.resource], usage_info(use.usage), pass.barrier);
+		}
+	}
+
+	graph.final_barrier = {};
+	for (uint32_t idx = 0; idx != graph.resources.size(); ++idx)
+	{
+		const vk_render_graph_resource_t& resource = graph.resources[idx];
+		if (resource.transient || resource.after == vk_render_graph_usage_t::none) continue;
+		use_resource(resource, idx, states[idx], usage_info(resource.after), graph.final_barrier);
+	}
+}
+
+static void destroy_transients(vk_render_graph_t& graph)
+{
+	VkDevice device = graph.allocator->device;
+	for (auto& resource: graph.resources)
+	{
+		if (!resource.transient) continue;
+		if (resource.view) vkDestroyImageView(device, resource.view, nullptr);
+		if (resource.image) vkDestroyImage(device, resource.image, nullptr);
+		resource.view = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+	}
+	if (graph.transient_allocation.memory) vk_allocator_free(*graph.allocator, graph.transient_allocation);
+	graph.transient_allocation = {};
+}
+
+// a pass lives when it has side effects or writes something that lives on after the frame, or a
+// transient that a later live pass uses. Walked back to front, so that is known when we get there.
+static void cull_passes(vk_render_graph_t& graph)
+{
+	std::vector<bool> needed(graph.resources.size(), false);
+	graph.culled_count = 0;
+	for (size_t pass_idx = graph.passes.size(); pass_idx-- != 0;)
+	{
+		vk_render_graph_pass_t& pass = graph.passes[pass_idx];
+		bool live = pass.side_effects;
+		for (const auto& use: pass.uses)
+		{
+			const vk_render_graph_resource_t& resource = graph.resources[use.resource];
+			if (usage_info(use.usage).write && (!resource.transient || needed[use.resource])) live = true;
+		}
+		pass.culled = !live;
+		if (!live)
+		{
+			graph.culled_count += 1;
+			continue;
+		}
+		// a write may be partial (or load what was there), so the writers before it are kept too.
+		for (const auto& use: pass.uses) needed[use.resource] = true;
+	}
+}
+
+// biggest first, each at the lowest offset that is free while it lives.
+static void place_transients(vk_render_graph_t& graph, const std::vector<VkMemoryRequirements>& requirements)
+{
+	std::vector<uint32_t> order;
+	for (uint32_t idx = 0; idx != graph.resources.size(); ++idx)
+	{
+		if (is_live_transient(graph.resources[idx])) order.push_back(idx);
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return requirements[lhs].size > requirements[rhs].size; });
+
+	std::vector<uint32_t> placed;
+	graph.transient_size = 0;
+	graph.transient_size_unaliased = 0;
+	for (uint32_t idx: order)
+	{
+		vk_render_graph_resource_t& resource = graph.resources[idx];
+		const VkDeviceSize alignment = requirements[idx].alignment;
+		resource.size = requirements[idx].size;
+		graph.transient_size_unaliased += resource.size;
+
+		// the lowest offset is either 0 or right after something that is alive at the same time.
+		std::vector<VkDeviceSize> candidates = {0};
+		for (uint32_t other: placed)
+		{
+			const vk_render_graph_resource_t& placed_resource = graph.resources[other];
+			if (lifetime_overlaps(resource, placed_resource))
+			{
+				candidates.push_back((placed_resource.offset + placed_resource.size + alignment - 1) / alignment * alignment);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (VkDeviceSize candidate: candidates)
+		{
+			resource.offset = candidate;
+			bool fits = true;
+			for (uint32_t other: placed)
+			{
+				const vk_render_graph_resource_t& placed_resource = graph.resources[other];
+				if (lifetime_overlaps(resource, placed_resource) && memory_overlaps(resource, placed_resource)) fits = false;
+			}
+			if (fits) break;
+		}
+		placed.push_back(idx);
+		graph.transient_size = std::max(graph.transient_size, resource.offset + resource.size);
+	}
+}
+
+static bool create_transients(vk_render_graph_t& graph)
+{
+	VkDevice device = graph.allocator->device;
+	std::vector<VkMemoryRequirements> requirements(graph.resources.size());
+	VkMemoryRequirements total{};
+	total.alignment = 1;
+	total.memoryTypeBits = UINT32_MAX;
+	bool any = false;
+
+	for (uint32_t idx = 0; idx != graph.resources.size(); ++idx)
+	{
+		vk_render_graph_resource_t& resource = graph.resources[idx];
+		if (!is_live_transient(resource)) continue;
+
+		VkImageUsageFlags usage = 0;
+		for (const auto& pass: graph.passes)
+		{
+			if (pass.culled) continue;
+			for (const auto& use: pass.uses)
+			{
+				if (use.resource == idx) usage |= usage_info(use.usage).image_usage;
+			}
+		}
+
+		VkImageCreateInfo image_create_info{};
+		image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_create_info.imageType = VK_IMAGE_TYPE_2D;
+		image_create_info.format = resource.format;
+		image_create_info.extent = {resource.extent.width, resource.extent.height, 1};
+		image_create_info.mipLevels = 1;
+		image_create_info.arrayLayers = 1;
+		image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_create_info.usage = usage;
+		image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(device, &image_create_info, nullptr, &resource.image) != VK_SUCCESS)
+		{
+			fmt::print("[vk] render graph: failed to create transient image {}.\n", resource.name);
+			return false;
+		}
+		vkGetImageMemoryRequirements(device, resource.image, &requirements[idx]);
+		total.alignment = std::max(total.alignment, requirements[idx].alignment);
+		total.memoryTypeBits &= requirements[idx].memoryTypeBits;
+		any = true;
+	}
+	if (!any) return true;
+
+	place_transients(graph, requirements);
+	total.size = graph.transient_size;
+	// every transient has to fit in the one allocation.
+	if (total.memoryTypeBits == 0 || !vk_allocator_allocate(*graph.allocator, total, vk_memory_usage_t::gpu_only, true, false, graph.transient_allocation))
+	{
+		fmt::print("[vk] render graph: failed to allocate {} bytes for the transient images.\n", total.size);
+		return false;
+	}
+
+	for (auto& resource: graph.resources)
+	{
+		if (!is_live_transient(resource)) continue;
+		if (vkBindImageMemory(device, resource.image, graph.transient_allocation.memory, graph.transient_allocation.offset + resource.offset) != VK_SUCCESS)
+		{
+			fmt::print("[vk] render graph: failed to bind transient image {}.\n", resource.name);
+			return false;
+		}
+
+		VkImageViewCreateInfo view_create_info{};
+		view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_create_info.image = resource.image;
+		view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_create_info.format = resource.format;
+		view_create_info.subresourceRange = {resource.aspect, 0, 1, 0, 1};
+		if (vkCreateImageView(device, &view_create_info, nullptr, &resource.view) != VK_SUCCESS)
+		{
+			fmt::print("[vk] render graph: failed to create the view of transient image {}.\n", resource.name);
+			return false;
+		}
+	}
+	return true;
+}
+
+// what the aliasing promises: transients that share memory are never alive at the same time, and
+// the first use of each waits for the last use of everything else in its memory.
+static bool check_aliasing(const vk_render_graph_t& graph, const std::vector<resource_state_t>& end_states)
+{
+	for (uint32_t idx = 0; idx != graph.resources.size(); ++idx)
+	{
+		const vk_render_graph_resource_t& resource = graph.resources[idx];
+		if (!is_live_transient(resource)) continue;
+
+		const vk_render_graph_barrier_t& barrier = graph.passes[resource.first_pass].barrier;
+		const auto it = std::find(barrier.image_resources.begin(), barrier.image_resources.end(), idx);
+		if (it == barrier.image_resources.end() || barrier.image_barriers[it - barrier.image_resources.begin()].oldLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+		{
+			fmt::print("[vk] render graph: transient image {} is not discarded before its first use.\n", resource.name);
+			return false;
+		}
+		const VkAccessFlags src_access = barrier.image_barriers[it - barrier.image_resources.begin()].srcAccessMask;
+
+		for (uint32_t other = 0; other != graph.resources.size(); ++other)
+		{
+			const vk_render_graph_resource_t& other_resource = graph.resources[other];
+			if (!is_live_transient(other_resource) || !memory_overlaps(resource, other_resource)) continue;
+			if (other != idx && lifetime_overlaps(resource, other_resource))
+			{
+				fmt::print("[vk] render graph: transient images {} and {} share memory while both are alive.\n", resource.name, other_resource.name);
+				return false;
+			}
+			const VkPipelineStageFlags last_stages = end_states[other].write_stage | end_states[other].read_stages;
+			if ((last_stages & ~barrier.src_stage) != 0 || (end_states[other].write_access & ~src_access) != 0)
+			{
+				fmt::print("[vk] render graph: the first use of {} does not wait for the last use of {}.\n", resource.name, other_resource.name);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void record_barrier(const vk_render_graph_t& graph, VkCommandBuffer command_buffer, vk_render_graph_barrier_t& barrier)
+{
+	if (barrier.dst_stage == 0) return;
+
+	VkMemoryBarrier memory_barrier{};
+	memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memory_barrier.srcAccessMask = barrier.src_access;
+	memory_barrier.dstAccessMask = barrier.dst_access;
+	const uint32_t memory_barrier_count = (barrier.src_access | barrier.dst_access) != 0 ? 1 : 0;
+	for (size_t idx = 0; idx != barrier.image_barriers.size(); ++idx)
+	{
+		barrier.image_barriers[idx].image = graph.resources[barrier.image_resources[idx]].image;
+	}
+
+	// nothing to wait for is the top of the pipe.
+	const VkPipelineStageFlags src_stage = barrier.src_stage != 0 ? barrier.src_stage : VkPipelineStageFlags{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+	vkCmdPipelineBarrier(command_buffer, src_stage, barrier.dst_stage, 0, memory_barrier_count, &memory_barrier, 0, nullptr,
+		static_cast<uint32_t>(barrier.image_barriers.size()), barrier.image_barriers.data());
+}
+
+void vk_render_graph_init(vk_render_graph_t& graph, vk_allocator_t& allocator)
+{
+	graph = {};
+	graph.allocator = &allocator;
+}
+
+void vk_render_graph_destroy(vk_render_graph_t& graph)
+{
+	destroy_transients(graph);
+	graph.passes.clear();
+	graph.resources.clear();
+	graph.compiled = false;
+}
+
+static uint32_t add_resource(vk_render_graph_t& graph, const vk_render_graph_resource_t& resource)
+{
+	graph.resources.push_back(resource);
+	graph.compiled = false;
+	return static_cast<uint32_t>(graph.resources.size() - 1);
+}
+
+uint32_t vk_render_graph_import_buffer(vk_render_graph_t& graph, const char* name, vk_render_graph_usage_t before, vk_render_graph_usage_t after)
+{
+	vk_render_graph_resource_t resource{};
+	resource.name = name;
+	resource.before = before;
+	resource.after = after;
+	return add_resource(graph, resource);
+}
+
+uint32_t vk_render_graph_import_image(vk_render_graph_t& graph, const char* name, VkImageAspectFlags aspect, vk_render_graph_usage_t before, vk_render_graph_usage_t after, bool discard)
+{
+	vk_render_graph_resource_t resource{};
+	resource.name = name;
+	resource.is_image = true;
+	resource.aspect = aspect;
+	resource.before = before;
+	resource.after = after;
+	resource.discard = discard;
+	return add_resource(graph, resource);
+}
+
+uint32_t vk_render_graph_create_image(vk_render_graph_t& graph, const char* name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect)
+{
+	vk_render_graph_resource_t resource{};
+	resource.name = name;
+	resource.is_image = true;
+	resource.transient = true;
+	resource.aspect = aspect;
+	resource.discard = true;
+	resource.format = format;
+	resource.extent = extent;
+	return add_resource(graph, resource);
+}
+
+uint32_t vk_render_graph_add_pass(vk_render_graph_t& graph, const char* name, vk_render_graph_record_fn_t record, bool side_effects)
+{
+	vk_render_graph_pass_t pass{};
+	pass.name = name;
+	pass.record = std::move(record);
+	pass.side_effects = side_effects;
+	graph.passes.push_back(std::move(pass));
+	graph.compiled = false;
+	return static_cast<uint32_t>(graph.passes.size() - 1);
+}
+
+void vk_render_graph_use(vk_render_graph_t& graph, uint32_t pass, uint32_t resource, vk_render_graph_usage_t usage)
+{
+	graph.passes[pass].uses.push_back({resource, usage});
+	graph.compiled = false;
+}
+
+bool vk_render_graph_compile(vk_render_graph_t& graph)
+{
+	destroy_transients(graph);
+	cull_passes(graph);
+
+	for (auto& resource: graph.resources)
+	{
+		resource.first_pass = UINT32_MAX;
+		resource.last_pass = 0;
+	}
+	for (uint32_t pass_idx = 0; pass_idx != graph.passes.size(); ++pass_idx)
+	{
+		if (graph.passes[pass_idx].culled) continue;
+		for (const auto& use: graph.passes[pass_idx].uses)
+		{
+			vk_render_graph_resource_t& resource = graph.resources[use.resource];
+			resource.first_pass = std::min(resource.first_pass, pass_idx);
+			resource.last_pass = std::max(resource.last_pass, pass_idx);
+		}
+	}
+	if (!create_transients(graph))
+	{
+		destroy_transients(graph);
+		return false;
+	}
+
+	// the imported resources start where the frame before left them.
+	std::vector<resource_state_t> initial_states(graph.resources.size());
+	for (uint32_t idx = 0; idx != graph.resources.size(); ++idx)
+	{
+		const vk_render_graph_resource_t& resource = graph.resources[idx];
+		if (!resource.transient) initial_states[idx] = state_after(usage_info(resource.before), resource.discard);
+	}
+
+	// a transient starts out waiting for the last use of everything that shares its memory, this
+	// frame or the one before. That is only known after one pass over the frame.
+	std::vector<resource_state_t> end_states = initial_states;
+	plan_barriers(graph, end_states);
+	for (uint32_t idx = 0; idx != graph.resources.size(); ++idx)
+	{
+		const vk_render_graph_resource_t& resource = graph.resources[idx];
+		if (!is_live_transient(resource)) continue;
+		for (uint32_t other = 0; other != graph.resources.size(); ++other)
+		{
+			if (!is_live_transient(graph.resources[other]) || !memory_overlaps(resource, graph.resources[other])) continue;
+			initial_states[idx].read_stages |= end_states[other].write_stage | end_states[other].read_stages;
+			initial_states[idx].write_access |= end_states[other].write_access;
+		}
+	}
+	std::vector<resource_state_t> states = initial_states;
+	plan_barriers(graph, states);
+	if (!check_aliasing(graph, end_states))
+	{
+		destroy_transients(graph);
+		return false;
+	}
+
+	graph.barrier_count = graph.final_barrier.dst_stage != 0 ? 1 : 0;
+	uint32_t transient_count = 0;
+	for (const auto& pass: graph.passes)
+	{
+		if (pass.barrier.dst_stage != 0) graph.barrier_count += 1;
+	}
+	for (const auto& resource: graph.resources)
+	{
+		if (is_live_transient(resource)) transient_count += 1;
+	}
+	graph.compiled = true;
+
+	fmt::print("[vk] render graph: {} passes ({} culled), {} barriers per frame, {} transient images in {:.1f} MiB ({:.1f} MiB without aliasing).\n",
+		graph.passes.size(), graph.culled_count, graph.barrier_count, transient_count, graph.transient_size / 1048576.0, graph.transient_size_unaliased / 1048576.0);
+	return true;
+}
+
+void vk_render_graph_set_buffer(vk_render_graph_t& graph, uint32_t resource, VkBuffer buffer)
+{
+	graph.resources[resource].buffer = buffer;
+}
+
+void vk_render_graph_set_image(vk_render_graph_t& graph, uint32_t resource, VkImage image)
+{
+	graph.resources[resource].image = image;
+}
+
+VkImage vk_render_graph_image(const vk_render_graph_t& graph, uint32_t resource)
+{
+	return graph.resources[resource].image;
+}
+
+VkImageView vk_render_graph_image_view(const vk_render_graph_t& graph, uint32_t resource)
+{
+	return graph.resources[resource].view;
+}
+
+void vk_render_graph_execute(vk_render_graph_t& graph, VkCommandBuffer command_buffer, vk_profiler_t* profiler)
+{
+	for (auto& pass: graph.passes)
+	{
+		if (pass.culled) continue;
+		record_barrier(graph, command_buffer, pass.barrier);
+		if (profiler != nullptr) vk_profiler_begin(*profiler, command_buffer, vk_queue_kind_t::graphics, pass.name);
+		pass.record(command_buffer);
+		if (profiler != nullptr) vk_profiler_end(*profiler, command_buffer, vk_queue_kind_t::graphics);
+	}
+	record_barrier(graph, command_buffer, graph.final_barrier);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+// frame render graph: the frame is a list of passes, and every pass says which resources it uses
+// and how (vk_render_graph_usage_t). The graph is built and compiled once, then executed into the
+// frame's command buffer every frame. Compiling:
+//
+// - culls the passes nothing needs: a pass lives when it has side effects, or writes an imported
+//   resource (those live on after the frame), or a transient that a live pass uses later.
+// - plans the barriers: one vkCmdPipelineBarrier before each pass at most, with only the stages
+//   and accesses that really conflict. Reads after reads need nothing, a second read in the same
+//   stage after a write needs nothing; images get a layout transition only when the layout changes,
+//   buffers share one global memory barrier.
+// - creates the transient images (the ones that only live inside the frame) in one allocation,
+//   and places those whose passes do not overlap at the same offset, so they share memory.
+//   Compile checks the result: images that share memory are never alive at the same time, and
+//   the first use of each waits for the last use of everything else in its memory.
+//
+// imported resources are the ones that live outside the graph (swapchain images, readback
+// buffers). Their handles can change every frame (vk_render_graph_set_image), the plan does not.
+// The graph only orders work inside one command buffer: semaphores and queue family ownership
+// transfers between queues stay with whoever owns the resource (see vk_particles.h).
+
+#include <vulkan/vulkan.h>
+
+#include "vk_allocator.h"
+#include "vk_profiler.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+enum class vk_render_graph_usage_t
+{
+	// not used: for the before and after of imported resources.
+	none,
+	vertex_buffer,
+	compute_read,
+	compute_write,
+	fragment_sampled,
+	color_attachment,
+	depth_attachment,
+	transfer_src,
+	transfer_dst,
+	host_read,
+	present
+};
+
+using vk_render_graph_record_fn_t = std::function<void(VkCommandBuffer)>;
+
+struct vk_render_graph_use_t
+{
+	uint32_t resource;
+	vk_render_graph_usage_t usage;
+};
+
+// the barrier before a pass (or after the last one). Buffers and images that keep their layout
+// go through the one memory barrier. dst_stage is 0 when there is nothing to wait for.
+struct vk_render_graph_barrier_t
+{
+	VkPipelineStageFlags src_stage;
+	VkPipelineStageFlags dst_stage;
+	VkAccessFlags src_access;
+	VkAccessFlags dst_access;
+	// the layout transitions, and the resource of each: the image is filled in when it is recorded.
+	std::vector<VkImageMemoryBarrier> image_barriers;
+	std::vector<uint32_t> image_resources;
+};
+
+struct vk_render_graph_pass_t
+{
+	const char* name;
+	vk_render_graph_record_fn_t record;
+	// never culled.
+	bool side_effects;
+	std::vector<vk_render_graph_use_t> uses;
+
+	// filled in by compile.
+	bool culled;
+	vk_render_graph_barrier_t barrier;
+};
+
+struct vk_render_graph_resource_t
+{
+	const char* name;
+	bool is_image;
+	bool transient;
+	VkImageAspectFlags aspect;
+	// imported: how the frame before left it, and what it is used for after the graph. discard:
+	// the contents from before do not matter.
+	vk_render_graph_usage_t before;
+	vk_render_graph_usage_t after;
+	bool discard;
+
+	// transient images only.
+	VkFormat format;
+	VkExtent2D extent;
+	// the live passes that use it, and where it is in graph.transient_allocation.
+	uint32_t first_pass;
+	uint32_t last_pass;
+	VkDeviceSize size;
+	VkDeviceSize offset;
+
+	VkBuffer buffer;
+	VkImage image;
+	VkImageView view;
+};
+
+struct vk_render_graph_t
+{
+	vk_allocator_t* allocator;
+	std::vector<vk_render_graph_pass_t> passes;
+	std::vector<vk_render_graph_resource_t> resources;
+	// the transition of the imported resources to their after usage.
+	vk_render_graph_barrier_t final_barrier;
+	// every transient image lives in here.
+	vk_allocation_t transient_allocation;
+	bool compiled;
+
+	// what compile did.
+	uint32_t culled_count;
+	uint32_t barrier_count;
+	VkDeviceSize transient_size;
+	VkDeviceSize transient_size_unaliased;
+};
+
+void vk_render_graph_init(vk_render_graph_t& graph, vk_allocator_t& allocator);
+// the gpu has to be done with the transient images.
+void vk_render_graph_destroy(vk_render_graph_t& graph);
+
+uint32_t vk_render_graph_import_buffer(vk_render_graph_t& graph, const char* name, vk_render_graph_usage_t before, vk_render_graph_usage_t after);
+uint32_t vk_render_graph_import_image(vk_render_graph_t& graph, const char* name, VkImageAspectFlags aspect, vk_render_graph_usage_t before, vk_render_graph_usage_t after, bool discard);
+// created by compile, with the usage flags its passes need.
+uint32_t vk_render_graph_create_image(vk_render_graph_t& graph, const char* name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect);
+
+// passes run in the order they are added. The record function only records the pass itself.
+// A pass uses every resource once.
+uint32_t vk_render_graph_add_pass(vk_render_graph_t& graph, const char* name, vk_render_graph_record_fn_t record, bool side_effects = false);
+void vk_render_graph_use(vk_render_graph_t& graph, uint32_t pass, uint32_t resource, vk_render_graph_usage_t usage);
+
+bool vk_render_graph_compile(vk_render_graph_t& graph);
+
+// the handles of the imported resources for this frame.
+void vk_render_graph_set_buffer(vk_render_graph_t& graph, uint32_t resource, VkBuffer buffer);
+void vk_render_graph_set_image(vk_render_graph_t& graph, uint32_t resource, VkImage image);
+VkImage vk_render_graph_image(const vk_render_graph_t& graph, uint32_t resource);
+VkImageView vk_render_graph_image_view(const vk_render_graph_t& graph, uint32_t resource);
+
+// records the live passes with their barriers. With a profiler, every pass is a graphics scope.
+void vk_render_graph_execute(vk_render_graph_t& graph, VkCommandBuffer command_buffer, vk_profiler_t* profiler = nullptr);
@@ -0,0 +1,277 @@
+#include "vk_scheduler.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+static vk_timeline_t& timeline_of(vk_scheduler_t& scheduler, vk_queue_kind_t kind)
+{
+	return scheduler.timelines[scheduler.kind_timeline[static_cast<size_t>(kind)]];
+}
+
+static const vk_timeline_t& timeline_of(const vk_scheduler_t& scheduler, vk_queue_kind_t kind)
+{
+	return scheduler.timelines[scheduler.kind_timeline[static_cast<size_t>(kind)]];
+}
+
+static bool create_timeline_semaphore(VkDevice device, VkSemaphore& semaphore)
+{
+	VkSemaphoreTypeCreateInfo type_create_info{};
+	type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_create_info.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_create_info{};
+	semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphore_create_info.pNext = &type_create_info;
+	return vkCreateSemaphore(device, &semaphore_create_info, nullptr, &semaphore) == VK_SUCCESS;
+}
+
+void vk_submit_add_command_buffer(vk_submit_t& submit, VkCommandBuffer command_buffer)
+{
+	if (submit.command_buffer_count == vk_submit_max_command_buffers)
+	{
+		fmt::print("[vk] too many command buffers in one submit.\n");
+		return;
+	}
+	submit.command_buffers[submit.command_buffer_count++] = command_buffer;
+}
+
+static void add_wait(vk_submit_t& submit, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stage)
+{
+	// waiting twice on the same timeline: the later value covers both.
+	for (uint32_t idx = 0; idx != submit.wait_count; ++idx)
+	{
+		if (submit.wait_semaphores[idx] == semaphore && value != 0)
+		{
+			if (value > submit.wait_values[idx]) submit.wait_values[idx] = value;
+			submit.wait_stages[idx] |= stage;
+			return;
+		}
+	}
+	if (submit.wait_count == vk_submit_max_waits)
+	{
+		fmt::print("[vk] too many waits in one submit.\n");
+		return;
+	}
+	submit.wait_semaphores[submit.wait_count] = semaphore;
+	submit.wait_values[submit.wait_count] = value;
+	submit.wait_stages[submit.wait_count] = stage;
+	submit.wait_count += 1;
+}
+
+void vk_submit_wait(vk_submit_t& submit, const vk_scheduler_t& scheduler, vk_timeline_point_t point, VkPipelineStageFlags stage)
+{
+	if (point.value == 0) return;
+	add_wait(submit, timeline_of(scheduler, point.queue).semaphore, point.value, stage);
+}
+
+void vk_submit_wait_binary(vk_submit_t& submit, VkSemaphore semaphore, VkPipelineStageFlags stage)
+{
+	add_wait(submit, semaphore, 0, stage);
+}
+
+void vk_submit_signal_binary(vk_submit_t& submit, VkSemaphore semaphore)
+{
+	if (submit.signal_count == vk_submit_max_signals)
+	{
+		fmt::print("[vk] too many signals in one submit.\n");
+		return;
+	}
+	submit.signal_semaphores[submit.signal_count] = semaphore;
+	submit.signal_values[submit.signal_count] = 0;
+	submit.signal_count += 1;
+}
+
+bool vk_scheduler_init(
+	vk_scheduler_t& scheduler,
+	VkDevice device,
+	VkQueue graphics_queue, uint32_t graphics_family,
+	VkQueue compute_queue, uint32_t compute_family,
+	VkQueue transfer_queue, uint32_t transfer_family)
+{
+	scheduler.device = device;
+	scheduler.timeline_count = 0;
+
+	if (compute_queue == VK_NULL_HANDLE)
+	{
+		compute_queue = graphics_queue;
+		compute_family = graphics_family;
+	}
+	if (transfer_queue == VK_NULL_HANDLE)
+	{
+		transfer_queue = graphics_queue;
+		transfer_family = graphics_family;
+	}
+
+	const VkQueue queues[] = {graphics_queue, compute_queue, transfer_queue, VK_NULL_HANDLE};
+	const uint32_t families[] = {graphics_family, compute_family, transfer_family, 0};
+	for (size_t kind = 0; kind != static_cast<size_t>(vk_queue_kind_t::count); ++kind)
+	{
+		const bool host = kind == static_cast<size_t>(vk_queue_kind_t::host);
+
+		// same VkQueue, same timeline.
+		uint32_t found = UINT32_MAX;
+		for (uint32_t idx = 0; idx != scheduler.timeline_count && !host; ++idx)
+		{
+			if (scheduler.timelines[idx].queue == queues[kind]) found = idx;
+		}
+		if (found != UINT32_MAX)
+		{
+			scheduler.kind_timeline[kind] = found;
+			continue;
+		}
+
+		vk_timeline_t& timeline = scheduler.timelines[scheduler.timeline_count];
+		timeline.queue = queues[kind];
+		timeline.family = families[kind];
+		timeline.submitted = 0;
+		timeline.completed = 0;
+		if (!create_timeline_semaphore(device, timeline.semaphore))
+		{
+			fmt::print("[vk] failed to create a timeline semaphore.\n");
+			return false;
+		}
+		scheduler.kind_timeline[kind] = scheduler.timeline_count;
+		scheduler.timeline_count += 1;
+	}
+
+	// the host timeline does not count as a queue.
+	fmt::print("[vk] scheduler: {} queue timelines.\n", scheduler.timeline_count - 1);
+	return true;
+}
+
+void vk_scheduler_destroy(vk_scheduler_t& scheduler)
+{
+	for (uint32_t idx = 0; idx != scheduler.timeline_count; ++idx)
+	{
+		vk_timeline_t& timeline = scheduler.timelines[idx];
+		if (timeline.semaphore) vkDestroySemaphore(scheduler.device, timeline.semaphore, nullptr);
+		timeline.semaphore = VK_NULL_HANDLE;
+	}
+	scheduler.timeline_count = 0;
+}
+
+VkQueue vk_scheduler_queue(const vk_scheduler_t& scheduler, vk_queue_kind_t kind)
+{
+	return timeline_of(scheduler, kind).queue;
+}
+
+uint32_t vk_scheduler_family(const vk_scheduler_t& scheduler, vk_queue_kind_t kind)
+{
+	return timeline_of(scheduler, kind).family;
+}
+
+vk_timeline_point_t vk_scheduler_submit(vk_scheduler_t& scheduler, vk_queue_kind_t kind, vk_submit_t& submit)
+{
+	vk_timeline_t& timeline = timeline_of(scheduler, kind);
+
+	// drop waits on our own timeline: earlier submits to the same queue are ordered already.
+	uint32_t wait_count = 0;
+	for (uint32_t idx = 0; idx != submit.wait_count; ++idx)
+	{
+		if (submit.wait_semaphores[idx] == timeline.semaphore) continue;
+		submit.wait_semaphores[wait_count] = submit.wait_semaphores[idx];
+		submit.wait_values[wait_count] = submit.wait_values[idx];
+		submit.wait_stages[wait_count] = submit.wait_stages[idx];
+		wait_count += 1;
+	}
+	submit.wait_count = wait_count;
+
+	std::lock_guard<std::mutex> lock(timeline.mutex);
+	const uint64_t value = timeline.submitted + 1;
+	submit.signal_semaphores[submit.signal_count] = timeline.semaphore;
+	submit.signal_values[submit.signal_count] = value;
+
+	VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+	timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_submit_info.waitSemaphoreValueCount = submit.wait_count;
+	timeline_submit_info.pWaitSemaphoreValues = submit.wait_values;
+	timeline_submit_info.signalSemaphoreValueCount = submit.signal_count + 1;
+	timeline_submit_info.pSignalSemaphoreValues = submit.signal_values;
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = &timeline_submit_info;
+	submit_info.waitSemaphoreCount = submit.wait_count;
+	submit_info.pWaitSemaphores = submit.wait_semaphores;
+	submit_info.pWaitDstStageMask = submit.wait_stages;
+	submit_info.commandBufferCount = submit.command_buffer_count;
+	submit_info.pCommandBuffers = submit.command_buffers;
+	submit_info.signalSemaphoreCount = submit.signal_count + 1;
+	submit_info.pSignalSemaphores = submit.signal_semaphores;
+
+	if (vkQueueSubmit(timeline.queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		fmt::print("[vk] failed to submit to timeline value {}.\n", value);
+		return {kind, 0};
+	}
+	timeline.submitted = value;
+	return {kind, value};
+}
+
+vk_timeline_point_t vk_scheduler_last_submitted(const vk_scheduler_t& scheduler, vk_queue_kind_t kind)
+{
+	return {kind, timeline_of(scheduler, kind).submitted.load()};
+}
+
+bool vk_scheduler_is_complete(vk_scheduler_t& scheduler, vk_timeline_point_t point)
+{
+	vk_timeline_t& timeline = timeline_of(scheduler, point.queue);
+	if (point.value <= timeline.completed) return true;
+
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(scheduler.device, timeline.semaphore, &value);
+	// only ever move forward, another thread may have seen a later value already.
+	uint64_t completed = timeline.completed;
+	while (value > completed && !timeline.completed.compare_exchange_weak(completed, value)) {}
+	return point.value <= value;
+}
+
+bool vk_scheduler_wait(vk_scheduler_t& scheduler, vk_timeline_point_t point, uint64_t timeout)
+{
+	if (vk_scheduler_is_complete(scheduler, point)) return true;
+
+	vk_timeline_t& timeline = timeline_of(scheduler, point.queue);
+	VkSemaphoreWaitInfo wait_info{};
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &timeline.semaphore;
+	wait_info.pValues = &point.value;
+	if (vkWaitSemaphores(scheduler.device, &wait_info, timeout) != VK_SUCCESS) return false;
+
+	uint64_t completed = timeline.completed;
+	while (point.value > completed && !timeline.completed.compare_exchange_weak(completed, point.value)) {}
+	return true;
+}
+
+void vk_scheduler_wait_idle(vk_scheduler_t& scheduler)
+{
+	for (size_t kind = 0; kind != static_cast<size_t>(vk_queue_kind_t::host); ++kind)
+	{
+		vk_scheduler_wait(scheduler, vk_scheduler_last_submitted(scheduler, static_cast<vk_queue_kind_t>(kind)));
+	}
+}
+
+vk_timeline_point_t vk_scheduler_host_reserve(vk_scheduler_t& scheduler)
+{
+	vk_timeline_t& timeline = timeline_of(scheduler, vk_queue_kind_t::host);
+	return {vk_queue_kind_t::host, ++timeline.submitted};
+}
+
+void vk_scheduler_host_signal(vk_scheduler_t& scheduler, vk_timeline_point_t point)
+{
+	vk_timeline_t& timeline = timeline_of(scheduler, vk_queue_kind_t::host);
+
+	// a timeline only moves forward: signaling a value that is already reached is a no-op, so host
+	// points are meant to be signaled in the order they were reserved.
+	std::lock_guard<std::mutex> lock(timeline.mutex);
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(scheduler.device, timeline.semaphore, &value);
+	if (point.value <= value) return;
+
+	VkSemaphoreSignalInfo signal_info{};
+	signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+	signal_info.semaphore = timeline.semaphore;
+	signal_info.value = point.value;
+	vkSignalSemaphore(scheduler.device, &signal_info);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+// gpu/cpu synchronization with vulkan 1.2 timeline semaphores, instead of a fence per submit.
+//
+// every queue has one timeline semaphore, and every submit to it signals the next value. A
+// (queue, value) pair is a vk_timeline_point_t: "everything submitted to that queue up to and
+// including this submit". The cpu polls or waits for points, and submits to other queues wait for
+// them on the gpu, so there is a single primitive for cpu/gpu and queue/queue dependencies.
+//
+// the host timeline is not a queue: cpu jobs reserve a value, gpu work waits for it (a timeline
+// wait may be submitted before its signal), and the job signals it when its data is ready.
+//
+// queue kinds that share a VkQueue (no dedicated compute or transfer family) share its timeline.
+// vk_scheduler_submit is thread safe; submits to the same VkQueue are serialized.
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+enum class vk_queue_kind_t
+{
+	graphics,
+	compute,
+	transfer,
+	host,
+	count
+};
+
+struct vk_timeline_point_t
+{
+	vk_queue_kind_t queue;
+	// 0 is reached from the start: waiting for it never blocks.
+	uint64_t value;
+};
+
+struct vk_timeline_t
+{
+	// VK_NULL_HANDLE for the host timeline.
+	VkQueue queue;
+	uint32_t family;
+	VkSemaphore semaphore;
+	// the value the last submit signals (or the last reserved host value).
+	std::atomic<uint64_t> submitted;
+	// the last value the gpu was seen to reach. Saves a driver call when polling.
+	std::atomic<uint64_t> completed;
+	std::mutex mutex;
+};
+
+struct vk_scheduler_t
+{
+	VkDevice device;
+	// one per distinct VkQueue, plus the host timeline.
+	std::array<vk_timeline_t, static_cast<size_t>(vk_queue_kind_t::count)> timelines;
+	uint32_t timeline_count;
+	// which timeline every kind uses.
+	std::array<uint32_t, static_cast<size_t>(vk_queue_kind_t::count)> kind_timeline;
+};
+
+const uint32_t vk_submit_max_command_buffers = 8;
+const uint32_t vk_submit_max_waits = 8;
+const uint32_t vk_submit_max_signals = 4;
+
+// what goes into one submit. Waits and signals are timeline points or binary semaphores
+// (value 0): the swapchain only deals in binary ones.
+struct vk_submit_t
+{
+	uint32_t command_buffer_count;
+	VkCommandBuffer command_buffers[vk_submit_max_command_buffers];
+
+	uint32_t wait_count;
+	VkSemaphore wait_semaphores[vk_submit_max_waits];
+	uint64_t wait_values[vk_submit_max_waits];
+	VkPipelineStageFlags wait_stages[vk_submit_max_waits];
+
+	// the queue's own timeline signal is added by vk_scheduler_submit.
+	uint32_t signal_count;
+	VkSemaphore signal_semaphores[vk_submit_max_signals + 1];
+	uint64_t signal_values[vk_submit_max_signals + 1];
+};
+
+void vk_submit_add_command_buffer(vk_submit_t& submit, VkCommandBuffer command_buffer);
+// waits on the same timeline as the submit itself are dropped: queue order already covers them.
+void vk_submit_wait(vk_submit_t& submit, const vk_scheduler_t& scheduler, vk_timeline_point_t point, VkPipelineStageFlags stage);
+void vk_submit_wait_binary(vk_submit_t& submit, VkSemaphore semaphore, VkPipelineStageFlags stage);
+void vk_submit_signal_binary(vk_submit_t& submit, VkSemaphore semaphore);
+
+// the device has to be created with the timelineSemaphore feature. Queues that are VK_NULL_HANDLE
+// fall back to the graphics queue.
+bool vk_scheduler_init(
+	vk_scheduler_t& scheduler,
+	VkDevice device,
+	VkQueue graphics_queue, uint32_t graphics_family,
+	VkQueue compute_queue, uint32_t compute_family,
+	VkQueue transfer_queue, uint32_t transfer_family);
+void vk_scheduler_destroy(vk_scheduler_t& scheduler);
+
+VkQueue vk_scheduler_queue(const vk_scheduler_t& scheduler, vk_queue_kind_t kind);
+uint32_t vk_scheduler_family(const vk_scheduler_t& scheduler, vk_queue_kind_t kind);
+
+// submits to the kind's queue and returns the point it signals, or a value of 0 on failure.
+vk_timeline_point_t vk_scheduler_submit(vk_scheduler_t& scheduler, vk_queue_kind_t kind, vk_submit_t& submit);
+
+// the point the last submit to the kind's queue signals.
+vk_timeline_point_t vk_scheduler_last_submitted(const vk_scheduler_t& scheduler, vk_queue_kind_t kind);
+bool vk_scheduler_is_complete(vk_scheduler_t& scheduler, vk_timeline_point_t point);
+// false on timeout (in nanoseconds).
+bool vk_scheduler_wait(vk_scheduler_t& scheduler, vk_timeline_point_t point, uint64_t timeout = UINT64_MAX);
+// waits for everything submitted so far, on every queue. Does not wait for reserved host values.
+void vk_scheduler_wait_idle(vk_scheduler_t& scheduler);
+
+// the host timeline: reserve a point for gpu work to wait on, signal it from the cpu.
+vk_timeline_point_t vk_scheduler_host_reserve(vk_scheduler_t& scheduler);
+void vk_scheduler_host_signal(vk_scheduler_t& scheduler, vk_timeline_point_t point);
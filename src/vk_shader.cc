@@ -0,0 +1,61 @@
+#include "vk_shader.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <cstdio>
+
+const uint32_t spirv_magic = 0x07230203;
+
+bool vk_shader_read_spirv(const char* path, std::vector<uint32_t>& code)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr) return false;
+
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	bool ok = size > 0 && size % sizeof(uint32_t) == 0;
+	if (ok)
+	{
+		code.resize(static_cast<size_t>(size) / sizeof(uint32_t));
+		ok = fread(code.data(), 1, static_cast<size_t>(size), file) == static_cast<size_t>(size);
+	}
+	fclose(file);
+	return ok && code[0] == spirv_magic;
+}
+
+bool vk_shader_load(VkDevice device, const char* path, VkShaderModule& shader_module, shader_reflection_t* reflection)
+{
+	std::vector<uint32_t> code;
+	if (!vk_shader_read_spirv(path, code))
+	{
+		fmt::print("[vk] {} is missing or not SPIR-V (run the shader step in build.bat).\n", path);
+		return false;
+	}
+	if (reflection != nullptr)
+	{
+		if (!shader_reflection_read(path, *reflection))
+		{
+			fmt::print("[vk] the reflection of {} is missing (run the shader step in build.bat).\n", path);
+			return false;
+		}
+		if (reflection->spirv_hash != shader_spirv_hash(code.data(), code.size()))
+		{
+			fmt::print("[vk] the reflection of {} is out of date (run the shader step in build.bat).\n", path);
+			return false;
+		}
+	}
+
+	VkShaderModuleCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = code.size() * sizeof(uint32_t);
+	create_info.pCode = code.data();
+	if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS)
+	{
+		fmt::print("[vk] failed to create a shader module from {}.\n", path);
+		return false;
+	}
+	return true;
+}
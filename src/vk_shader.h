@@ -0,0 +1,16 @@
+#pragma once
+
+// SPIR-V shader modules. The .spv files are compiled (and optimized) from shaders/ by build.bat,
+// which also writes their reflection next to them (shader_reflect.h).
+
+#include <vulkan/vulkan.h>
+
+#include "shader_reflect.h"
+
+#include <cstdint>
+#include <vector>
+
+bool vk_shader_read_spirv(const char* path, std::vector<uint32_t>& code);
+// prints why when the file is missing or is not SPIR-V. With reflection, the sidecar has to be
+// there and has to belong to this SPIR-V.
+bool vk_shader_load(VkDevice device, const char* path, VkShaderModule& shader_module, shader_reflection_t* reflection = nullptr);
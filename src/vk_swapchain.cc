@@ -0,0 +1,307 @@
+#include "vk_swapchain.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm> // std::clamp
+#include <chrono>
+#include <limits> // std::numeric_limits
+
+static bool create_render_pass(vk_swapchain_t& swapchain, VkDevice device)
+{
+	VkAttachmentDescription color_attachment{};
+	color_attachment.format = swapchain.surface_format.format;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	// the render graph moves the image in and out of this layout.
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference color_reference{};
+	color_reference.attachment = 0;
+	color_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_reference;
+
+	VkRenderPassCreateInfo render_pass_create_info{};
+	render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_create_info.attachmentCount = 1;
+	render_pass_create_info.pAttachments = &color_attachment;
+	render_pass_create_info.subpassCount = 1;
+	render_pass_create_info.pSubpasses = &subpass;
+
+	return vkCreateRenderPass(device, &render_pass_create_info, nullptr, &swapchain.render_pass) == VK_SUCCESS;
+}
+
+VkPresentModeKHR vk_swapchain_choose_present_mode(const vk_swapchain_t& swapchain, VkPresentModeKHR preferred)
+{
+	for (const auto& present_mode: swapchain.present_modes)
+	{
+		if (present_mode == preferred) return preferred;
+	}
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+const char* vk_present_mode_name(VkPresentModeKHR present_mode)
+{
+	switch (present_mode)
+	{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+		default: return "unknown";
+	}
+}
+
+// moves the swapchain and everything made for its images into the retired list.
+static void retire(vk_swapchain_t& swapchain, vk_timeline_point_t point)
+{
+	vk_retired_swapchain_t retired{};
+	retired.swapchain = swapchain.swapchain;
+	retired.views = std::move(swapchain.views);
+	retired.framebuffers = std::move(swapchain.framebuffers);
+	retired.render_finished = std::move(swapchain.render_finished);
+	retired.point = point;
+	swapchain.retired.push_back(std::move(retired));
+
+	swapchain.swapchain = VK_NULL_HANDLE;
+	swapchain.views.clear();
+	swapchain.framebuffers.clear();
+	swapchain.render_finished.clear();
+	swapchain.images.clear();
+}
+
+static void destroy_retired(vk_retired_swapchain_t& retired, VkDevice device)
+{
+	for (auto semaphore: retired.render_finished) if (semaphore) vkDestroySemaphore(device, semaphore, nullptr);
+	for (auto framebuffer: retired.framebuffers) if (framebuffer) vkDestroyFramebuffer(device, framebuffer, nullptr);
+	for (auto view: retired.views) if (view) vkDestroyImageView(device, view, nullptr);
+	if (retired.swapchain) vkDestroySwapchainKHR(device, retired.swapchain, nullptr);
+}
+
+// creates the swapchain, or when there is one already, retires it (after point) and replaces it.
+static bool create_swapchain(
+	vk_swapchain_t& swapchain,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	VkSurfaceKHR surface,
+	VkExtent2D framebuffer_extent,
+	VkPresentModeKHR preferred_present_mode,
+	uint32_t graphics_family,
+	uint32_t present_family,
+	vk_timeline_point_t point)
+{
+	VkSurfaceCapabilitiesKHR capabilities{};
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities);
+
+	if (swapchain.present_modes.empty())
+	{
+		uint32_t present_mode_count{};
+		vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, nullptr);
+		swapchain.present_modes.resize(present_mode_count);
+		vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &present_mode_count, swapchain.present_modes.data());
+	}
+
+	// the format is picked once: the render pass (and every pipeline made for it) depends on it.
+	if (swapchain.render_pass == VK_NULL_HANDLE)
+	{
+		uint32_t format_count{};
+		vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, nullptr);
+		std::vector<VkSurfaceFormatKHR> formats(format_count);
+		vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, formats.data());
+		if (formats.empty() || swapchain.present_modes.empty())
+		{
+			fmt::print("[vk] the surface reports no formats or present modes.\n");
+			return false;
+		}
+
+		// choose the right (swap) surface format. Take whatever comes first if there is no srgb one.
+		swapchain.surface_format = formats[0];
+		for (const auto& available_format: formats)
+		{
+			if (available_format.format == VK_FORMAT_B8G8R8A8_SRGB && available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+			{
+				swapchain.surface_format = available_format;
+				break;
+			}
+		}
+	}
+
+	swapchain.present_mode = vk_swapchain_choose_present_mode(swapchain, preferred_present_mode);
+
+	// the swap extent is the resolution of the swap chain images, and almost always the size of the
+	// window in pixels. Surfaces that leave it up to us say so with a current extent of UINT32_MAX.
+	VkExtent2D extent = capabilities.currentExtent;
+	if (capabilities.currentExtent.width == std::numeric_limits<uint32_t>::max())
+	{
+		extent.width = std::clamp(framebuffer_extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+		extent.height = std::clamp(framebuffer_extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+	}
+	// minimized: there is nothing to create a swapchain for. Keep the one we have.
+	if (extent.width == 0 || extent.height == 0) return false;
+	swapchain.extent = extent;
+
+	VkSwapchainKHR old_swapchain = swapchain.swapchain;
+	if (old_swapchain != VK_NULL_HANDLE) retire(swapchain, point);
+
+	// one over the minimum, so we do not have to wait on the driver before we can acquire.
+	uint32_t image_count = capabilities.minImageCount + 1;
+	if (capabilities.maxImageCount > 0 && image_count > capabilities.maxImageCount)
+	{
+		image_count = capabilities.maxImageCount;
+	}
+
+	const uint32_t queue_family_indices[] = {graphics_family, present_family};
+
+	VkSwapchainCreateInfoKHR swap_chain_create_info{};
+	swap_chain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	swap_chain_create_info.surface = surface;
+	swap_chain_create_info.minImageCount = image_count;
+	swap_chain_create_info.imageFormat = swapchain.surface_format.format;
+	swap_chain_create_info.imageColorSpace = swapchain.surface_format.colorSpace;
+	swap_chain_create_info.imageExtent = swapchain.extent;
+	swap_chain_create_info.imageArrayLayers = 1;
+	swap_chain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// presenting from another queue family: share the images instead of transferring ownership every frame.
+	if (graphics_family != present_family)
+	{
+		swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		swap_chain_create_info.queueFamilyIndexCount = 2;
+		swap_chain_create_info.pQueueFamilyIndices = queue_family_indices;
+	}
+	else
+	{
+		swap_chain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+	swap_chain_create_info.preTransform = capabilities.currentTransform;
+	swap_chain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	swap_chain_create_info.presentMode = swapchain.present_mode;
+	swap_chain_create_info.clipped = VK_TRUE;
+	// lets the driver hand over the images the old swapchain is done with, and keep presenting
+	// the ones it is not done with. The old swapchain is retired either way.
+	swap_chain_create_info.oldSwapchain = old_swapchain;
+
+	if (vkCreateSwapchainKHR(device, &swap_chain_create_info, nullptr, &swapchain.swapchain) != VK_SUCCESS)
+	{
+		swapchain.swapchain = VK_NULL_HANDLE;
+		fmt::print("[vk] failed to create the swapchain.\n");
+		return false;
+	}
+
+	if (swapchain.render_pass == VK_NULL_HANDLE && !create_render_pass(swapchain, device))
+	{
+		fmt::print("[vk] failed to create the swapchain render pass.\n");
+		return false;
+	}
+
+	uint32_t swapchain_image_count{};
+	vkGetSwapchainImagesKHR(device, swapchain.swapchain, &swapchain_image_count, nullptr);
+	swapchain.images.resize(swapchain_image_count);
+	vkGetSwapchainImagesKHR(device, swapchain.swapchain, &swapchain_image_count, swapchain.images.data());
+
+	swapchain.views.resize(swapchain_image_count);
+	swapchain.framebuffers.resize(swapchain_image_count);
+	swapchain.render_finished.resize(swapchain_image_count);
+	for (uint32_t idx = 0; idx != swapchain_image_count; ++idx)
+	{
+		VkImageViewCreateInfo view_create_info{};
+		view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_create_info.image = swapchain.images[idx];
+		view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_create_info.format = swapchain.surface_format.format;
+		view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		if (vkCreateImageView(device, &view_create_info, nullptr, &swapchain.views[idx]) != VK_SUCCESS) return false;
+
+		VkFramebufferCreateInfo framebuffer_create_info{};
+		framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_create_info.renderPass = swapchain.render_pass;
+		framebuffer_create_info.attachmentCount = 1;
+		framebuffer_create_info.pAttachments = &swapchain.views[idx];
+		framebuffer_create_info.width = swapchain.extent.width;
+		framebuffer_create_info.height = swapchain.extent.height;
+		framebuffer_create_info.layers = 1;
+		if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &swapchain.framebuffers[idx]) != VK_SUCCESS) return false;
+
+		VkSemaphoreCreateInfo semaphore_create_info{};
+		semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &swapchain.render_finished[idx]) != VK_SUCCESS) return false;
+	}
+
+	fmt::print("[vk] {} a swapchain of {} {}x{} images, present mode {}.\n", old_swapchain != VK_NULL_HANDLE ? "recreated" : "created",
+		swapchain_image_count, swapchain.extent.width, swapchain.extent.height, vk_present_mode_name(swapchain.present_mode));
+	return true;
+}
+
+bool vk_swapchain_create(
+	vk_swapchain_t& swapchain,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	VkSurfaceKHR surface,
+	VkExtent2D framebuffer_extent,
+	VkPresentModeKHR preferred_present_mode,
+	uint32_t graphics_family,
+	uint32_t present_family)
+{
+	return create_swapchain(swapchain, physical_device, device, surface, framebuffer_extent, preferred_present_mode, graphics_family, present_family, {vk_queue_kind_t::graphics, 0});
+}
+
+bool vk_swapchain_recreate(
+	vk_swapchain_t& swapchain,
+	vk_scheduler_t& scheduler,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	VkSurfaceKHR surface,
+	VkExtent2D framebuffer_extent,
+	VkPresentModeKHR preferred_present_mode,
+	uint32_t graphics_family,
+	uint32_t present_family)
+{
+	// frames that are submitted already may render into the old images, and the presents after
+	// them wait on the old semaphores. The first frame on the new swapchain is submitted to the
+	// same queue after all of them, so once it is done, so are they.
+	vk_timeline_point_t point = vk_scheduler_last_submitted(scheduler, vk_queue_kind_t::graphics);
+	point.value += 1;
+
+	const auto start = std::chrono::steady_clock::now();
+	if (!create_swapchain(swapchain, physical_device, device, surface, framebuffer_extent, preferred_present_mode, graphics_family, present_family, point)) return false;
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	swapchain.recreate_count += 1;
+	fmt::print("[vk] swapchain recreation {} took {:.2f} ms, {} retired.\n", swapchain.recreate_count, elapsed.count(), swapchain.retired.size());
+	return true;
+}
+
+void vk_swapchain_collect(vk_swapchain_t& swapchain, vk_scheduler_t& scheduler, VkDevice device)
+{
+	auto& retired = swapchain.retired;
+	for (size_t idx = 0; idx != retired.size();)
+	{
+		if (vk_scheduler_is_complete(scheduler, retired[idx].point))
+		{
+			destroy_retired(retired[idx], device);
+			retired.erase(retired.begin() + idx);
+		}
+		else
+		{
+			idx += 1;
+		}
+	}
+}
+
+void vk_swapchain_destroy(vk_swapchain_t& swapchain, VkDevice device)
+{
+	for (auto& retired: swapchain.retired) destroy_retired(retired, device);
+	for (auto semaphore: swapchain.render_finished) if (semaphore) vkDestroySemaphore(device, semaphore, nullptr);
+	for (auto framebuffer: swapchain.framebuffers) if (framebuffer) vkDestroyFramebuffer(device, framebuffer, nullptr);
+	for (auto view: swapchain.views) if (view) vkDestroyImageView(device, view, nullptr);
+	if (swapchain.swapchain) vkDestroySwapchainKHR(device, swapchain.swapchain, nullptr);
+	if (swapchain.render_pass) vkDestroyRenderPass(device, swapchain.render_pass, nullptr);
+	swapchain = {};
+}
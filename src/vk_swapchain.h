@@ -0,0 +1,89 @@
+#pragma once
+
+// the swapchain, with the render pass and framebuffers that draw into its images.
+//
+// the render finished semaphores are per swapchain image, not per frame in flight: the
+// presentation engine may still be waiting on one when its frame slot comes around again, and
+// nothing tells us when it is done with it, other than getting the same image back from acquire.
+//
+// resizing, or changing the present mode, recreates the swapchain through oldSwapchain, without
+// waiting for the gpu: only the swapchain itself and what depends on its images (views,
+// framebuffers, semaphores) are rebuilt, the render pass stays (the surface format does not
+// change), and so does every pipeline made for it. The old swapchain and its views are retired:
+// frames in flight may still render into them and present them, so they are destroyed once the
+// first frame submitted after the recreation is done.
+
+#include <vulkan/vulkan.h>
+
+#include "vk_scheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+struct vk_retired_swapchain_t
+{
+	VkSwapchainKHR swapchain;
+	std::vector<VkImageView> views;
+	std::vector<VkFramebuffer> framebuffers;
+	std::vector<VkSemaphore> render_finished;
+	// destroyed once the graphics timeline gets here.
+	vk_timeline_point_t point;
+};
+
+struct vk_swapchain_t
+{
+	VkSwapchainKHR swapchain;
+	VkSurfaceFormatKHR surface_format;
+	VkPresentModeKHR present_mode;
+	VkExtent2D extent;
+	VkRenderPass render_pass;
+
+	std::vector<VkImage> images;
+	std::vector<VkImageView> views;
+	std::vector<VkFramebuffer> framebuffers;
+	std::vector<VkSemaphore> render_finished;
+
+	// what the surface supports, queried once.
+	std::vector<VkPresentModeKHR> present_modes;
+
+	std::vector<vk_retired_swapchain_t> retired;
+	uint32_t recreate_count;
+};
+
+// mailbox: newest frame wins, lowest latency without tearing, the gpu never idles.
+// fifo: vsync, the cpu and gpu are throttled to the display. Always there.
+// falls back to fifo when preferred is not supported.
+VkPresentModeKHR vk_swapchain_choose_present_mode(const vk_swapchain_t& swapchain, VkPresentModeKHR preferred);
+const char* vk_present_mode_name(VkPresentModeKHR present_mode);
+
+// framebuffer_extent is the size of the window in pixels; it is only used when the surface leaves
+// the extent up to us.
+bool vk_swapchain_create(
+	vk_swapchain_t& swapchain,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	VkSurfaceKHR surface,
+	VkExtent2D framebuffer_extent,
+	VkPresentModeKHR preferred_present_mode,
+	uint32_t graphics_family,
+	uint32_t present_family);
+
+// replaces the swapchain with one for the current surface extent and the present mode, handing
+// the old one to the driver as oldSwapchain. Does not wait for anything. Fails when the window
+// is minimized (a zero extent): try again once it is back.
+bool vk_swapchain_recreate(
+	vk_swapchain_t& swapchain,
+	vk_scheduler_t& scheduler,
+	VkPhysicalDevice physical_device,
+	VkDevice device,
+	VkSurfaceKHR surface,
+	VkExtent2D framebuffer_extent,
+	VkPresentModeKHR preferred_present_mode,
+	uint32_t graphics_family,
+	uint32_t present_family);
+
+// destroys the retired swapchains the gpu is done with. Once per frame.
+void vk_swapchain_collect(vk_swapchain_t& swapchain, vk_scheduler_t& scheduler, VkDevice device);
+
+// everything, retired swapchains included. The gpu has to be idle.
+void vk_swapchain_destroy(vk_swapchain_t& swapchain, VkDevice device);
@@ -0,0 +1,263 @@
+#include "vk_transfer.h"
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring> // memcpy
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// gives back the ring space of every batch the transfer queue is done with.
+static void reclaim(vk_transfer_t& transfer, bool wait_for_oldest)
+{
+	while (!transfer.in_flight.empty())
+	{
+		vk_transfer_batch_t& batch = transfer.batches[transfer.in_flight.front()];
+		if (wait_for_oldest)
+		{
+			vk_scheduler_wait(*transfer.scheduler, batch.submitted);
+			wait_for_oldest = false;
+		}
+		else if (!vk_scheduler_is_complete(*transfer.scheduler, batch.submitted))
+		{
+			break;
+		}
+		transfer.tail = batch.ring_end;
+		transfer.in_flight.pop_front();
+	}
+}
+
+bool vk_transfer_init(vk_transfer_t& transfer, vk_allocator_t& allocator, vk_scheduler_t& scheduler, VkDeviceSize ring_size)
+{
+	VkDevice device = allocator.device;
+	transfer = {};
+	transfer.allocator = &allocator;
+	transfer.scheduler = &scheduler;
+	transfer.family = vk_scheduler_family(scheduler, vk_queue_kind_t::transfer);
+	transfer.ring_size = align_up(ring_size, vk_allocator_granularity);
+	transfer.last_flushed = {vk_queue_kind_t::transfer, 0};
+
+	VkBufferCreateInfo buffer_create_info{};
+	buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_create_info.size = transfer.ring_size;
+	buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bool ok = vk_allocator_create_buffer(allocator, buffer_create_info, vk_memory_usage_t::upload, transfer.ring, transfer.ring_allocation);
+	ok = ok && transfer.ring_allocation.mapped != nullptr;
+
+	transfer.batches.resize(vk_transfer_batch_count);
+	for (auto& batch: transfer.batches)
+	{
+		batch.submitted = {vk_queue_kind_t::transfer, 0};
+		if (!ok) break;
+
+		VkCommandPoolCreateInfo command_pool_create_info{};
+		command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		command_pool_create_info.queueFamilyIndex = transfer.family;
+		ok = vkCreateCommandPool(device, &command_pool_create_info, nullptr, &batch.command_pool) == VK_SUCCESS;
+
+		VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+		command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		command_buffer_allocate_info.commandPool = batch.command_pool;
+		command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		command_buffer_allocate_info.commandBufferCount = 1;
+		ok = ok && vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &batch.command_buffer) == VK_SUCCESS;
+	}
+
+	if (!ok)
+	{
+		fmt::print("[vk] failed to create the transfer ring.\n");
+		vk_transfer_destroy(transfer);
+		return false;
+	}
+
+	const bool dedicated = transfer.family != vk_scheduler_family(scheduler, vk_queue_kind_t::graphics);
+	fmt::print("[vk] transfer: {} MiB staging ring, queue family {} ({}).\n",
+		transfer.ring_size >> 20, transfer.family, dedicated ? "dedicated" : "shared with graphics");
+	return true;
+}
+
+void vk_transfer_destroy(vk_transfer_t& transfer)
+{
+	if (transfer.allocator == nullptr) return;
+	vk_allocator_t& allocator = *transfer.allocator;
+
+	// whatever is still recorded goes out, so nobody waits for a point that is never signaled.
+	vk_transfer_flush(transfer);
+	vk_scheduler_wait(*transfer.scheduler, transfer.last_flushed);
+	if (transfer.flush_count != 0)
+	{
+		fmt::print("[vk] transfer: {:.1f} MiB in {} batches, waited for the ring {} times.\n",
+			static_cast<double>(transfer.uploaded_bytes) / (1 << 20), transfer.flush_count, transfer.stall_count);
+	}
+
+	for (auto& batch: transfer.batches)
+	{
+		if (batch.command_pool) vkDestroyCommandPool(allocator.device, batch.command_pool, nullptr);
+	}
+	vk_allocator_destroy_buffer(allocator, transfer.ring, transfer.ring_allocation);
+	transfer = {};
+}
+
+VkDeviceSize vk_transfer_max_allocation_size(const vk_transfer_t& transfer)
+{
+	return transfer.ring_size / 4;
+}
+
+vk_transfer_allocation_t vk_transfer_allocate(vk_transfer_t& transfer, VkDeviceSize size)
+{
+	if (size > vk_transfer_max_allocation_size(transfer))
+	{
+		fmt::print("[vk] transfer allocation of {} bytes does not fit in the ring.\n", size);
+		return {};
+	}
+
+	reclaim(transfer, false);
+	for (;;)
+	{
+		// allocations never wrap around the end of the ring: skip what is left of it instead.
+		VkDeviceSize begin = align_up(transfer.head, vk_transfer_alignment);
+		if (begin % transfer.ring_size + size > transfer.ring_size) begin = align_up(begin, transfer.ring_size);
+		if (begin + size - transfer.tail <= transfer.ring_size)
+		{
+			transfer.head = begin + size;
+			return {transfer.ring_allocation.mapped + begin % transfer.ring_size, begin % transfer.ring_size, size};
+		}
+
+		// the ring is full: what we recorded has to go out before its space can come back.
+		if (!transfer.pending_copies.empty()) vk_transfer_flush(transfer);
+		transfer.stall_count += 1;
+		reclaim(transfer, true);
+	}
+}
+
+void vk_transfer_copy(vk_transfer_t& transfer, const vk_transfer_allocation_t& allocation, VkDeviceSize source_offset, VkBuffer destination, VkDeviceSize destination_offset, VkDeviceSize size)
+{
+	vk_allocator_flush(*transfer.allocator, transfer.ring_allocation, allocation.offset + source_offset, size);
+	transfer.pending_copies.push_back({destination, {allocation.offset + source_offset, destination_offset, size}});
+	transfer.uploaded_bytes += size;
+}
+
+void vk_transfer_upload(vk_transfer_t& transfer, VkBuffer destination, VkDeviceSize destination_offset, const void* data, VkDeviceSize size)
+{
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	const VkDeviceSize chunk_size = vk_transfer_max_allocation_size(transfer);
+	for (VkDeviceSize offset = 0; offset < size; offset += chunk_size)
+	{
+		const VkDeviceSize count = std::min(chunk_size, size - offset);
+		vk_transfer_allocation_t allocation = vk_transfer_allocate(transfer, count);
+		memcpy(allocation.mapped, source + offset, count);
+		vk_transfer_copy(transfer, allocation, 0, destination, destination_offset + offset, count);
+	}
+}
+
+void vk_transfer_release(vk_transfer_t& transfer, VkBuffer buffer, uint32_t destination_family)
+{
+	if (destination_family == transfer.family) return;
+	transfer.pending_releases.push_back({buffer, destination_family});
+}
+
+vk_timeline_point_t vk_transfer_flush(vk_transfer_t& transfer)
+{
+	if (transfer.pending_copies.empty() && transfer.pending_releases.empty()) return transfer.last_flushed;
+
+	// the batch we are about to reuse was flushed vk_transfer_batch_count flushes ago.
+	vk_transfer_batch_t& batch = transfer.batches[transfer.next_batch];
+	if (!vk_scheduler_is_complete(*transfer.scheduler, batch.submitted))
+	{
+		transfer.stall_count += 1;
+		vk_scheduler_wait(*transfer.scheduler, batch.submitted);
+	}
+	reclaim(transfer, false);
+	vkResetCommandPool(transfer.allocator->device, batch.command_pool, 0);
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.command_buffer, &begin_info);
+
+	// one vkCmdCopyBuffer per destination, with all of its regions.
+	auto& copies = transfer.pending_copies;
+	std::stable_sort(copies.begin(), copies.end(), [](const vk_transfer_copy_t& lhs, const vk_transfer_copy_t& rhs)
+	{
+		return lhs.destination < rhs.destination;
+	});
+	std::vector<VkBufferCopy> regions;
+	for (size_t begin = 0; begin != copies.size();)
+	{
+		size_t end = begin;
+		regions.clear();
+		while (end != copies.size() && copies[end].destination == copies[begin].destination)
+		{
+			regions.push_back(copies[end].region);
+			end += 1;
+		}
+		vkCmdCopyBuffer(batch.command_buffer, transfer.ring, copies[begin].destination, static_cast<uint32_t>(regions.size()), regions.data());
+		begin = end;
+	}
+
+	// the release half of the ownership transfers. The destination queue acquires after waiting
+	// for this batch.
+	if (!transfer.pending_releases.empty())
+	{
+		std::vector<VkBufferMemoryBarrier> barriers;
+		for (const auto& release: transfer.pending_releases)
+		{
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.srcQueueFamilyIndex = transfer.family;
+			barrier.dstQueueFamilyIndex = release.destination_family;
+			barrier.buffer = release.buffer;
+			barrier.size = VK_WHOLE_SIZE;
+			barriers.push_back(barrier);
+		}
+		vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+	}
+	vkEndCommandBuffer(batch.command_buffer);
+
+	vk_submit_t submit{};
+	vk_submit_add_command_buffer(submit, batch.command_buffer);
+	vk_timeline_point_t point = vk_scheduler_submit(*transfer.scheduler, vk_queue_kind_t::transfer, submit);
+
+	batch.submitted = point;
+	batch.ring_end = transfer.head;
+	transfer.in_flight.push_back(transfer.next_batch);
+	transfer.next_batch = (transfer.next_batch + 1) % vk_transfer_batch_count;
+	transfer.last_flushed = point;
+	transfer.flush_count += 1;
+	copies.clear();
+	transfer.pending_releases.clear();
+	return point;
+}
+
+void vk_transfer_acquire(const vk_transfer_t& transfer, VkCommandBuffer command_buffer, VkBuffer buffer, uint32_t destination_family, VkPipelineStageFlags destination_stage, VkAccessFlags destination_access)
+{
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.dstAccessMask = destination_access;
+	barrier.buffer = buffer;
+	barrier.size = VK_WHOLE_SIZE;
+
+	if (destination_family != transfer.family)
+	{
+		barrier.srcQueueFamilyIndex = transfer.family;
+		barrier.dstQueueFamilyIndex = destination_family;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, destination_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+	else
+	{
+		// same family (and maybe the same queue, where the timeline wait is dropped): the copies
+		// still have to be made visible.
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, destination_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// bulk uploads (vertex data, textures, the initial particles) through the transfer queue.
+//
+// all staging memory is one fixed size ring buffer, mapped once for good. Uploads are written into
+// the ring and recorded as copy regions; a flush sorts them by destination and records one
+// vkCmdCopyBuffer per destination buffer (however many regions it has), and submits the lot to
+// the transfer queue. The ring bytes a flush used are reclaimed as soon as the transfer timeline
+// reaches its point, so the cpu only ever waits when the gpu is a whole ring behind.
+//
+// nothing here waits for an upload to be done: whoever uses the destination waits for the point
+// vk_transfer_flush returns on the gpu (vk_submit_wait), and acquires the buffer with
+// vk_transfer_acquire. With a dedicated transfer family the destination changes owner:
+// vk_transfer_release queues the release for the next flush, once the buffer is complete.
+//
+// not thread safe: one thread (usually the one streaming the data in) feeds the ring.
+
+#include <vulkan/vulkan.h>
+
+#include "vk_allocator.h"
+#include "vk_scheduler.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+const VkDeviceSize vk_transfer_default_ring_size = 64ull << 20;
+// command buffers in flight on the transfer queue.
+const uint32_t vk_transfer_batch_count = 4;
+// every ring allocation starts at a multiple of this (enough for any texel or vec4).
+const VkDeviceSize vk_transfer_alignment = 16;
+
+struct vk_transfer_copy_t
+{
+	VkBuffer destination;
+	VkBufferCopy region;
+};
+
+struct vk_transfer_release_t
+{
+	VkBuffer buffer;
+	uint32_t destination_family;
+};
+
+struct vk_transfer_batch_t
+{
+	VkCommandPool command_pool;
+	VkCommandBuffer command_buffer;
+	vk_timeline_point_t submitted;
+	// the ring head when the batch was flushed: everything before it is free once submitted is reached.
+	VkDeviceSize ring_end;
+};
+
+// a range of the ring, written by the caller and then copied with vk_transfer_copy.
+struct vk_transfer_allocation_t
+{
+	uint8_t* mapped;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+struct vk_transfer_t
+{
+	vk_allocator_t* allocator;
+	vk_scheduler_t* scheduler;
+	uint32_t family;
+
+	VkBuffer ring;
+	vk_allocation_t ring_allocation;
+	VkDeviceSize ring_size;
+	// bytes ever allocated from (head) and given back to (tail) the ring; the offset into the ring
+	// is head % ring_size. head - tail is what is in use.
+	VkDeviceSize head;
+	VkDeviceSize tail;
+
+	std::vector<vk_transfer_copy_t> pending_copies;
+	std::vector<vk_transfer_release_t> pending_releases;
+	std::vector<vk_transfer_batch_t> batches;
+	uint32_t next_batch;
+	// flushed batches, oldest first, that still hold on to ring space.
+	std::deque<uint32_t> in_flight;
+	vk_timeline_point_t last_flushed;
+
+	VkDeviceSize uploaded_bytes;
+	uint64_t flush_count;
+	// how often the ring was full and we had to wait for the transfer queue.
+	uint64_t stall_count;
+};
+
+bool vk_transfer_init(vk_transfer_t& transfer, vk_allocator_t& allocator, vk_scheduler_t& scheduler, VkDeviceSize ring_size = vk_transfer_default_ring_size);
+// waits for every upload in flight.
+void vk_transfer_destroy(vk_transfer_t& transfer);
+
+// the largest single allocation (a quarter of the ring, so a couple of them fit in flight at once).
+VkDeviceSize vk_transfer_max_allocation_size(const vk_transfer_t& transfer);
+
+// room for size bytes in the ring. Flushes and waits for older batches when the ring is full.
+// size has to be at most vk_transfer_max_allocation_size, and the allocation has to be copied
+// before the next one is made (its space belongs to the batch it is copied in).
+vk_transfer_allocation_t vk_transfer_allocate(vk_transfer_t& transfer, VkDeviceSize size);
+// copies size bytes from source_offset into the allocation to destination (at destination_offset)
+// with the next flush. The allocation has to be written (and is flushed to the gpu) by now.
+void vk_transfer_copy(vk_transfer_t& transfer, const vk_transfer_allocation_t& allocation, VkDeviceSize source_offset, VkBuffer destination, VkDeviceSize destination_offset, VkDeviceSize size);
+// allocate + memcpy + copy, in chunks when the data does not fit in one allocation.
+void vk_transfer_upload(vk_transfer_t& transfer, VkBuffer destination, VkDeviceSize destination_offset, const void* data, VkDeviceSize size);
+
+// the destination is complete: hands it to destination_family with the next flush. Does nothing
+// when the transfer queue is in that family already.
+void vk_transfer_release(vk_transfer_t& transfer, VkBuffer buffer, uint32_t destination_family);
+
+// submits everything recorded so far and returns the point it signals (the last flush's point if
+// there was nothing to submit).
+vk_timeline_point_t vk_transfer_flush(vk_transfer_t& transfer);
+
+// in a command buffer of destination_family, after waiting for the flush that released buffer:
+// the ownership acquire, or a plain barrier on the same queue family.
+void vk_transfer_acquire(const vk_transfer_t& transfer, VkCommandBuffer command_buffer, VkBuffer buffer, uint32_t destination_family, VkPipelineStageFlags destination_stage, VkAccessFlags destination_access);